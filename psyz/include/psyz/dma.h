@@ -31,6 +31,10 @@ typedef enum {
  * Emulates registers between 0x1F801080 to 0x1F8010EC. The MMIO pointer is
  * calculated with 0x1F801080 + ch * 0x10 + offset * 4
  *
+ * Addresses are host pointers. The GPU channel supports VRAM block transfers
+ * for the area set by a preceding GP0 A0h/C0h and ordering tables in linked
+ * list mode. OTC expects the address of the last ordering table entry.
+ *
  * @param ch Channel to write to
  * @param offset can be either 0, 1 or 2
  * @param value to write to; can be a raw pointer
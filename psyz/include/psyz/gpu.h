@@ -62,12 +62,65 @@ int Psyz_GpuSetHorizontalGrid(
  * and configuring GPU state. On real hardware GP0 words are consumed
  * asynchronously by the GPU FIFO. Here they are buffered in an internal queue
  * and may only flushed when Psyz_GpuExeque is called depending on backend.
+ * The queue grows as needed, words are never dropped.
  * https://problemkaputt.de/psxspx-graphics-processing-unit-gpu.htm
  *
  * @param word GP0 command word
  */
 void Psyz_GpuWriteGP0(unsigned int word);
 
+/**
+ * @brief Write a block of GP0 words
+ *
+ * Same packets as calling Psyz_GpuWriteGP0 for each word, but complete packets
+ * are decoded straight from `words` instead of being queued one word at a
+ * time. Meant for emulator front-ends forwarding GP0 DMA transfers. A block
+ * does not have to end on a packet boundary, the trailing words are queued
+ * until the next write completes the packet.
+ *
+ * Unlike Psyz_GpuWriteGP0, the block is dispatched right away rather than at
+ * the next Psyz_GpuExeque. To keep the submission order, the words queued
+ * before it with Psyz_GpuWriteGP0 are dispatched first.
+ *
+ * @param words GP0 command words
+ * @param n Number of words
+ */
+void Psyz_GpuWriteGP0Block(const uint32_t* words, size_t n);
+
+/**
+ * @brief Maps a PS1 RAM address to host memory, NULL when invalid
+ */
+typedef const uint32_t* (*PsyzGpuTranslateAddress)(
+    uint32_t address, void* userdata);
+
+/**
+ * @brief Write the GP0 words of a DMA linked list
+ *
+ * Walks a linked list the way the GPU DMA channel does in linked-list mode:
+ * every node starts with a header holding the amount of words in the top
+ * 8 bits and the address of the next node in the low 24 bits. The walk stops
+ * after the node whose next address has bit 23 set, such as 0xFFFFFF. The
+ * words of each node are written with Psyz_GpuWriteGP0Block.
+ *
+ * @param base Host pointer to the emulated RAM, used when translate is NULL
+ * @param address Address of the first node
+ * @param translate Optional callback mapping addresses to host pointers
+ * @param userdata Passed to translate
+ * @return Number of nodes walked, negative when an address could not be
+ *         translated or the list loops
+ */
+int Psyz_GpuWriteGP0LinkedList(const void* base, uint32_t address,
+                               PsyzGpuTranslateAddress translate,
+                               void* userdata);
+
+/**
+ * @brief Get the high-water mark of the internal GP0 queue
+ *
+ * @return The largest amount of words Psyz_GpuWriteGP0 ever accumulated
+ *         before they were flushed
+ */
+unsigned int Psyz_GpuGetQueueHighWater(void);
+
 /**
  * @brief Flush the internal GP0 queue and render to screen
  *
@@ -83,6 +136,121 @@ void Psyz_GpuWriteGP0(unsigned int word);
  */
 int Psyz_GpuExeque(void);
 
+/**
+ * @brief Decode and draw GPU packets on a dedicated render thread
+ *
+ * When enabled, ordering tables and GP0 words are copied into a ring buffer
+ * consumed by a render thread, so primitive decoding and rasterization
+ * overlap with the game logic. DrawSync(0) and VRAM transfers block until the
+ * render thread caught up, while DrawSync(1) and Psyz_GpuExeque return the
+ * number of words still pending. GPU_STATUS is kept up to date without any
+ * synchronization. Handlers registered with Psyz_GpuRegisterCommandHandler
+ * are invoked from the render thread.
+ *
+ * @param enable Non-zero to start the render thread, zero to stop it
+ * @return 0 on success, negative when the rendering backend does not support
+ *         a render thread
+ */
+int Psyz_GpuSetThreaded(int enable);
+
+/**
+ * @brief Record every GPU command to a trace file
+ *
+ * Captures GP0 packets as they are submitted to the rendering backend, GP1
+ * commands, VRAM transfers and VSync boundaries, so the rendering workload
+ * can be replayed and profiled without the game logic. The trace starts with
+ * four words, the magic "PSZG" and the version, followed by records. Each
+ * record starts with a word holding the type in the top 8 bits and the
+ * payload length in words in the low 24 bits. Words are little-endian and
+ * 32-bit aligned, so a memory mapped trace can be replayed in place.
+ *
+ * @param path File to write, overwritten when it exists
+ * @return 0 on success, negative when the file could not be created
+ */
+int Psyz_GpuCaptureStart(const char* path);
+
+/**
+ * @brief Stop the capture started with Psyz_GpuCaptureStart
+ */
+void Psyz_GpuCaptureStop(void);
+
+/**
+ * @brief Read position within a trace recorded by Psyz_GpuCaptureStart
+ */
+typedef struct {
+    const void* data; /**< trace contents, at least 4-byte aligned */
+    size_t size;      /**< trace size in words */
+    size_t offset;    /**< next record to replay, in words */
+} PsyzGpuTrace;
+
+/**
+ * @brief Workload of a replayed frame
+ */
+typedef struct {
+    unsigned int gp0_words; /**< GP0 words submitted to the backend */
+    unsigned int flushes;   /**< Psyz_GpuExeque calls that had new packets */
+    unsigned int transfers; /**< LoadImage and StoreImage calls */
+} PsyzGpuReplayStats;
+
+/**
+ * @brief Prepare a trace for Psyz_GpuReplayFrame
+ *
+ * @param trace Read position to initialize
+ * @param data Trace contents, which must stay valid during the replay
+ * @param size Trace size in bytes
+ * @return 0 on success, negative when data is not a supported trace
+ */
+int Psyz_GpuReplayOpen(PsyzGpuTrace* trace, const void* data, size_t size);
+
+/**
+ * @brief Replay the commands of the next frame of a trace
+ *
+ * Commands go through the rendering backend up to the next VSync boundary,
+ * which is not replayed: call VSync or Psyz_VideoVSync to present the frame.
+ *
+ * @return 1 when a frame was replayed, 0 at the end of the trace, negative
+ *         when the trace is corrupted
+ */
+int Psyz_GpuReplayFrame(PsyzGpuTrace* trace, PsyzGpuReplayStats* stats);
+
+/** Ordering table walk counters, see Psyz_GpuOtProfile */
+typedef struct {
+    unsigned int links;          /**< nodes traversed */
+    unsigned int empty_links;    /**< nodes without packets, OT slots */
+    unsigned int occupied_slots; /**< slots followed by at least a packet */
+    unsigned int prims;          /**< nodes carrying packets */
+    unsigned int longest_chain;  /**< most packets linked to a single slot */
+    unsigned long long packet_bytes; /**< GP0 words sent, in bytes */
+} PsyzGpuOtWalk;
+
+typedef struct {
+    unsigned int walks;    /**< linked lists walked: DrawOTag, PutDrawEnv... */
+    PsyzGpuOtWalk total;   /**< sum of all walks, longest_chain is the max */
+    PsyzGpuOtWalk largest; /**< the walk that traversed the most links */
+} PsyzGpuOtStats;
+
+/**
+ * @brief Toggle the ordering table profiler
+ *
+ * When enabled, every linked list handed to the GPU is accounted while being
+ * walked: how many links it is made of, how many of them are empty slots and
+ * how the packets are spread across the slots. Large and sparse ordering
+ * tables are costly to clear and walk while drawing little, and are candidates
+ * for a smaller depth or a compaction pass. Disabled by default.
+ *
+ * @param enable non-zero to enable the profiler
+ */
+void Psyz_GpuOtProfile(int enable);
+
+/**
+ * @brief Get the ordering table counters of the last completed frame
+ *
+ * A frame is delimited by VSync(0).
+ *
+ * @return 0 on success, -1 if stats is NULL or the profiler is disabled
+ */
+int Psyz_GpuOtStats(PsyzGpuOtStats* stats);
+
 /**
  * @brief Write a GP1 word to control the display
  *
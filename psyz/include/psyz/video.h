@@ -77,14 +77,94 @@ typedef enum {
     PSYZ_ASPECT_SQUARE,  /**< 1:1 from framebuffer (pixel-perfect) */
 } PsyzAspectMode;
 
+typedef enum {
+    PSYZ_READBACK_SYNC,       /**< StoreImage returns with the pixels */
+    PSYZ_READBACK_DRAWSYNC,   /**< pixels land by DrawSync (default) */
+    PSYZ_READBACK_NEXT_FRAME, /**< pixels land once the frame is presented */
+} PsyzReadbackMode;
+
+typedef enum {
+    PSYZ_FRAMESKIP_OFF,     /**< present every frame (default) */
+    PSYZ_FRAMESKIP_PRESENT, /**< skip presenting after a late frame */
+    PSYZ_FRAMESKIP_DRAW,    /**< also defer drawing the skipped frames */
+} PsyzFrameSkipMode;
+
 typedef struct {
-    double last_frame_time_us;       /**< duration of last frame */
-    double last_draw_time_us;        /**< render time excluding vsync wait */
-    double target_frame_time_us;     /**< target frame time */
-    unsigned long long total_frames; /**< total frames rendered */
-    int using_driver_vsync;          /**< 1 for VSync, 0 for limiter */
+    double last_frame_time_us;         /**< duration of last frame */
+    double last_draw_time_us;          /**< render time excluding vsync wait */
+    double target_frame_time_us;       /**< target frame time */
+    unsigned long long total_frames;   /**< total frames rendered */
+    int using_driver_vsync;            /**< 1 for VSync, 0 for limiter */
+    unsigned int internal_res;         /**< internal resolution multiplier */
+    double pacing_error_us;            /**< limiter wake-up past deadline */
+    double wait_cpu_us;                /**< CPU time spent in the limiter */
+    unsigned long long skipped_frames; /**< frames not presented */
+    unsigned long long capture_drops;  /**< frames the capture dropped */
 } PsyzVideoStats;
 
+typedef enum {
+    PSYZ_CAPTURE_RGB888,   /**< 3 bytes per pixel */
+    PSYZ_CAPTURE_RGBA8888, /**< 4 bytes per pixel, alpha is the mask bit */
+    PSYZ_CAPTURE_RGB5551,  /**< VRAM words, red in the low bits */
+} PsyzCaptureFormat;
+
+typedef struct {
+    const void* pixels; /**< rows top to bottom, without padding */
+    int width;
+    int height;
+    PsyzCaptureFormat format;
+    unsigned long long frame; /**< PsyzVideoStats.total_frames presenting it */
+} PsyzCapturedFrame;
+
+typedef void (*PsyzCaptureCallback)(
+    const PsyzCapturedFrame* frame, void* userdata);
+
+typedef enum {
+    PSYZ_RECORD_Y4M_WAV, /**< <path>.y4m and <path>.wav */
+    PSYZ_RECORD_RAW,     /**< headerless RGB888 <path>.rgb, s16le <path>.pcm */
+} PsyzRecordFormat;
+
+typedef struct {
+    unsigned long long frames;          /**< video frames written */
+    unsigned long long repeated_frames; /**< written again to fill a gap */
+    unsigned long long audio_frames;    /**< stereo samples written */
+    unsigned long long audio_padded;    /**< silence written, no audio came */
+    unsigned long long audio_dropped;   /**< audio ahead of the frames */
+    int width;                          /**< of every frame written */
+    int height;
+} PsyzRecordStats;
+
+/** Why the renderer had to submit its pending batch of primitives */
+typedef enum {
+    PSYZ_FLUSH_EXEQUE,      /**< end of a DrawOTag/DrawPrim submission */
+    PSYZ_FLUSH_BUFFER_FULL, /**< vertex or index buffer ran out of space */
+    PSYZ_FLUSH_LOAD_IMAGE,  /**< LoadImage, ClearImage or a GPU DMA upload */
+    PSYZ_FLUSH_STORE_IMAGE, /**< StoreImage or a GPU DMA download */
+    PSYZ_FLUSH_MOVE_IMAGE,  /**< MoveImage */
+    PSYZ_FLUSH_DITHER,      /**< dithering mode toggled */
+    PSYZ_FLUSH_STATE,       /**< draw area, offset or resolution change,
+                                 or a batch sampling pixels it drew */
+    PSYZ_FLUSH_REASON_COUNT,
+} PsyzFlushReason;
+
+/**
+ * Per-frame counters of the rendering pipeline, meant to find out why a frame
+ * is slow rather than how slow it is. Counters a backend has no use for, like
+ * vertices on the software renderer, are left to zero.
+ */
+typedef struct {
+    unsigned int polys;     /**< triangles and quads */
+    unsigned int lines;     /**< lines and polylines */
+    unsigned int rects;     /**< tiles and sprites */
+    unsigned int vertices;  /**< vertices sent to the GPU */
+    unsigned int indices;   /**< indices sent to the GPU */
+    unsigned int instances; /**< rectangles drawn as GPU instances */
+    unsigned int flushes[PSYZ_FLUSH_REASON_COUNT]; /**< batches submitted */
+    unsigned int blend_switches; /**< additive/subtractive pipeline changes */
+    unsigned long long vram_copy_bytes; /**< VRAM copied within the GPU */
+    unsigned long long readback_bytes;  /**< VRAM read back to the CPU */
+} PsyzVideoPipelineStats;
+
 /**
  * @brief Get the current VSync mode
  *
@@ -137,6 +217,90 @@ PsyzAspectMode Psyz_VideoGetAspectMode(void);
  */
 int Psyz_VideoSetAspectMode(PsyzAspectMode mode);
 
+/**
+ * @brief Get the current readback mode
+ *
+ * @return current readback mode
+ */
+PsyzReadbackMode Psyz_VideoGetReadbackMode(void);
+
+/**
+ * @brief Select when the pixels of a StoreImage reach the destination
+ *
+ * SYNC: StoreImage waits for the GPU, the pixels can be used right away.
+ * DRAWSYNC: like on the console, the pixels are only guaranteed once
+ *   DrawSync(0) returned; the next VRAM transfer also waits for them. The
+ *   download overlaps the game logic in the meantime.
+ * NEXT_FRAME: the pixels are only guaranteed once the frame is presented,
+ *   for titles that use them on the next frame; DrawSync no longer waits.
+ *
+ * Backends reading VRAM on the CPU behave as SYNC whatever the mode, those
+ * unable to defer a download past DrawSync treat NEXT_FRAME as DRAWSYNC.
+ *
+ * @param mode Readback mode to set
+ * @return 0 on success, -1 if invalid mode
+ */
+int Psyz_VideoSetReadbackMode(PsyzReadbackMode mode);
+
+/** Most frames skipped in a row before one is presented anyway */
+#define PSYZ_FRAMESKIP_MAX_RUN 2
+
+/**
+ * @brief Get the current frame skip mode
+ *
+ * @return current frame skip mode
+ */
+PsyzFrameSkipMode Psyz_VideoGetFrameSkip(void);
+
+/**
+ * @brief Let VSync shed frames when the game falls behind (default: OFF)
+ *
+ * PRESENT: when a frame took longer than the frame time budget, the next
+ *   VSync does not present, sparing the swapchain blit while the game logic
+ *   keeps its pace.
+ * DRAW: after a late frame, the primitives drawn into the display
+ *   framebuffers are recorded instead of rasterized, and the VSync that would
+ *   show them does not present. Anything reading or drawing over a recorded
+ *   framebuffer, StoreImage and texture sampling included, first rasterizes
+ *   what was recorded, and a fill covering the framebuffer drops it. Titles
+ *   drawing their frame elsewhere and copying it never skip in this mode.
+ *
+ * At most PSYZ_FRAMESKIP_MAX_RUN frames in a row are skipped.
+ * PsyzVideoStats.skipped_frames counts the frames that were not presented.
+ *
+ * @param mode Frame skip mode to set
+ * @return 0 on success, -1 if invalid mode
+ */
+int Psyz_VideoSetFrameSkip(PsyzFrameSkipMode mode);
+
+/** Maximum accepted depth of the present queue */
+#define PSYZ_PRESENT_QUEUE_MAX 3
+
+/**
+ * @brief Get how many finished frames may wait for the display
+ *
+ * @return current depth of the present queue
+ */
+unsigned Psyz_VideoGetPresentQueue(void);
+
+/**
+ * @brief Set how many finished frames may wait for the display (default: 0)
+ *
+ * With 0, VSync waits for the swapchain to show the frame. Above that, a
+ * frame the swapchain cannot take yet is copied aside and shown on a later
+ * VSync, oldest first: a compositor hiccup only stalls the game once the
+ * queue is full, at the cost of up to that many frames of latency. Once the
+ * swapchain takes frames again, every VSync skips the oldest frame waiting
+ * until none is left. Lowering the depth drops the frames over it.
+ *
+ * Only the SDL_GPU backend queues frames. The others present through a
+ * blocking buffer swap and only accept 0.
+ *
+ * @param depth Depth of the queue, up to PSYZ_PRESENT_QUEUE_MAX
+ * @return 0 on success, -1 if depth is out of range or not supported
+ */
+int Psyz_VideoSetPresentQueue(unsigned depth);
+
 /**
  * @brief Get the resolution a game should target to render pixel-perfect
  *
@@ -198,6 +362,28 @@ int Psyz_VideoSetInternalResolution(unsigned multiplier);
  */
 unsigned Psyz_VideoGetInternalResolution(void);
 
+/**
+ * @brief Let the internal resolution follow the frame time (default: off)
+ *
+ * The render time of the frames is compared to the frame time budget. The
+ * multiplier steps down as soon as frames run late, and only steps up when
+ * the projected cost of the next multiplier fits with room to spare, so it
+ * settles instead of oscillating. Psyz_VideoSetInternalResolution turns it
+ * off. Targets rendering at native resolution only record the setting.
+ *
+ * @param max_multiplier highest multiplier to pick, up to
+ *                       PSYZ_INTERNAL_RES_MAX, or 0 to turn it off
+ * @return 0 on success, -1 if max_multiplier is out of range
+ */
+int Psyz_VideoSetAutoInternalResolution(unsigned max_multiplier);
+
+/**
+ * @brief Get the highest multiplier the automatic internal resolution picks
+ *
+ * @return highest multiplier, or 0 when the internal resolution is fixed
+ */
+unsigned Psyz_VideoGetAutoInternalResolution(void);
+
 /**
  * @brief Synchronize with vertical blank
  *
@@ -220,10 +406,19 @@ int Psyz_VideoVSync(int mode);
  */
 int Psyz_VideoStats(PsyzVideoStats* stats);
 
+/**
+ * @brief Get the rendering pipeline counters of the last presented frame
+ *
+ * @param stats Output structure to fill
+ * @return 0 on success, -1 if stats is NULL or platform not initialized
+ */
+int Psyz_VideoPipelineStats(PsyzVideoPipelineStats* stats);
+
 /**
  * @brief Get frame output as a byte array
  *
- * This function is very slow.
+ * This function is very slow, see Psyz_VideoCaptureStart to capture every
+ * frame.
  *
  * @param w Output frame width
  * @param h Output frame height
@@ -240,6 +435,70 @@ unsigned char* Psyz_VideoAllocCapturedFrame(int* w, int* h);
  */
 unsigned char* Psyz_VideoAllocVramDump(int* w, int* h);
 
+/**
+ * @brief Start delivering every presented frame to a callback
+ *
+ * Each VSync that presents queues a copy of the display area, at the
+ * internal resolution it is presented at, without waiting for it. Frames
+ * are converted and handed to the callback one or two frames later, from a
+ * capture thread, in presentation order. When the callback falls behind,
+ * the frames that would need more buffers are dropped and counted in
+ * PsyzVideoStats.capture_drops, the game never waits for it.
+ *
+ * Starting again replaces the callback and format of the running capture.
+ *
+ * @param callback Called from the capture thread, frame->pixels is only
+ *                 valid until it returns
+ * @param userdata Passed to the callback as is
+ * @param format Pixel format of the delivered frames
+ * @return 0 on success, -1 if the arguments are invalid or the capture
+ *         thread could not start
+ */
+int Psyz_VideoCaptureStart(
+    PsyzCaptureCallback callback, void* userdata, PsyzCaptureFormat format);
+
+/**
+ * @brief Stop the capture started by Psyz_VideoCaptureStart
+ *
+ * Frames already downloaded are delivered before it returns, those still in
+ * flight are dropped. The callback is not called anymore afterwards.
+ */
+void Psyz_VideoCaptureStop(void);
+
+/**
+ * @brief Record every presented frame and the SPU output to files
+ *
+ * Built on Psyz_VideoCaptureStart, which it takes over until stopped: the
+ * frames are converted and written from the capture thread, and the game
+ * never waits for the disk. The video has the size of the first frame and
+ * runs at the VSync rate: a VSync that did not present, or whose frame the
+ * capture dropped, repeats the previous frame. Each frame carries the audio
+ * pulled by the audio device since, cut or padded with silence to the length
+ * of a VSync, so that both streams stay in sync however the game is paced.
+ *
+ * With PSYZ_RECORD_RAW, the paths may name pipes created beforehand, for an
+ * encoder to read from; opening them waits for their reader.
+ *
+ * @param path Path of the outputs, without their extension
+ * @param format Y4M video and WAV audio, or both without headers
+ * @return 0 on success, -1 if already recording, the arguments are invalid
+ *         or the outputs could not be opened
+ */
+int Psyz_VideoRecordStart(const char* path, PsyzRecordFormat format);
+
+/**
+ * @brief Stop the recording, writing out what was queued and closing files
+ */
+void Psyz_VideoRecordStop(void);
+
+/**
+ * @brief Get what the current or last recording wrote so far
+ *
+ * @param stats Output recording statistics
+ * @return 0 on success, -1 if stats is NULL
+ */
+int Psyz_VideoRecordStats(PsyzRecordStats* stats);
+
 #ifdef __cplusplus
 }
 #endif
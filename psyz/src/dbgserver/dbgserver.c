@@ -62,6 +62,11 @@ typedef enum {
     DBG_CMD_CONFIG_SET,
     DBG_CMD_INPUT_QUEUE,
     DBG_CMD_INPUT_CLEAR,
+    DBG_CMD_OT_STATS,
+    DBG_CMD_OT_PROFILE,
+    DBG_CMD_RECORD_START,
+    DBG_CMD_RECORD_STOP,
+    DBG_CMD_RECORD_STATS,
 } DbgCommandKind;
 
 typedef struct {
@@ -84,17 +89,25 @@ typedef struct {
     int frames;
 } DbgInputArgs;
 
+typedef struct {
+    char path[256];
+    int format;
+} DbgRecordArgs;
+
 typedef struct {
     DbgCommandKind kind;
     union {
         DbgConfigArgs config;
         DbgInputArgs input;
+        int ot_profile;
+        DbgRecordArgs record;
     } args;
 
     int ok;
     unsigned char* frame_pixels;
     int frame_w, frame_h;
     PsyzVideoStats stats;
+    PsyzGpuOtStats ot;
     char json[1024];
 } DbgCommand;
 
@@ -398,6 +411,10 @@ static const ModeEntry g_aspect_modes[] = {
     {"display", PSYZ_ASPECT_DISPLAY},
     {"square", PSYZ_ASPECT_SQUARE},
 };
+static const ModeEntry g_record_formats[] = {
+    {"y4m", PSYZ_RECORD_Y4M_WAV},
+    {"raw", PSYZ_RECORD_RAW},
+};
 
 static const char* ModeName(const ModeEntry* table, int count, int value) {
     for (int i = 0; i < count; i++) {
@@ -502,6 +519,44 @@ static void CmdInputClear(DbgCommand* cmd) {
     cmd->ok = 1;
 }
 
+static void CmdOtStats(DbgCommand* cmd) {
+    cmd->ok = Psyz_GpuOtStats(&cmd->ot) == 0;
+}
+
+static void CmdOtProfile(DbgCommand* cmd) {
+    Psyz_GpuOtProfile(cmd->args.ot_profile);
+    snprintf(cmd->json, sizeof(cmd->json), "{\"enabled\":%s}\n",
+             cmd->args.ot_profile ? "true" : "false");
+    cmd->ok = 1;
+}
+
+static void FormatRecordJson(char* out, int out_len) {
+    PsyzRecordStats rs;
+    Psyz_VideoRecordStats(&rs);
+    snprintf(out, out_len,
+             "{\"frames\":%llu,\"repeated_frames\":%llu,\"width\":%d,"
+             "\"height\":%d,\n\"audio_frames\":%llu,\"audio_padded\":%llu,"
+             "\"audio_dropped\":%llu}\n",
+             rs.frames, rs.repeated_frames, rs.width, rs.height,
+             rs.audio_frames, rs.audio_padded, rs.audio_dropped);
+}
+
+static void CmdRecordStart(DbgCommand* cmd) {
+    DbgRecordArgs* a = &cmd->args.record;
+    if (Psyz_VideoRecordStart(a->path, (PsyzRecordFormat)a->format) != 0) {
+        cmd->ok = 0;
+        return;
+    }
+    strcpy(cmd->json, "{\"ok\":true}");
+    cmd->ok = 1;
+}
+
+static void CmdRecordStop(DbgCommand* cmd) {
+    Psyz_VideoRecordStop();
+    FormatRecordJson(cmd->json, sizeof(cmd->json));
+    cmd->ok = 1;
+}
+
 static void DbgDispatchCommand(DbgCommand* cmd) {
     switch (cmd->kind) {
     case DBG_CMD_STATS:
@@ -525,6 +580,22 @@ static void DbgDispatchCommand(DbgCommand* cmd) {
     case DBG_CMD_INPUT_CLEAR:
         CmdInputClear(cmd);
         break;
+    case DBG_CMD_OT_STATS:
+        CmdOtStats(cmd);
+        break;
+    case DBG_CMD_OT_PROFILE:
+        CmdOtProfile(cmd);
+        break;
+    case DBG_CMD_RECORD_START:
+        CmdRecordStart(cmd);
+        break;
+    case DBG_CMD_RECORD_STOP:
+        CmdRecordStop(cmd);
+        break;
+    case DBG_CMD_RECORD_STATS:
+        FormatRecordJson(cmd->json, sizeof(cmd->json));
+        cmd->ok = 1;
+        break;
     }
 }
 
@@ -632,10 +703,33 @@ static void EpMetrics(const HttpRequest* hr, dbg_socket_t sock) {
             "# HELP psyz_using_driver_vsync 1 if using driver VSync, 0 if "
             "using the limiter.\n"
             "# TYPE psyz_using_driver_vsync gauge\n"
-            "psyz_using_driver_vsync %d\n",
+            "psyz_using_driver_vsync %d\n"
+            "# HELP psyz_internal_resolution Internal resolution multiplier.\n"
+            "# TYPE psyz_internal_resolution gauge\n"
+            "psyz_internal_resolution %u\n",
             stats->last_frame_time_us, stats->last_draw_time_us,
             stats->target_frame_time_us, stats->total_frames,
-            stats->using_driver_vsync) != 0) {
+            stats->using_driver_vsync, stats->internal_res) != 0) {
+        return;
+    }
+    if (SendChunkF(
+            sock,
+            "# HELP psyz_pacing_error_microseconds Limiter wake-up past the "
+            "frame deadline.\n"
+            "# TYPE psyz_pacing_error_microseconds gauge\n"
+            "psyz_pacing_error_microseconds %.3f\n"
+            "# HELP psyz_wait_cpu_microseconds CPU time spent in the "
+            "limiter.\n"
+            "# TYPE psyz_wait_cpu_microseconds gauge\n"
+            "psyz_wait_cpu_microseconds %.3f\n"
+            "# HELP psyz_skipped_frames_total Frames not presented.\n"
+            "# TYPE psyz_skipped_frames_total counter\n"
+            "psyz_skipped_frames_total %llu\n"
+            "# HELP psyz_capture_drops_total Frames the capture dropped.\n"
+            "# TYPE psyz_capture_drops_total counter\n"
+            "psyz_capture_drops_total %llu\n",
+            stats->pacing_error_us, stats->wait_cpu_us,
+            stats->skipped_frames, stats->capture_drops) != 0) {
         return;
     }
     SendEnd(sock);
@@ -762,6 +856,96 @@ static void EpInputClear(const HttpRequest* hr, dbg_socket_t sock) {
     RespondJson(sock, cmd.json);
 }
 
+static int SendOtWalk(dbg_socket_t sock, const char* name,
+                      const PsyzGpuOtWalk* walk, const char* sep) {
+    return SendChunkF(
+        sock,
+        "\"%s\":{\"links\":%u,\"empty_links\":%u,\"occupied_slots\":%u,"
+        "\"prims\":%u,\"longest_chain\":%u,\"packet_bytes\":%llu}%s",
+        name, walk->links, walk->empty_links, walk->occupied_slots,
+        walk->prims, walk->longest_chain, walk->packet_bytes, sep);
+}
+
+static void EpOtGet(const HttpRequest* hr, dbg_socket_t sock) {
+    (void)hr;
+    DbgCommand cmd = {.kind = DBG_CMD_OT_STATS};
+    if (ExecOrTimeout(&cmd, sock) != 0) {
+        return;
+    }
+    if (!cmd.ok) {
+        RespondError(sock, 409, "ordering table profiler disabled");
+        return;
+    }
+    if (SendHeader(sock, 200, "application/json") != 0) {
+        return;
+    }
+    if (SendChunkF(sock, "{\"walks\":%u,\n", cmd.ot.walks) != 0 ||
+        SendOtWalk(sock, "total", &cmd.ot.total, ",\n") != 0 ||
+        SendOtWalk(sock, "largest", &cmd.ot.largest, "}\n") != 0) {
+        return;
+    }
+    SendEnd(sock);
+}
+
+static void EpOtSet(const HttpRequest* hr, dbg_socket_t sock) {
+    DbgCommand cmd = {.kind = DBG_CMD_OT_PROFILE};
+    char val[8];
+    if (QueryGet(hr->query, "enable", val, sizeof(val)) != 0) {
+        RespondError(sock, 400, "missing enable value");
+        return;
+    }
+    cmd.args.ot_profile = atoi(val) != 0;
+    if (ExecOrTimeout(&cmd, sock) != 0) {
+        return;
+    }
+    RespondJson(sock, cmd.json);
+}
+
+// streams to files rather than polling /screenshot, see
+// Psyz_VideoRecordStart
+static void EpRecordStart(const HttpRequest* hr, dbg_socket_t sock) {
+    DbgCommand cmd = {.kind = DBG_CMD_RECORD_START};
+    DbgRecordArgs* a = &cmd.args.record;
+    if (QueryGet(hr->query, "path", a->path, sizeof(a->path)) != 0 ||
+        !a->path[0]) {
+        RespondError(sock, 400, "missing path value");
+        return;
+    }
+    char val[8] = "y4m";
+    QueryGet(hr->query, "format", val, sizeof(val));
+    if (ModeFromName(g_record_formats, LEN(g_record_formats), val,
+                     &a->format) != 0) {
+        RespondError(sock, 400, "invalid format value");
+        return;
+    }
+    if (ExecOrTimeout(&cmd, sock) != 0) {
+        return;
+    }
+    if (!cmd.ok) {
+        RespondError(sock, 409, "already recording or cannot open path");
+        return;
+    }
+    RespondJson(sock, cmd.json);
+}
+
+static void EpRecordCmd(
+    const HttpRequest* hr, dbg_socket_t sock, DbgCommandKind kind) {
+    (void)hr;
+    DbgCommand cmd = {.kind = kind};
+    if (ExecOrTimeout(&cmd, sock) != 0) {
+        return;
+    }
+    RespondJson(sock, cmd.json);
+}
+
+static void EpRecordGet(const HttpRequest* hr, dbg_socket_t sock) {
+    EpRecordCmd(hr, sock, DBG_CMD_RECORD_STATS);
+}
+
+static void EpRecordStop(const HttpRequest* hr, dbg_socket_t sock) {
+    EpRecordCmd(hr, sock, DBG_CMD_RECORD_STOP);
+}
+
 typedef void (*DbgEndpointFn)(const HttpRequest* hr, dbg_socket_t sock);
 
 // One method of one endpoint. A NULL `fn` means the method is unsupported;
@@ -802,6 +986,15 @@ static const DbgRoute g_routes[] = {
     {"/input/clear",
      {NULL, NULL, NULL},
      {EpInputClear, "drop pending input, release buttons", NULL}},
+    {"/ot",
+     {EpOtGet, "ordering table walks of the last frame", NULL},
+     {EpOtSet, "toggle the ordering table profiler", "enable"}},
+    {"/record",
+     {EpRecordGet, "frames and audio written by the recording", NULL},
+     {EpRecordStart, "record frames and audio to files", "path,format"}},
+    {"/record/stop",
+     {NULL, NULL, NULL},
+     {EpRecordStop, "finish the recording", NULL}},
 };
 
 #define DBG_ROUTE_COUNT ((int)(sizeof(g_routes) / sizeof(g_routes[0])))
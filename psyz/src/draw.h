@@ -79,7 +79,31 @@ void Draw_MoveImage(RECT* rect, unsigned int x, unsigned int y);
 void Draw_PutDispEnv(DISPENV* disp);
 void Draw_ResetBuffer(void);
 void Draw_FlushBuffer(void);
-int Draw_PushPrim(u_long* packets, int max_len);
+// Tags the next Draw_FlushBuffer with a PsyzFlushReason for the pipeline
+// stats. Untagged flushes are accounted as PSYZ_FLUSH_EXEQUE.
+void Draw_SetFlushReason(int reason);
+int Draw_PushPrim(u32* packets, int max_len);
 int Draw_ExequeSync();
 
+// ===== GPU thread =====
+// Optional: backends able to decode and rasterize away from the game thread
+// run a render thread fed by a single-producer single-consumer ring. Words
+// are handed back to `dispatch` from the render thread, in submission order.
+// Any other Draw_ call made from the game thread must be preceded by
+// Draw_ThreadSync. When the thread is not running, submissions are
+// dispatched immediately.
+
+// Returns -1 if the backend does not support a render thread.
+int Draw_ThreadStart(void (*dispatch)(u32* words, int len));
+void Draw_ThreadStop(void);
+// Copies a group of complete packets into the ring.
+void Draw_ThreadSubmit(const u32* words, int len);
+// Queues a Draw_FlushBuffer and Draw_ExequeSync after what was submitted.
+void Draw_ThreadFlush(void);
+// Blocks until everything submitted has been consumed. No-op when called
+// from the render thread itself.
+void Draw_ThreadSync(void);
+// Number of ring words not consumed yet.
+int Draw_ThreadPending(void);
+
 #endif
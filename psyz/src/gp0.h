@@ -0,0 +1,121 @@
+#ifndef GP0_H
+#define GP0_H
+
+// ===== GP0 command descriptors =====
+// Everything the decoders need to know about an opcode, resolved at compile
+// time into a 256-entry table so packets are classified with a single load
+// instead of re-testing the opcode bits for every primitive.
+// https://psx-spx.consoledev.net/graphicsprocessingunitgpu/#gpu-render-polygon-commands
+
+typedef enum {
+    GP0_KIND_UNKNOWN, // left to Psyz_GpuRegisterCommandHandler
+    GP0_KIND_MISC,    // NOP and clear cache
+    GP0_KIND_FILL,
+    GP0_KIND_POLY,
+    GP0_KIND_LINE,
+    GP0_KIND_RECT,
+    GP0_KIND_MOVE_IMAGE,
+    GP0_KIND_WRITE_IMAGE,
+    GP0_KIND_READ_IMAGE,
+    GP0_KIND_ENV, // E1h to E6h
+} Gp0Kind;
+
+// primitives with a dedicated unpack routine in the backends
+typedef enum {
+    GP0_SHAPE_GENERIC,
+    GP0_SHAPE_POLY_FT4, // flat textured quad, the bulk of 3D titles
+    GP0_SHAPE_SPRT,     // textured rectangle, the bulk of 2D titles
+} Gp0Shape;
+
+typedef struct {
+    u8 len;      // words taken by the packet, 0 when not known
+    u8 kind;     // Gp0Kind
+    u8 shape;    // Gp0Shape
+    u8 vertices; // vertices carried by the packet
+    u8 stride;   // words per vertex, the first color excluded
+    u8 size;     // width and height of fixed-size rectangles, 0 otherwise
+} Gp0Desc;
+
+// flags shared by all the primitive opcodes
+#define GP0_RAW_TEXTURE 0x01
+#define GP0_SEMITRANSP 0x02
+#define GP0_TEXTURED 0x04
+#define GP0_QUAD 0x08
+#define GP0_GOURAUD 0x10
+
+#define GP0_IS_POLY(c) ((c) >= 0x20 && (c) < 0x40)
+#define GP0_IS_LINE(c) ((c) >= 0x40 && (c) < 0x60)
+#define GP0_IS_RECT(c) ((c) >= 0x60 && (c) < 0x80)
+#define GP0_IS_ENV(c) ((c) >= 0xE1 && (c) <= 0xE6)
+
+// LINE_*2 has no terminator word, polylines carry up to 4 points
+#define GP0_LINE_POINTS(c) ((((c) >> 2) & 3) + 1)
+#define GP0_POLY_VERTICES(c) ((c) & GP0_QUAD ? 4 : 3)
+
+#define GP0_VERTICES(c)                                                        \
+    (GP0_IS_POLY(c)   ? GP0_POLY_VERTICES(c)                                   \
+     : GP0_IS_LINE(c) ? (GP0_LINE_POINTS(c) == 1 ? 2 : GP0_LINE_POINTS(c))     \
+     : GP0_IS_RECT(c) ? 1                                                      \
+                      : 0)
+
+#define GP0_STRIDE(c)                                                          \
+    (GP0_IS_POLY(c) ? 1 + !!((c) & GP0_TEXTURED) + !!((c) & GP0_GOURAUD)       \
+     : GP0_IS_LINE(c) ? 1 + !!((c) & GP0_GOURAUD)                              \
+     : GP0_IS_RECT(c) ? 1 + !!((c) & GP0_TEXTURED)                             \
+                      : 0)
+
+// only the variable sized rectangles carry a size word
+#define GP0_RECT_SIZE(c)                                                       \
+    (((c) & 0x18) == 0x08   ? 1                                                \
+     : ((c) & 0x18) == 0x10 ? 8                                                \
+     : ((c) & 0x18) == 0x18 ? 16                                               \
+                            : 0)
+
+#define GP0_LEN(c)                                                             \
+    (GP0_IS_POLY(c)                                                            \
+         ? 1 + GP0_POLY_VERTICES(c) * GP0_STRIDE(c) - !!((c) & GP0_GOURAUD)    \
+     : GP0_IS_LINE(c)                                                          \
+         ? (GP0_LINE_POINTS(c) == 1                                            \
+                ? ((c) & GP0_GOURAUD ? 4 : 3)                                  \
+                : 2 + GP0_LINE_POINTS(c) * GP0_STRIDE(c) -                     \
+                      !!((c) & GP0_GOURAUD))                                   \
+     : GP0_IS_RECT(c) ? 1 + GP0_STRIDE(c) + !GP0_RECT_SIZE(c)                  \
+     : (c) >= 0x80 && (c) < 0xA0 ? 4                                           \
+     : (c) >= 0xA0 && (c) < 0xE0 ? 3                                           \
+     : (c) == 0x02               ? 3                                           \
+     : (c) <= 0x01 || GP0_IS_ENV(c) ? 1                                        \
+                                    : 0)
+
+#define GP0_KIND(c)                                                            \
+    (GP0_IS_POLY(c)               ? GP0_KIND_POLY                              \
+     : GP0_IS_LINE(c)             ? GP0_KIND_LINE                              \
+     : GP0_IS_RECT(c)             ? GP0_KIND_RECT                              \
+     : (c) >= 0x80 && (c) < 0xA0  ? GP0_KIND_MOVE_IMAGE                        \
+     : (c) >= 0xA0 && (c) < 0xC0  ? GP0_KIND_WRITE_IMAGE                       \
+     : (c) >= 0xC0 && (c) < 0xE0  ? GP0_KIND_READ_IMAGE                        \
+     : (c) == 0x02                ? GP0_KIND_FILL                              \
+     : (c) <= 0x01                ? GP0_KIND_MISC                              \
+     : GP0_IS_ENV(c)              ? GP0_KIND_ENV                               \
+                                  : GP0_KIND_UNKNOWN)
+
+#define GP0_SHAPE(c)                                                           \
+    (((c) & ~3) == 0x2C ? GP0_SHAPE_POLY_FT4                                   \
+     : GP0_IS_RECT(c) && ((c) & GP0_TEXTURED) ? GP0_SHAPE_SPRT                 \
+                                              : GP0_SHAPE_GENERIC)
+
+#define GP0_DESC(c)                                                            \
+    {GP0_LEN(c),      GP0_KIND(c),   GP0_SHAPE(c),                             \
+     GP0_VERTICES(c), GP0_STRIDE(c), GP0_RECT_SIZE(c)}
+#define GP0_DESC4(c)                                                           \
+    GP0_DESC(c), GP0_DESC((c) + 1), GP0_DESC((c) + 2), GP0_DESC((c) + 3)
+#define GP0_DESC16(c)                                                          \
+    GP0_DESC4(c), GP0_DESC4((c) + 4), GP0_DESC4((c) + 8), GP0_DESC4((c) + 12)
+
+static const Gp0Desc gp0_desc[256] = {
+    GP0_DESC16(0x00), GP0_DESC16(0x10), GP0_DESC16(0x20), GP0_DESC16(0x30),
+    GP0_DESC16(0x40), GP0_DESC16(0x50), GP0_DESC16(0x60), GP0_DESC16(0x70),
+    GP0_DESC16(0x80), GP0_DESC16(0x90), GP0_DESC16(0xA0), GP0_DESC16(0xB0),
+    GP0_DESC16(0xC0), GP0_DESC16(0xD0), GP0_DESC16(0xE0), GP0_DESC16(0xF0),
+};
+
+#endif
@@ -27,4 +27,25 @@
 // audio pause when the application returns from the background.
 int Psyz_AudioIsPaused(void);
 
+// GPU DMA channel, implemented by libgpu.c for the DMA controller emulation.
+// Block transfers move the VRAM area set by the last GP0 A0/C0 command.
+void Psyz_GpuDmaBlock(void* addr, int from_ram);
+void Psyz_GpuDmaLinkedList(void* ot);
+// ot_last points to the last of the n entries, the fill goes backward
+void Psyz_GpuDmaClearOTag(void* ot_last, int n);
+
+// Marks the end of a frame for the GPU trace and ordering table profiler
+void Psyz_GpuVSync(void);
+
+// Frame skipping, see PSYZ_FRAMESKIP_DRAW. While enabled, the primitives
+// drawn into the display framebuffers are recorded rather than rasterized.
+void Psyz_GpuSetDeferDraw(int enable);
+// Called before presenting. Returns 1 when the framebuffer on display is
+// missing recorded drawing and may_skip allows to leave it that way,
+// otherwise rasterizes what was recorded and returns 0.
+int Psyz_GpuPrepareDisplay(int may_skip);
+// Rasterizes what was recorded over an area, for the readers of VRAM that do
+// not go through libgpu
+void Psyz_GpuDrawDeferred(int x, int y, int w, int h);
+
 #endif
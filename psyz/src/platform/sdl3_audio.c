@@ -3,6 +3,7 @@
 #include <SDL3/SDL.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include "sdl3_record.h"
 
 #define N_CHANNELS 2
 #define SAMPLE_SIZE sizeof(short)
@@ -27,6 +28,7 @@ static void SDLCALL audio_callback(void* userdata, SDL_AudioStream* stream,
         if (batch > 2048)
             batch = 2048;
         Psyz_SpuPullSamples(buf, batch);
+        Record_PushAudio(buf, batch);
         SDL_PutAudioStreamData(stream, buf, batch * N_CHANNELS * SAMPLE_SIZE);
         num_frames -= batch;
     }
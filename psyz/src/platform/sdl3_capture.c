@@ -0,0 +1,273 @@
+// Frame capture of the SDL3 backends, see sdl3_capture.h. The game thread
+// only copies out the pixels of the display area; converting them and
+// running the callback happen on the capture thread, so a slow consumer
+// costs dropped frames rather than game time.
+#include <psyz.h>
+#include <psyz/log.h>
+#include <SDL3/SDL.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../internal.h"
+#include "sdl3_capture.h"
+#include "sdl3_pixel.h"
+
+// one being filled, one being delivered and two waiting in between
+#define CAPTURE_BUFFERS 4
+
+typedef enum {
+    BUFFER_FREE,
+    BUFFER_FILLING, // owned by the game thread
+    BUFFER_QUEUED,  // owned by the capture thread from here on
+} BufferState;
+
+typedef struct {
+    BufferState state;
+    u8* pixels; // as handed over by the backend
+    size_t cap;
+    u8* converted;
+    size_t converted_cap;
+    int w, h;
+    CaptureSource source;
+    unsigned long long frame;
+} CaptureBuffer;
+
+static CaptureBuffer capture_buffers[CAPTURE_BUFFERS];
+static int capture_queue[CAPTURE_BUFFERS]; // oldest frame first
+static int capture_queue_first = 0;
+static int capture_queue_count = 0;
+static SDL_Mutex* capture_lock = NULL;
+static SDL_Condition* capture_wake = NULL;
+static SDL_Thread* capture_thread = NULL;
+static bool capture_quit = false;
+static PsyzCaptureCallback capture_cb = NULL;
+static void* capture_userdata = NULL;
+static PsyzCaptureFormat capture_format = PSYZ_CAPTURE_RGB888;
+static unsigned long long capture_drops = 0;
+
+static bool Reserve(u8** buf, size_t* cap, size_t size) {
+    if (size <= *cap) {
+        return true;
+    }
+    u8* grown = realloc(*buf, size);
+    if (!grown) {
+        return false;
+    }
+    *buf = grown;
+    *cap = size;
+    return true;
+}
+
+// Returns the pixels in the requested format, or NULL when out of memory
+static const void* Convert(CaptureBuffer* buf, PsyzCaptureFormat format) {
+    const size_t n = (size_t)buf->w * buf->h;
+    if (buf->source == CAPTURE_SOURCE_RGB5551) {
+        if (format == PSYZ_CAPTURE_RGB5551) {
+            return buf->pixels;
+        }
+        if (!Reserve(&buf->converted, &buf->converted_cap, n * 4)) {
+            return NULL;
+        }
+        const u16* src = (const u16*)buf->pixels;
+        if (format == PSYZ_CAPTURE_RGBA8888) {
+            Pixel_Rgb5551ToRgba8888(src, buf->converted, n);
+            return buf->converted;
+        }
+        // there is no direct kernel, each row goes through RGBA8888
+        u8 row[VRAM_W * 4];
+        for (int y = 0; y < buf->h; y++) {
+            Pixel_Rgb5551ToRgba8888(&src[y * buf->w], row, buf->w);
+            Pixel_Rgba8888ToRgb888(
+                row, &buf->converted[(size_t)y * buf->w * 3], buf->w);
+        }
+        return buf->converted;
+    }
+    if (format == PSYZ_CAPTURE_RGBA8888) {
+        return buf->pixels;
+    }
+    if (!Reserve(&buf->converted, &buf->converted_cap, n * 3)) {
+        return NULL;
+    }
+    if (format == PSYZ_CAPTURE_RGB888) {
+        Pixel_Rgba8888ToRgb888(buf->pixels, buf->converted, n);
+    } else {
+        Pixel_Rgba8888ToRgb5551(buf->pixels, (u16*)buf->converted, n);
+    }
+    return buf->converted;
+}
+
+static int SDLCALL CaptureMain(void* userdata) {
+    (void)userdata;
+    SDL_LockMutex(capture_lock);
+    while (true) {
+        while (!capture_queue_count && !capture_quit) {
+            SDL_WaitCondition(capture_wake, capture_lock);
+        }
+        if (!capture_queue_count) {
+            break; // quitting, and every queued frame was delivered
+        }
+        const int next = capture_queue[capture_queue_first];
+        CaptureBuffer* buf = &capture_buffers[next];
+        capture_queue_first = (capture_queue_first + 1) % CAPTURE_BUFFERS;
+        capture_queue_count--;
+        const PsyzCaptureCallback cb = capture_cb;
+        void* cb_userdata = capture_userdata;
+        const PsyzCaptureFormat format = capture_format;
+        SDL_UnlockMutex(capture_lock);
+
+        const void* pixels = Convert(buf, format);
+        if (pixels) {
+            const PsyzCapturedFrame frame = {
+                .pixels = pixels,
+                .width = buf->w,
+                .height = buf->h,
+                .format = format,
+                .frame = buf->frame,
+            };
+            cb(&frame, cb_userdata);
+        } else {
+            ERRORF("out of memory converting frame %llu", buf->frame);
+        }
+
+        SDL_LockMutex(capture_lock);
+        buf->state = BUFFER_FREE;
+    }
+    SDL_UnlockMutex(capture_lock);
+    return 0;
+}
+
+int Psyz_VideoCaptureStart(
+    PsyzCaptureCallback callback, void* userdata, PsyzCaptureFormat format) {
+    if (!callback || format < PSYZ_CAPTURE_RGB888 ||
+        format > PSYZ_CAPTURE_RGB5551) {
+        return -1;
+    }
+    if (capture_thread) {
+        SDL_LockMutex(capture_lock);
+        capture_cb = callback;
+        capture_userdata = userdata;
+        capture_format = format;
+        SDL_UnlockMutex(capture_lock);
+        return 0;
+    }
+    capture_cb = callback;
+    capture_userdata = userdata;
+    capture_format = format;
+    capture_lock = SDL_CreateMutex();
+    capture_wake = SDL_CreateCondition();
+    if (!capture_lock || !capture_wake) {
+        WARNF("failed to create the capture thread lock: %s", SDL_GetError());
+        Psyz_VideoCaptureStop();
+        return -1;
+    }
+    capture_quit = false;
+    capture_thread = SDL_CreateThread(CaptureMain, "psyz-capture", NULL);
+    if (!capture_thread) {
+        WARNF("SDL_CreateThread: %s", SDL_GetError());
+        Psyz_VideoCaptureStop();
+        return -1;
+    }
+    return 0;
+}
+
+void Psyz_VideoCaptureStop(void) {
+    if (capture_thread) {
+        SDL_LockMutex(capture_lock);
+        capture_quit = true;
+        SDL_SignalCondition(capture_wake);
+        SDL_UnlockMutex(capture_lock);
+        SDL_WaitThread(capture_thread, NULL);
+        capture_thread = NULL;
+    }
+    if (capture_wake) {
+        SDL_DestroyCondition(capture_wake);
+        capture_wake = NULL;
+    }
+    if (capture_lock) {
+        SDL_DestroyMutex(capture_lock);
+        capture_lock = NULL;
+    }
+    for (int i = 0; i < CAPTURE_BUFFERS; i++) {
+        free(capture_buffers[i].pixels);
+        free(capture_buffers[i].converted);
+        memset(&capture_buffers[i], 0, sizeof(capture_buffers[i]));
+    }
+    capture_queue_first = 0;
+    capture_queue_count = 0;
+    capture_cb = NULL;
+    capture_userdata = NULL;
+}
+
+bool Capture_IsActive(void) { return capture_thread != NULL; }
+
+static CaptureBuffer* FindBuffer(const void* pixels) {
+    for (int i = 0; i < CAPTURE_BUFFERS; i++) {
+        if (capture_buffers[i].state == BUFFER_FILLING &&
+            capture_buffers[i].pixels == pixels) {
+            return &capture_buffers[i];
+        }
+    }
+    return NULL;
+}
+
+void* Capture_Begin(
+    int w, int h, CaptureSource source, unsigned long long frame) {
+    // only RGBA8888 frames come upscaled, see the row buffer of Convert
+    const int scale =
+        source == CAPTURE_SOURCE_RGBA8888 ? PSYZ_INTERNAL_RES_MAX : 1;
+    if (!capture_thread || w <= 0 || h <= 0 || w > VRAM_W * scale ||
+        h > VRAM_H * scale) {
+        return NULL;
+    }
+    CaptureBuffer* buf = NULL;
+    SDL_LockMutex(capture_lock);
+    for (int i = 0; i < CAPTURE_BUFFERS; i++) {
+        if (capture_buffers[i].state == BUFFER_FREE) {
+            buf = &capture_buffers[i];
+            buf->state = BUFFER_FILLING;
+            break;
+        }
+    }
+    SDL_UnlockMutex(capture_lock);
+    if (!buf) {
+        capture_drops++;
+        return NULL;
+    }
+    const size_t bpp = source == CAPTURE_SOURCE_RGBA8888 ? 4 : 2;
+    if (!Reserve(&buf->pixels, &buf->cap, (size_t)w * h * bpp)) {
+        Capture_Cancel(buf->pixels);
+        return NULL;
+    }
+    buf->w = w;
+    buf->h = h;
+    buf->source = source;
+    buf->frame = frame;
+    return buf->pixels;
+}
+
+void Capture_Commit(void* pixels) {
+    CaptureBuffer* buf = FindBuffer(pixels);
+    if (!buf) {
+        return;
+    }
+    SDL_LockMutex(capture_lock);
+    buf->state = BUFFER_QUEUED;
+    capture_queue[(capture_queue_first + capture_queue_count) %
+                  CAPTURE_BUFFERS] = (int)(buf - capture_buffers);
+    capture_queue_count++;
+    SDL_SignalCondition(capture_wake);
+    SDL_UnlockMutex(capture_lock);
+}
+
+void Capture_Cancel(void* pixels) {
+    CaptureBuffer* buf = FindBuffer(pixels);
+    if (buf) {
+        SDL_LockMutex(capture_lock);
+        buf->state = BUFFER_FREE;
+        SDL_UnlockMutex(capture_lock);
+        capture_drops++;
+    }
+}
+
+void Capture_Drop(void) { capture_drops++; }
+
+unsigned long long Capture_Drops(void) { return capture_drops; }
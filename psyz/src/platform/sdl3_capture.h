@@ -0,0 +1,40 @@
+// Private header for the frame capture of the SDL3 backends
+// Not part of the public API - do not include from external code
+
+#ifndef SDL3_CAPTURE_H
+#define SDL3_CAPTURE_H
+
+#include <psyz.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// how the backend hands over the pixels of the display area
+typedef enum {
+    CAPTURE_SOURCE_RGBA8888, // the VRAM of the hardware renderers
+    CAPTURE_SOURCE_RGB5551,  // VRAM words
+} CaptureSource;
+
+// Implements Psyz_VideoCaptureStart. The frames go through a small pool of
+// buffers: the backend fills one with a presented frame from the game
+// thread, then the capture thread converts it and calls the callback.
+bool Capture_IsActive(void);
+// Returns the buffer to write the w*h pixels of the frame to, or NULL when
+// the capture is stopped or all buffers are in use, which drops the frame.
+void* Capture_Begin(
+    int w, int h, CaptureSource source, unsigned long long frame);
+// queues the buffer returned by Capture_Begin for delivery
+void Capture_Commit(void* pixels);
+// returns the buffer to the pool without delivering it
+void Capture_Cancel(void* pixels);
+// for the backends dropping a frame before it reached Capture_Begin
+void Capture_Drop(void);
+unsigned long long Capture_Drops(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
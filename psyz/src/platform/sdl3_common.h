@@ -12,6 +12,7 @@
 #include <psyz/overlay.h>
 #include <psyz/overlay_sdl3.h>
 #include "../internal.h"
+#include "sdl3_pacer.h"
 #ifdef PLATFORM_IOS
 #include "../ios/ios_platform.h"
 #endif
@@ -22,7 +23,11 @@
 #define RECT PS1_RECT
 #include "libgpu.h"
 #include "../draw.h"
+#include "../gp0.h"
+#include "../test_hooks.h"
 #undef RECT
+#include "sdl3_capture.h"
+#include "sdl3_pixel.h"
 
 #define VSYNC_NTSC 59.94
 #define VSYNC_PAL 50.0
@@ -30,6 +35,8 @@
 // hooks the including renderer backend must implement
 static void PlatformBackend_SetDriverVsync(bool enable);
 static void PlatformBackend_Present(void);
+// frame skipping: like Present, without showing anything
+static void PlatformBackend_SkipPresent(void);
 static void QuitPlatform(void);
 
 #ifndef PSYZ_TITLE
@@ -68,27 +75,6 @@ static inline u8 color_5to8(unsigned int c5) {
 static inline unsigned int color_8to5(unsigned int c8) {
     return (c8 * 31 + 127) / 255;
 }
-static void ConvertRgb5551ToRgba8888(const u16* src, u8* dst, size_t pixels) {
-    for (size_t i = 0; i < pixels; i++) {
-        u16 v = src[i];
-        dst[0] = color_5to8(v & 0x1F);
-        dst[1] = color_5to8((v >> 5) & 0x1F);
-        dst[2] = color_5to8((v >> 10) & 0x1F);
-        dst[3] = (v & 0x8000) ? 0xFF : 0x00;
-        dst += 4;
-    }
-}
-static void ConvertRgba8888ToRgb5551(const u8* src, u16* dst, size_t pixels) {
-    for (size_t i = 0; i < pixels; i++) {
-        u16 v = (u16)color_8to5(src[0]);
-        v |= (u16)(color_8to5(src[1]) << 5);
-        v |= (u16)(color_8to5(src[2]) << 10);
-        v |= (src[3] >= 0x80) ? 0x8000 : 0;
-        dst[i] = v;
-        src += 4;
-    }
-}
-
 static inline bool RectsOverlap(
     int src_x, int src_y, int dst_x, int dst_y, int w, int h) {
     return src_x < dst_x + w && dst_x < src_x + w && src_y < dst_y + h &&
@@ -180,6 +166,61 @@ int Psyz_VideoSetAspectMode(PsyzAspectMode mode) {
 
 PsyzAspectMode Psyz_VideoGetAspectMode(void) { return aspect_mode; }
 
+static PsyzReadbackMode readback_mode = PSYZ_READBACK_DRAWSYNC;
+int Psyz_VideoSetReadbackMode(PsyzReadbackMode mode) {
+    if (mode != PSYZ_READBACK_SYNC && mode != PSYZ_READBACK_DRAWSYNC &&
+        mode != PSYZ_READBACK_NEXT_FRAME) {
+        return -1;
+    }
+    readback_mode = mode;
+    return 0;
+}
+
+PsyzReadbackMode Psyz_VideoGetReadbackMode(void) { return readback_mode; }
+
+// Only the backends that can acquire the swapchain without waiting queue
+// frames, by defining SDL3_BACKEND_PRESENT_QUEUE before including this file.
+static unsigned present_queue_depth = 0;
+int Psyz_VideoSetPresentQueue(unsigned depth) {
+    if (depth > PSYZ_PRESENT_QUEUE_MAX) {
+        return -1;
+    }
+#ifndef SDL3_BACKEND_PRESENT_QUEUE
+    if (depth) {
+        WARNF("present queue not supported by this renderer");
+        return -1;
+    }
+#endif
+    present_queue_depth = depth;
+    return 0;
+}
+
+unsigned Psyz_VideoGetPresentQueue(void) { return present_queue_depth; }
+
+// a frame is late past this share of the frame time budget, so that the
+// pacing jitter of a frame on time does not count
+#define FRAMESKIP_LATE_LOAD 1.10
+static PsyzFrameSkipMode frameskip_mode = PSYZ_FRAMESKIP_OFF;
+static bool frameskip_late = false; // the last frame overran its budget
+static bool frameskip_force = false; // every frame counts as late
+static unsigned frameskip_run = 0;  // frames skipped in a row
+int Psyz_VideoSetFrameSkip(PsyzFrameSkipMode mode) {
+    if (mode < PSYZ_FRAMESKIP_OFF || mode > PSYZ_FRAMESKIP_DRAW) {
+        return -1;
+    }
+    frameskip_mode = mode;
+    if (mode != PSYZ_FRAMESKIP_DRAW) {
+        Psyz_GpuSetDeferDraw(0);
+    }
+    return 0;
+}
+
+PsyzFrameSkipMode Psyz_VideoGetFrameSkip(void) { return frameskip_mode; }
+
+#ifdef PSYZ_TEST_HOOKS
+void TestHook_ForceLateFrames(int enable) { frameskip_force = enable != 0; }
+#endif
+
 static Uint32 elapsed_from_beginning = 0;
 static Uint32 last_vsync = 0;
 
@@ -189,12 +230,131 @@ static double target_frame_time_us = 1000000.0 / VSYNC_NTSC;
 static Uint64 perf_frequency = 0;
 static Uint64 last_frame_time = 0;
 static Uint64 finish_time = 0;
-static double drift_compensation = 0.0;
 static PsyzVsyncMode vsync_mode = PSYZ_VSYNC_AUTO;
 static PsyzDitherMode dither_mode = PSYZ_DITHER_AUTO;
 static bool use_driver_vsync = false;
 static PsyzVideoStats gpu_stats = {0};
 
+// Automatic internal resolution: the render time is averaged over a window
+// of frames, then compared against the budget. Stepping down only takes a
+// late window, stepping up takes the cost projected for the next multiplier
+// (in pixels) to fit well under the budget. Each step down doubles the
+// windows to wait before trying to step up again.
+#define AUTO_RES_WINDOW 30
+#define AUTO_RES_SETTLE 60 // frames to ignore after a change
+#define AUTO_RES_DOWN_LOAD 0.90
+#define AUTO_RES_UP_LOAD 0.75
+#define AUTO_RES_MAX_HOLD 64
+static unsigned auto_res_max = 0;
+static unsigned long long auto_res_frame = 0;
+static double auto_res_load = 0.0;
+static int auto_res_samples = 0;
+static int auto_res_settle = 0;
+static int auto_res_hold = 1;
+static int auto_res_wait = 0;
+
+int Psyz_VideoSetAutoInternalResolution(unsigned max_multiplier) {
+    if (max_multiplier > PSYZ_INTERNAL_RES_MAX) {
+        WARNF("internal resolution %dx exceeds maximum value of %dx",
+              max_multiplier, PSYZ_INTERNAL_RES_MAX);
+        return -1;
+    }
+    auto_res_max = max_multiplier;
+    auto_res_load = 0.0;
+    auto_res_samples = 0;
+    auto_res_settle = 0;
+    auto_res_hold = 1;
+    auto_res_wait = 0;
+    return 0;
+}
+
+unsigned Psyz_VideoGetAutoInternalResolution(void) { return auto_res_max; }
+
+// the multiplier to render the next frame at, from the last frame timings
+static unsigned AutoInternalRes(unsigned cur) {
+    if (!auto_res_max) {
+        return cur;
+    }
+    if (cur > auto_res_max) {
+        return auto_res_max;
+    }
+    if (gpu_stats.total_frames == auto_res_frame ||
+        gpu_stats.target_frame_time_us <= 0.0) {
+        return cur;
+    }
+    auto_res_frame = gpu_stats.total_frames;
+    if (auto_res_settle > 0) {
+        auto_res_settle--;
+        return cur;
+    }
+    auto_res_load +=
+        gpu_stats.last_draw_time_us / gpu_stats.target_frame_time_us;
+    if (++auto_res_samples < AUTO_RES_WINDOW) {
+        return cur;
+    }
+    const double load = auto_res_load / auto_res_samples;
+    auto_res_load = 0.0;
+    auto_res_samples = 0;
+    unsigned next = cur;
+    if (load > AUTO_RES_DOWN_LOAD && cur > 1) {
+        next = cur - 1;
+        auto_res_hold = SDL_min(auto_res_hold * 2, AUTO_RES_MAX_HOLD);
+        auto_res_wait = auto_res_hold;
+    } else if (auto_res_wait > 0) {
+        auto_res_wait--;
+    } else if (cur < auto_res_max) {
+        const double growth = (double)((cur + 1) * (cur + 1)) / (cur * cur);
+        if (load * growth < AUTO_RES_UP_LOAD) {
+            next = cur + 1;
+        }
+    }
+    if (next != cur) {
+        auto_res_settle = AUTO_RES_SETTLE;
+        INFOF("frame load %.0f%% at %dx, internal resolution to %dx",
+              load * 100.0, cur, next);
+    }
+    return next;
+}
+
+// pipeline counters of the frame being drawn and of the last presented one
+static PsyzVideoPipelineStats pipe_stats = {0};
+static PsyzVideoPipelineStats pipe_stats_frame = {0};
+// set by the game thread, consumed by the render thread when there is one
+static SDL_AtomicInt flush_reason;
+
+void Draw_SetFlushReason(int reason) {
+    SDL_SetAtomicInt(&flush_reason, reason);
+}
+
+static void Draw_FlushBufferFor(PsyzFlushReason reason) {
+    Draw_SetFlushReason(reason);
+    Draw_FlushBuffer();
+}
+
+// every Draw_FlushBuffer consumes the reason, even when there is nothing to
+// draw, so a stale tag never leaks into an unrelated flush
+static inline PsyzFlushReason TakeFlushReason(void) {
+    int reason = SDL_SetAtomicInt(&flush_reason, PSYZ_FLUSH_EXEQUE);
+    if (reason < 0 || reason >= PSYZ_FLUSH_REASON_COUNT) {
+        return PSYZ_FLUSH_EXEQUE;
+    }
+    return (PsyzFlushReason)reason;
+}
+
+static inline void CountPrim(u32 tag) {
+    switch (gp0_desc[tag >> 24].kind) {
+    case GP0_KIND_POLY:
+        pipe_stats.polys++;
+        break;
+    case GP0_KIND_LINE:
+        pipe_stats.lines++;
+        break;
+    case GP0_KIND_RECT:
+        pipe_stats.rects++;
+        break;
+    }
+}
+
 static unsigned draw_grid_source_width = 1;
 static unsigned draw_grid_target_width = 1;
 
@@ -211,7 +371,7 @@ int Draw_SetHorizontalGrid(
         draw_grid_target_width == target_width) {
         return 0;
     }
-    Draw_FlushBuffer();
+    Draw_FlushBufferFor(PSYZ_FLUSH_STATE);
     draw_grid_source_width = source_width;
     draw_grid_target_width = target_width;
     return 0;
@@ -313,7 +473,7 @@ static void ConfigureVSync(double target_fps) {
 static void UpdateTargetFramerate(double fps) {
     target_frame_rate = fps;
     target_frame_time_us = 1000000.0 / fps;
-    drift_compensation = 0.0;
+    Pacer_SetPeriod(target_frame_time_us);
     last_frame_time = SDL_GetPerformanceCounter();
     ConfigureVSync(target_frame_rate);
 }
@@ -379,7 +539,7 @@ static void Sdl3Common_ApplyPendingTimingReset(void) {
         return;
     }
     SDL_SetAtomicInt(&timing_reset_requested, 0);
-    drift_compensation = 0.0;
+    Pacer_Reset();
     last_frame_time = SDL_GetPerformanceCounter();
     finish_time = last_frame_time;
     last_vsync = (Uint32)SDL_GetTicks();
@@ -409,7 +569,225 @@ static void Sdl3Common_TimingInit(void) {
     UpdateTargetFramerate(VSYNC_NTSC);
 }
 
+// GPU thread: GP0 words are copied into a single-producer single-consumer
+// ring by the game thread and decoded by a dedicated render thread. Only the
+// backends that never touch a graphics context while decoding opt in by
+// defining SDL3_BACKEND_THREADED_DRAW before including this file.
+#ifdef SDL3_BACKEND_THREADED_DRAW
+#define GPU_RING_SIZE 0x10000 // in words, must be a power of two
+#define GPU_RING_MASK (GPU_RING_SIZE - 1)
+#define GPU_RING_PACKETS 0x00000000
+#define GPU_RING_FLUSH 0x40000000
+#define GPU_RING_WRAP 0x80000000
+#define GPU_RING_LEN_MASK 0x00FFFFFF
+// largest submission, so that it always fits next to the wrap padding
+#define GPU_RING_CHUNK (GPU_RING_SIZE / 2 - 1)
+
+static u32 gpu_ring[GPU_RING_SIZE];
+static SDL_AtomicInt gpu_ring_head = {0}; // only written by the game thread
+static SDL_AtomicInt gpu_ring_tail = {0}; // only written by the render thread
+static SDL_AtomicInt gpu_ring_waiting = {0};
+static SDL_AtomicInt gpu_ring_full = {0}; // the game thread waits for space
+static SDL_Semaphore* gpu_ring_work = NULL;
+static SDL_Semaphore* gpu_ring_idle = NULL;
+static SDL_Semaphore* gpu_ring_space = NULL;
+static SDL_Thread* gpu_thread = NULL;
+static SDL_ThreadID gpu_thread_id = 0;
+static bool gpu_thread_quit = false;
+static void (*gpu_thread_dispatch)(u32* words, int len) = NULL;
+
+static u32 GpuRingUsed(void) {
+    return (u32)SDL_GetAtomicInt(&gpu_ring_head) -
+           (u32)SDL_GetAtomicInt(&gpu_ring_tail);
+}
+
+static int SDLCALL GpuThreadMain(void* userdata) {
+    (void)userdata;
+    for (;;) {
+        SDL_WaitSemaphore(gpu_ring_work);
+        u32 tail = (u32)SDL_GetAtomicInt(&gpu_ring_tail);
+        while (tail != (u32)SDL_GetAtomicInt(&gpu_ring_head)) {
+            const u32 header = gpu_ring[tail & GPU_RING_MASK];
+            const u32 len = header & GPU_RING_LEN_MASK;
+            if (header & GPU_RING_WRAP) {
+                tail += len;
+            } else if (header & GPU_RING_FLUSH) {
+                Draw_FlushBuffer();
+                Draw_ExequeSync();
+                tail++;
+            } else {
+                gpu_thread_dispatch(&gpu_ring[(tail + 1) & GPU_RING_MASK],
+                                    (int)len);
+                tail += len + 1;
+            }
+            // the slot is released only once its words are fully consumed
+            SDL_SetAtomicInt(&gpu_ring_tail, (int)tail);
+            if (SDL_GetAtomicInt(&gpu_ring_full) &&
+                SDL_CompareAndSwapAtomicInt(&gpu_ring_full, 1, 0)) {
+                SDL_SignalSemaphore(gpu_ring_space);
+            }
+        }
+        if (SDL_CompareAndSwapAtomicInt(&gpu_ring_waiting, 1, 0)) {
+            SDL_SignalSemaphore(gpu_ring_idle);
+        }
+        if (gpu_thread_quit) {
+            break;
+        }
+    }
+    return 0;
+}
+
+// reserves n contiguous words, blocking while the render thread catches up
+static u32* GpuRingReserve(u32 n) {
+    u32 head = (u32)SDL_GetAtomicInt(&gpu_ring_head);
+    u32 pad = GPU_RING_SIZE - (head & GPU_RING_MASK);
+    if (pad >= n) {
+        pad = 0;
+    }
+    while (GPU_RING_SIZE - GpuRingUsed() < n + pad) {
+        // the render thread clears the flag and signals once it frees a slot
+        SDL_SetAtomicInt(&gpu_ring_full, 1);
+        SDL_SignalSemaphore(gpu_ring_work);
+        if (GPU_RING_SIZE - GpuRingUsed() >= n + pad &&
+            SDL_CompareAndSwapAtomicInt(&gpu_ring_full, 1, 0)) {
+            break;
+        }
+        SDL_WaitSemaphore(gpu_ring_space);
+    }
+    if (pad) {
+        gpu_ring[head & GPU_RING_MASK] = GPU_RING_WRAP | pad;
+        SDL_SetAtomicInt(&gpu_ring_head, (int)(head + pad));
+        head += pad;
+    }
+    return &gpu_ring[head & GPU_RING_MASK];
+}
+
+static void GpuRingCommit(u32 n) {
+    SDL_AddAtomicInt(&gpu_ring_head, (int)n);
+    SDL_SignalSemaphore(gpu_ring_work);
+}
+
+int Draw_ThreadStart(void (*dispatch)(u32* words, int len)) {
+    if (gpu_thread) {
+        return 0;
+    }
+    gpu_ring_work = SDL_CreateSemaphore(0);
+    gpu_ring_idle = SDL_CreateSemaphore(0);
+    gpu_ring_space = SDL_CreateSemaphore(0);
+    if (!gpu_ring_work || !gpu_ring_idle || !gpu_ring_space) {
+        WARNF("failed to create GPU thread semaphores: %s", SDL_GetError());
+        Draw_ThreadStop();
+        return -1;
+    }
+    SDL_SetAtomicInt(&gpu_ring_head, 0);
+    SDL_SetAtomicInt(&gpu_ring_tail, 0);
+    SDL_SetAtomicInt(&gpu_ring_waiting, 0);
+    SDL_SetAtomicInt(&gpu_ring_full, 0);
+    gpu_thread_dispatch = dispatch;
+    gpu_thread_quit = false;
+    gpu_thread = SDL_CreateThread(GpuThreadMain, "psyz-gpu", NULL);
+    if (!gpu_thread) {
+        WARNF("SDL_CreateThread: %s", SDL_GetError());
+        Draw_ThreadStop();
+        return -1;
+    }
+    gpu_thread_id = SDL_GetThreadID(gpu_thread);
+    return 0;
+}
+
+void Draw_ThreadSync(void) {
+    if (!gpu_thread || SDL_GetCurrentThreadID() == gpu_thread_id) {
+        return;
+    }
+    SDL_SetAtomicInt(&gpu_ring_waiting, 1);
+    if (!GpuRingUsed() &&
+        SDL_CompareAndSwapAtomicInt(&gpu_ring_waiting, 1, 0)) {
+        return;
+    }
+    // the render thread clears the flag and signals once the ring is empty
+    SDL_WaitSemaphore(gpu_ring_idle);
+}
+
+void Draw_ThreadStop(void) {
+    if (gpu_thread) {
+        Draw_ThreadSync();
+        gpu_thread_quit = true;
+        SDL_SignalSemaphore(gpu_ring_work);
+        SDL_WaitThread(gpu_thread, NULL);
+        gpu_thread = NULL;
+        gpu_thread_id = 0;
+    }
+    if (gpu_ring_idle) {
+        SDL_DestroySemaphore(gpu_ring_idle);
+        gpu_ring_idle = NULL;
+    }
+    if (gpu_ring_space) {
+        SDL_DestroySemaphore(gpu_ring_space);
+        gpu_ring_space = NULL;
+    }
+    if (gpu_ring_work) {
+        SDL_DestroySemaphore(gpu_ring_work);
+        gpu_ring_work = NULL;
+    }
+}
+
+void Draw_ThreadSubmit(const u32* words, int len) {
+    if (!gpu_thread) {
+        gpu_thread_dispatch((u32*)words, len);
+        return;
+    }
+    while (len > 0) {
+        // larger submissions are split between packets, so that each part
+        // still decodes on its own. Only a custom command longer than a
+        // part gets cut, its handler then sees fewer words available.
+        int n = len;
+        if (n > GPU_RING_CHUNK) {
+            n = 0;
+            while (n < len) {
+                int pkt = gp0_desc[words[n] >> 24].len;
+                pkt = pkt > 0 ? pkt : 1;
+                if (n + pkt > GPU_RING_CHUNK) {
+                    break;
+                }
+                n += pkt;
+            }
+            if (!n) {
+                n = GPU_RING_CHUNK;
+            }
+        }
+        u32* dst = GpuRingReserve((u32)n + 1);
+        dst[0] = GPU_RING_PACKETS | (u32)n;
+        memcpy(dst + 1, words, sizeof(*words) * n);
+        GpuRingCommit((u32)n + 1);
+        words += n;
+        len -= n;
+    }
+}
+
+void Draw_ThreadFlush(void) {
+    if (!gpu_thread) {
+        Draw_FlushBuffer();
+        Draw_ExequeSync();
+        return;
+    }
+    *GpuRingReserve(1) = GPU_RING_FLUSH;
+    GpuRingCommit(1);
+}
+
+int Draw_ThreadPending(void) { return gpu_thread ? (int)GpuRingUsed() : 0; }
+#else
+int Draw_ThreadStart(void (*dispatch)(u32* words, int len)) { return -1; }
+void Draw_ThreadStop(void) {}
+void Draw_ThreadSubmit(const u32* words, int len) {}
+void Draw_ThreadFlush(void) {}
+void Draw_ThreadSync(void) {}
+int Draw_ThreadPending(void) { return 0; }
+#endif
+
 static void Sdl3Common_Shutdown(void) {
+    Draw_ThreadStop();
+    Psyz_VideoRecordStop();
+    Psyz_VideoCaptureStop();
     if (app_event_watch_installed) {
         SDL_RemoveEventWatch(Sdl3Common_AppEventWatch, NULL);
         app_event_watch_installed = false;
@@ -423,43 +801,12 @@ static void Sdl3Common_Shutdown(void) {
 }
 
 static void WaitForNextFrame(void) {
-    Uint64 current_time = SDL_GetPerformanceCounter();
-    double elapsed_us = GetElapsedMicroseconds(last_frame_time, current_time);
-
+    PacerStats pacing = {0};
     if (!use_driver_vsync && vsync_mode != PSYZ_VSYNC_LIMITLESS) {
-        double time_to_wait_us =
-            target_frame_time_us - elapsed_us + drift_compensation;
-
-        // only wait if we're ahead of schedule (not running slow)
-        if (time_to_wait_us > 100.0) { // more than 0.1ms to wait
-            // High-precision mode: sleep + busy-wait
-            if (time_to_wait_us > 1000.0) {
-                Uint64 sleep_us = (Uint64)(time_to_wait_us - 1000.0);
-                SDL_DelayNS(sleep_us * 1000);
-            }
-
-            // busy-wait for precision
-            double target_elapsed = target_frame_time_us + drift_compensation;
-            while (GetElapsedMicroseconds(
-                       last_frame_time, SDL_GetPerformanceCounter()) <
-                   target_elapsed) {
-            }
-        }
-
-        // measure actual frame time and compensate drift
-        Uint64 frame_end_time = SDL_GetPerformanceCounter();
-        double actual_frame_time =
-            GetElapsedMicroseconds(last_frame_time, frame_end_time);
-        double frame_error = actual_frame_time - target_frame_time_us;
-
-        // apply gentle correction (10% per frame)
-        drift_compensation -= frame_error * 0.1;
-        if (drift_compensation > 5000.0) {
-            drift_compensation = 5000.0;
-        }
-        if (drift_compensation < -5000.0) {
-            drift_compensation = -5000.0;
-        }
+        Pacer_Wait(&pacing);
+    } else {
+        // the limiter picks up from here if it gets turned back on
+        Pacer_Reset();
     }
 
     Uint64 frame_end_time = SDL_GetPerformanceCounter();
@@ -470,10 +817,42 @@ static void WaitForNextFrame(void) {
     gpu_stats.target_frame_time_us = target_frame_time_us;
     gpu_stats.total_frames++;
     gpu_stats.using_driver_vsync = use_driver_vsync;
+    gpu_stats.pacing_error_us = pacing.error_us;
+    gpu_stats.wait_cpu_us = pacing.wait_cpu_us;
+    pipe_stats_frame = pipe_stats;
+    memset(&pipe_stats, 0, sizeof(pipe_stats));
 
     last_frame_time = frame_end_time;
 }
 
+static bool SkipPresent(void) {
+    const bool may_skip = frameskip_run < PSYZ_FRAMESKIP_MAX_RUN;
+    bool skip = false;
+    switch (frameskip_mode) {
+    case PSYZ_FRAMESKIP_OFF:
+        break;
+    case PSYZ_FRAMESKIP_PRESENT:
+        skip = may_skip && frameskip_late;
+        break;
+    case PSYZ_FRAMESKIP_DRAW:
+        // only the frames whose drawing was deferred are worth skipping,
+        // anything else is rasterized already
+        skip = Psyz_GpuPrepareDisplay(may_skip) != 0;
+        break;
+    }
+    frameskip_run = skip ? frameskip_run + 1 : 0;
+    return skip;
+}
+
+static void UpdateFrameSkip(void) {
+    frameskip_late = frameskip_force ||
+                     gpu_stats.last_frame_time_us >
+                         target_frame_time_us * FRAMESKIP_LATE_LOAD;
+    if (frameskip_mode == PSYZ_FRAMESKIP_DRAW) {
+        Psyz_GpuSetDeferDraw(frameskip_late);
+    }
+}
+
 int Psyz_VideoVSync(int mode) {
     Uint32 cur;
     unsigned short ret;
@@ -486,9 +865,16 @@ int Psyz_VideoVSync(int mode) {
     }
     last_vsync = cur;
     if (mode == 0) {
-        PlatformBackend_Present();
+        Draw_ThreadSync();
+        if (SkipPresent()) {
+            PlatformBackend_SkipPresent();
+            gpu_stats.skipped_frames++;
+        } else {
+            PlatformBackend_Present();
+        }
         PollEvents();
         WaitForNextFrame();
+        UpdateFrameSkip();
     }
     return ret;
 }
@@ -529,8 +915,9 @@ int Psyz_VideoSetDitheringMode(PsyzDitherMode mode) {
     if (dither_mode == mode) {
         return 0;
     }
+    Draw_ThreadSync();
     if (GetCurrentDither() != (mode == PSYZ_DITHER_OFF ? 0 : s_dither)) {
-        Draw_FlushBuffer();
+        Draw_FlushBufferFor(PSYZ_FLUSH_DITHER);
     }
     dither_mode = mode;
     return 0;
@@ -543,6 +930,16 @@ int Psyz_VideoStats(PsyzVideoStats* stats) {
         return -1;
     }
     *stats = gpu_stats;
+    stats->internal_res = Psyz_VideoGetInternalResolution();
+    stats->capture_drops = Capture_Drops();
+    return 0;
+}
+
+int Psyz_VideoPipelineStats(PsyzVideoPipelineStats* stats) {
+    if (!stats || !is_platform_init_successful) {
+        return -1;
+    }
+    *stats = pipe_stats_frame;
     return 0;
 }
 
@@ -950,7 +1347,10 @@ typedef struct {
     SET_TC(p, t, c)                                                            \
     SET_TC(&(p)[1], t, c) SET_TC(&(p)[2], t, c) SET_TC(&(p)[3], t, c)
 
+// a backend may raise it, up to the 64k vertices 16-bit indices can address
+#ifndef MAX_VERTEX_COUNT
 #define MAX_VERTEX_COUNT 4096
+#endif
 #define MAX_INDEX_COUNT (MAX_VERTEX_COUNT / 4 * 6)
 
 #define SEMITRANSP 0x02
@@ -962,9 +1362,9 @@ typedef struct {
 static u_short cur_tpage = 0;
 static Vertex vertex_buf[MAX_VERTEX_COUNT];
 static unsigned short index_buf[MAX_INDEX_COUNT];
-static Vertex* vertex_cur;
-static unsigned short* index_cur;
-static unsigned short n_vertices;
+static Vertex* vertex_cur = vertex_buf;
+static unsigned short* index_cur = index_buf;
+static int n_vertices;
 static int n_indices;
 
 // represents a texture window as a 32-bit integer for fast aligned copies
@@ -977,13 +1377,16 @@ static void Draw_EnsureBufferWillNotOverflow(int vertices, int indices) {
     bool bufferFull = n_vertices + vertices > MAX_VERTEX_COUNT ||
                       n_indices + indices > MAX_INDEX_COUNT;
     if (bufferFull) {
-        Draw_FlushBuffer();
+        Draw_FlushBufferFor(PSYZ_FLUSH_BUFFER_FULL);
     }
 }
 static void Draw_EnqueueBuffer(int vertices, int indices) {
     assert(n_vertices + vertices <= MAX_VERTEX_COUNT);
     assert(n_indices + indices <= MAX_INDEX_COUNT);
 
+    pipe_stats.vertices += vertices;
+    pipe_stats.indices += indices;
+
     vertex_cur += vertices;
     index_cur += indices;
     n_vertices += vertices;
@@ -993,7 +1396,7 @@ static void Draw_EnqueueBuffer(int vertices, int indices) {
 // real hardware use XY coords as signed 11-bit
 static short s11(short v) { return (short)(((v & 0x7FF) ^ 1024) - 1024); }
 
-static int writePacket(Vertex* v, int code, int n, u_long* packet, u16* pOut) {
+static int writePacket(Vertex* v, int code, int n, u32* packet, u16* pOut) {
     int w;
     if (!n) {
         return 0;
@@ -1054,6 +1457,103 @@ static void FixupFlipUV(Vertex* v, int hasFourVertices) {
     }
 }
 
+// ===== primitive fast paths =====
+// Unpack routines specialized through gp0_desc for the primitives that
+// dominate most frames. They produce the same vertices as the generic decoder
+// in Draw_PushPrim without testing the opcode bits field by field.
+
+static bool fast_paths = true; // only turned off by the tests
+#ifdef PSYZ_TEST_HOOKS
+void TestHook_SetFastPaths(int enable) { fast_paths = enable != 0; }
+#endif
+
+static inline u32 PrimRGBA(const u32* packets, int code) {
+    u32 rgba = code & GP0_RAW_TEXTURE ? 0x808080 : packets[0] & 0xFFFFFF;
+    return rgba | (code & GP0_SEMITRANSP ? 0x80000000 : 0xFF000000);
+}
+
+static inline void PushQuadIndices(void) {
+    index_cur[0] = n_vertices + 0;
+    index_cur[1] = n_vertices + 1;
+    index_cur[2] = n_vertices + 2;
+    index_cur[3] = n_vertices + 1;
+    index_cur[4] = n_vertices + 3;
+    index_cur[5] = n_vertices + 2;
+}
+
+// POLY_FT4: color, then xy and uv words for each vertex
+static inline int PushPolyFT4(const u32* packets, int code) {
+    Draw_EnsureBufferWillNotOverflow(4, 6);
+    Vertex* v = vertex_cur;
+    u32 rgba = PrimRGBA(packets, code);
+    u16 clut = (u16)(packets[2] >> 16);
+    u16 tpage = (u16)(packets[4] >> 16);
+    for (int i = 0; i < 4; i++) {
+        u32 xy = packets[1 + i * 2];
+        u32 uv = packets[2 + i * 2];
+        v[i].x = s11((short)(xy & 0xFFFF));
+        v[i].y = s11((short)(xy >> 16));
+        v[i].u = (u8)uv;
+        v[i].v = (u8)(uv >> 8);
+        VRGBA(v[i]) = rgba;
+    }
+    PushQuadIndices();
+    FixupFlipUV(v, 1);
+    if (CanPolyDither(0, 1, !(code & GP0_RAW_TEXTURE))) {
+        tpage |= TPAGE_DITHER;
+    }
+    SET_TC_ALL(v, tpage, clut);
+    Draw_EnqueueBuffer(4, 6);
+    return 9;
+}
+
+// SPRT, SPRT_1, SPRT_8 and SPRT_16: color, xy, uv and clut, optional size
+static inline int PushSprt(const u32* packets, int code, int size) {
+    Draw_EnsureBufferWillNotOverflow(4, 6);
+    Vertex* v = vertex_cur;
+    u32 rgba = PrimRGBA(packets, code);
+    int x = s11((short)(packets[1] & 0xFFFF));
+    int y = s11((short)(packets[1] >> 16));
+    int tu = (u8)packets[2];
+    int tv = (u8)(packets[2] >> 8);
+    u16 clut = (u16)(packets[2] >> 16);
+    int w = size, h = size;
+    if (!size) {
+        w = (s16)(packets[3] & 0xFFFF);
+        h = (s16)(packets[3] >> 16);
+    }
+    for (int i = 0; i < 4; i++) {
+        int dx = i & 1 ? w : 0;
+        int dy = i & 2 ? h : 0;
+        v[i].x = (short)(x + dx);
+        v[i].y = (short)(y + dy);
+        v[i].u = (unsigned short)(tu + dx);
+        v[i].v = (unsigned short)(tv + dy);
+        VRGBA(v[i]) = rgba;
+    }
+    PushQuadIndices();
+    SET_TC_ALL(v, cur_tpage, clut);
+    Draw_EnqueueBuffer(4, 6);
+    return size ? 3 : 4;
+}
+
+// Returns the words consumed, 0 when the packet needs the generic decoder
+static inline int PushPrimFast(const u32* packets, int max_len) {
+    int code = (int)(*packets >> 24);
+    const Gp0Desc* desc = &gp0_desc[code];
+    if (!fast_paths || max_len < desc->len) {
+        return 0;
+    }
+    switch (desc->shape) {
+    case GP0_SHAPE_POLY_FT4:
+        return PushPolyFT4(packets, code);
+    case GP0_SHAPE_SPRT:
+        return PushSprt(packets, code, desc->size);
+    default:
+        return 0;
+    }
+}
+
 static inline bool is_subtract_abr(const Vertex* v) {
     return v->a == 0x80 && (v->t & 0x60) == 0x40;
 }
@@ -1082,10 +1582,12 @@ void Draw_SetTextureWindow(unsigned int mask_x, unsigned int mask_y,
         (unsigned char)((off_x & mask_x) * 8),
         (unsigned char)((off_y & mask_y) * 8));
 }
+#ifndef SDL3_BACKEND_HAS_MASK
 void Draw_SetMask(int bit0, int bit1) {
     if (bit0 || bit1) {
         NOT_IMPLEMENTED;
     }
 }
+#endif
 
 #endif // SDL3_COMMON_H
@@ -26,6 +26,7 @@
 #endif
 
 #include "sdl3_common.h"
+#include "sdl3_shadow.h"
 
 // selected at runtime based on the active GL profile; the shader bodies are
 // shared and must stay legal in both GLSL 330 core and GLSL ES 3.00 (the
@@ -227,6 +228,21 @@ static GLuint scratch_texture = 0;
 static GLuint scratch_fbo = 0;
 static GLuint scaled_vram_texture = 0;
 static GLuint scaled_vram_fbo = 0; // it's vram_fbo * internal_res
+
+// Presented frames read back for the capture into pixel buffers, each with a
+// fence that is only waited on once signalled, a frame or two later, so that
+// capturing never stalls the pipeline.
+#define CAPTURE_SLOTS 3
+typedef struct {
+    GLuint pbo;
+    GLsizeiptr capacity;
+    GLsync sync;
+    int w, h;
+    unsigned long long frame;
+} CaptureSlot;
+static CaptureSlot capture_slots[CAPTURE_SLOTS];
+static int capture_first = 0; // the oldest read back in flight
+static int capture_count = 0;
 static unsigned internal_res = 1;
 static unsigned set_internal_res = 1;
 static GLposi display_area = {0, 0};
@@ -406,6 +422,7 @@ bool InitPlatform() {
     glEnable(GL_BLEND);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, VRAM_W, VRAM_H, 0, GL_RGBA,
                  GL_UNSIGNED_BYTE, NULL);
+    Shadow_Reset();
 
     glGenFramebuffers(1, &vram_fbo);
     glBindFramebuffer(GL_FRAMEBUFFER, vram_fbo);
@@ -471,6 +488,7 @@ static void SyncScaledVramToNative(void) {
     if (x1 <= x0 || y1 <= y0) {
         return;
     }
+    pipe_stats.vram_copy_bytes += (Uint64)(x1 - x0) * (y1 - y0) * 4;
     glDisable(GL_SCISSOR_TEST);
     glBindFramebuffer(GL_READ_FRAMEBUFFER, scaled_vram_fbo);
     glBindFramebuffer(GL_DRAW_FRAMEBUFFER, vram_fbo);
@@ -544,7 +562,7 @@ static void ApplyPendingInternalRes(void) {
     if (n == internal_res) {
         return;
     }
-    Draw_FlushBuffer(); // render pending prims with the old multiplier
+    Draw_FlushBufferFor(PSYZ_FLUSH_STATE); // render prims at the old res
     if (n > 1 && !CreateScaledVramFbo(n)) {
         n = 1;
         set_internal_res = 1;
@@ -569,11 +587,106 @@ static void ApplyPendingInternalRes(void) {
     INFOF("internal resolution set to %dx (%dx%d)", n, VRAM_W * n, VRAM_H * n);
 }
 
+// hands the read backs that completed over to the capture, in frame order
+static void ResolveCaptures(void) {
+    while (capture_count) {
+        CaptureSlot* slot = &capture_slots[capture_first];
+        const GLenum status = glClientWaitSync(slot->sync, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED) {
+            break;
+        }
+        glDeleteSync(slot->sync);
+        slot->sync = NULL;
+        capture_first = (capture_first + 1) % CAPTURE_SLOTS;
+        capture_count--;
+
+        void* dst = Capture_Begin(
+            slot->w, slot->h, CAPTURE_SOURCE_RGBA8888, slot->frame);
+        if (!dst) {
+            continue;
+        }
+        const size_t size = (size_t)slot->w * slot->h * 4;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+        const void* map =
+            glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+        if (!map) {
+            ERRORF("glMapBufferRange failed: 0x%X", glGetError());
+            Capture_Cancel(dst);
+            continue;
+        }
+        memcpy(dst, map, size);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        Capture_Commit(dst);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+// reads the display area back as it is about to be presented
+static void CaptureFrame(void) {
+    if (capture_count == CAPTURE_SLOTS) {
+        Capture_Drop();
+        return;
+    }
+    const int x = display_area.x;
+    const int y = display_area.y;
+    const int w = SDL_min(display_size.x, VRAM_W - x);
+    const int h = SDL_min(display_size.y, VRAM_H - y);
+    if (w <= 0 || h <= 0) {
+        return;
+    }
+    CaptureSlot* slot =
+        &capture_slots[(capture_first + capture_count) % CAPTURE_SLOTS];
+    const GLsizeiptr size = (GLsizeiptr)w * h * 4;
+    if (!slot->pbo) {
+        glGenBuffers(1, &slot->pbo);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+    if (slot->capacity < size) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+        slot->capacity = size;
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, vram_fbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(x, y, w, h, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot->sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    if (!slot->sync) {
+        Capture_Drop();
+        return;
+    }
+    slot->w = w;
+    slot->h = h;
+    slot->frame = gpu_stats.total_frames;
+    capture_count++;
+    pipe_stats.readback_bytes += (Uint64)size;
+}
+
+static void ReleaseCaptureSlots(void) {
+    for (int i = 0; i < CAPTURE_SLOTS; i++) {
+        if (capture_slots[i].sync) {
+            glDeleteSync(capture_slots[i].sync);
+        }
+        if (capture_slots[i].pbo) {
+            glDeleteBuffers(1, &capture_slots[i].pbo);
+        }
+        capture_slots[i] = (CaptureSlot){0};
+    }
+    capture_first = 0;
+    capture_count = 0;
+}
+
 static void PlatformBackend_Present(void) {
     if (!sdl3_window && !InitPlatform()) {
         return;
     }
+    if (auto_res_max) {
+        set_internal_res = AutoInternalRes(internal_res);
+    }
     ApplyPendingInternalRes();
+    ResolveCaptures();
+    if (Capture_IsActive()) {
+        CaptureFrame();
+    }
 
     const int n = (int)internal_res;
     glBindFramebuffer(GL_READ_FRAMEBUFFER, GetDrawFbo());
@@ -613,6 +726,15 @@ static void PlatformBackend_Present(void) {
     glEnable(GL_SCISSOR_TEST);
 }
 
+static void PlatformBackend_SkipPresent(void) {
+    if (!sdl3_window && !InitPlatform()) {
+        return;
+    }
+    ResolveCaptures();
+    glFlush();
+    finish_time = SDL_GetPerformanceCounter();
+}
+
 static void QuitPlatform(void) {
     Sdl3Common_Shutdown();
     if (overlay_destroy_cb) {
@@ -662,6 +784,7 @@ void ResetPlatform(void) {
         glDeleteFramebuffers(1, &scaled_vram_fbo);
         scaled_vram_fbo = 0;
     }
+    ReleaseCaptureSlots();
     internal_res = 1;
     free(vram_convert_buf);
     vram_convert_buf = NULL;
@@ -674,6 +797,7 @@ static unsigned char* AllocRgb888Region(int x, int y, int w, int h) {
         ERRORF("FBO not initialized");
         return NULL;
     }
+    Psyz_GpuDrawDeferred(x, y, w, h);
 
     unsigned char* pixels = malloc((size_t)w * h * 3);
     if (!pixels) {
@@ -692,11 +816,8 @@ static unsigned char* AllocRgb888Region(int x, int y, int w, int h) {
         return NULL;
     }
     glReadPixels(x, y, w, h, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
-    for (size_t i = 0; i < count; i++) {
-        pixels[i * 3 + 0] = rgba[i * 4 + 0];
-        pixels[i * 3 + 1] = rgba[i * 4 + 1];
-        pixels[i * 3 + 2] = rgba[i * 4 + 2];
-    }
+    pipe_stats.readback_bytes += count * 4;
+    Pixel_Rgba8888ToRgb888(rgba, pixels, count);
 
     GLenum err = glGetError();
     if (err != GL_NO_ERROR) {
@@ -733,6 +854,7 @@ int Psyz_VideoSetInternalResolution(unsigned multiplier) {
         return -1;
     }
     set_internal_res = multiplier;
+    auto_res_max = 0;
     if (sdl3_window && is_platform_init_successful) {
         ApplyPendingInternalRes();
     }
@@ -751,7 +873,7 @@ static void UpdateScissor(void) {
     if (!sdl3_window || !InitPlatform()) {
         return;
     }
-    Draw_FlushBuffer();
+    Draw_FlushBufferFor(PSYZ_FLUSH_STATE);
 
     int sx = draw_area_start.x * internal_res;
     int sy = draw_area_start.y * internal_res;
@@ -809,6 +931,7 @@ void Draw_DisplayEnable(unsigned int on) {
             glBindFramebuffer(GL_FRAMEBUFFER, scaled_vram_fbo);
             glClear(GL_COLOR_BUFFER_BIT);
         }
+        Shadow_Fill(0, 0, VRAM_W, VRAM_H, 0);
         BindDrawFbo();
         glEnable(GL_SCISSOR_TEST);
     } else {
@@ -820,7 +943,7 @@ void Draw_DisplayArea(unsigned int x, unsigned int y) {
     display_area.x = (GLint)x;
     display_area.y = (GLint)y;
 
-    Draw_FlushBuffer();
+    Draw_FlushBufferFor(PSYZ_FLUSH_STATE);
     ApplyDisplayPendingChanges();
     BindDrawFbo();
 }
@@ -904,12 +1027,18 @@ static void Draw_InitBuffer() {
     glBindVertexArray(0);
 }
 
-int Draw_PushPrim(u_long* packets, int max_len) {
+int Draw_PushPrim(u32* packets, int max_len) {
+    CountPrim(*packets);
+    int fast = PushPrimFast(packets, max_len);
+    if (fast) {
+        return fast;
+    }
     int len = max_len;
     int code = (int)(*packets >> 24) & 0xFF;
-    bool isPoly = !(code & 0x40);
-    bool isLine = (code & 0x40) && !(code & 0x20);
-    bool isTile = (code & 0x40) && (code & 0x20);
+    u8 kind = gp0_desc[code].kind;
+    bool isPoly = kind == GP0_KIND_POLY;
+    bool isLine = kind == GP0_KIND_LINE;
+    bool isTile = kind == GP0_KIND_RECT;
     bool isTextured = (code & TEXTURED) != 0;
     bool isGouraud = (code & GOURAUD) != 0;
     bool isShadeTex = !((code & 1) && isTextured && !isLine);
@@ -1181,7 +1310,7 @@ void Draw_SetAreaEnd(int x, int y) {
     UpdateScissor();
 }
 void Draw_SetOffset(int x, int y) {
-    Draw_FlushBuffer();
+    Draw_FlushBufferFor(PSYZ_FLUSH_STATE);
 
     x = x % VRAM_W;
     y = y % VRAM_H;
@@ -1200,6 +1329,9 @@ void Draw_ClearImage(PS1_RECT* rect, u_char r, u_char g, u_char b) {
     if (rect->w == 0 || rect->h == 0) {
         return;
     }
+    Shadow_Fill(rect->x, rect->y, rect->w, rect->h,
+                (u16)(color_8to5(r) | (color_8to5(g) << 5) |
+                      (color_8to5(b) << 10)));
     glClearColor((float)r / 255.0f, (float)g / 255.0f, (float)b / 255.0f, 0.0f);
     glBindFramebuffer(GL_FRAMEBUFFER, vram_fbo);
     glScissor(rect->x, rect->y, rect->w, rect->h);
@@ -1222,7 +1354,9 @@ void Draw_LoadImage(PS1_RECT* rect, u_long* p) {
     if (!buf) {
         return;
     }
-    ConvertRgb5551ToRgba8888((const u16*)p, buf, count);
+    Draw_FlushBufferFor(PSYZ_FLUSH_LOAD_IMAGE);
+    Shadow_Load(rect->x, rect->y, rect->w, rect->h, (const u16*)p);
+    Pixel_Rgb5551ToRgba8888((const u16*)p, buf, count);
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, vram_texture);
     glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
@@ -1230,21 +1364,52 @@ void Draw_LoadImage(PS1_RECT* rect, u_long* p) {
                     GL_RGBA, GL_UNSIGNED_BYTE, buf);
     SyncNativeVramToScaled(rect->x, rect->y, rect->w, rect->h);
 }
+// reads the tiles rendered since their last download into the shadow VRAM
+static void DownloadRenderedTiles(const VramTiles* tiles) {
+    SDL_Rect rects[VRAM_TILE_MAX_RECTS];
+    const int n = TilesToRects(tiles, rects);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, vram_fbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    for (int i = 0; i < n; i++) {
+        const SDL_Rect* r = &rects[i];
+        const size_t count = (size_t)r->w * r->h;
+        u8* buf = GetVramConvertBuffer(count * 6);
+        if (!buf) {
+            break;
+        }
+        u16* pixels = (u16*)(buf + count * 4);
+        pipe_stats.readback_bytes += count * 4;
+        glReadPixels(r->x, r->y, r->w, r->h, GL_RGBA, GL_UNSIGNED_BYTE, buf);
+        Pixel_Rgba8888ToRgb5551(buf, pixels, count);
+        Shadow_Write(r->x, r->y, r->w, r->h, pixels);
+    }
+    BindDrawFbo();
+}
+
 void Draw_StoreImage(PS1_RECT* rect, u_long* p) {
     if (rect->w == 0 || rect->h == 0) {
         return;
     }
+    Draw_FlushBufferFor(PSYZ_FLUSH_STORE_IMAGE);
+    if (InsideVram(rect->x, rect->y, rect->w, rect->h)) {
+        VramTiles stale;
+        if (Shadow_TakeRendered(rect->x, rect->y, rect->w, rect->h, &stale)) {
+            DownloadRenderedTiles(&stale);
+        }
+        Shadow_Store(rect->x, rect->y, rect->w, rect->h, (u16*)p);
+        return;
+    }
     size_t count = (size_t)rect->w * rect->h;
     u8* buf = GetVramConvertBuffer(count * 4);
     if (!buf) {
         return;
     }
-    Draw_FlushBuffer(); // flush primitives before operating with the VRAM
     glBindFramebuffer(GL_READ_FRAMEBUFFER, vram_fbo);
     glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    pipe_stats.readback_bytes += count * 4;
     glReadPixels(
         rect->x, rect->y, rect->w, rect->h, GL_RGBA, GL_UNSIGNED_BYTE, buf);
-    ConvertRgba8888ToRgb5551(buf, (u16*)p, count);
+    Pixel_Rgba8888ToRgb5551(buf, (u16*)p, count);
     BindDrawFbo();
 }
 
@@ -1281,7 +1446,7 @@ void Draw_MoveImage(PS1_RECT* rect, unsigned int x, unsigned int y) {
     if (rect->x == x && rect->y == y) {
         return;
     }
-    Draw_FlushBuffer(); // flush primitives before operating with the VRAM
+    Draw_FlushBufferFor(PSYZ_FLUSH_MOVE_IMAGE);
 
     int src_x = CLAMP(rect->x, 0, VRAM_W - 1);
     int src_y = CLAMP(rect->y, 0, VRAM_H - 1);
@@ -1305,6 +1470,7 @@ void Draw_MoveImage(PS1_RECT* rect, unsigned int x, unsigned int y) {
         WARNF("nothing to copy");
         return;
     }
+    Shadow_Move(src_x, src_y, dst_x, dst_y, copy_w, copy_h);
 
     // same-FBO blit work-around for MESA and macOS
     if (!EnsureScratchFbo()) {
@@ -1348,9 +1514,11 @@ void Draw_ResetBuffer(void) {
 }
 
 void Draw_FlushBuffer(void) {
+    PsyzFlushReason reason = TakeFlushReason();
     if (n_vertices == 0) {
         return;
     }
+    pipe_stats.flushes[reason]++;
     if (VBO == -1) {
         Draw_InitBuffer();
     }
@@ -1390,6 +1558,7 @@ void Draw_FlushBuffer(void) {
             end += prim_size;
         }
         if (need_subtract != cur_subtract) {
+            pipe_stats.blend_switches++;
             glBlendEquation(
                 need_subtract ? GL_FUNC_REVERSE_SUBTRACT : GL_FUNC_ADD);
             cur_subtract = need_subtract;
@@ -1402,6 +1571,12 @@ void Draw_FlushBuffer(void) {
     if (cur_subtract) {
         glBlendEquation(GL_FUNC_ADD);
     }
+    // the scissor keeps the primitives within the draw area
+    VramTiles drawn = {0};
+    MarkTiles(&drawn, draw_area_start.x, draw_area_start.y,
+              draw_area_end.x - draw_area_start.x + 1,
+              draw_area_end.y - draw_area_start.y + 1);
+    Shadow_MarkRendered(&drawn);
     SyncScaledVramToNative();
     Draw_ResetBuffer();
 }
@@ -8,7 +8,12 @@
 #include <string.h>
 #include "../internal.h"
 #include <SDL3/SDL.h>
+// the batches of a frame are streamed, only 16-bit indices cap their size
+#define MAX_VERTEX_COUNT 0x10000
+// the swapchain can be acquired without waiting, see PresentFrame
+#define SDL3_BACKEND_PRESENT_QUEUE
 #include "sdl3_common.h"
+#include "sdl3_shadow.h"
 
 #include "shaders/psx_vert_spv.h"
 #include "shaders/psx_frag_spv.h"
@@ -18,6 +23,16 @@
 #include "shaders/psx_frag_msl.h"
 #include "shaders/clear_vert_msl.h"
 #include "shaders/clear_frag_msl.h"
+// the sprite shader headers only exist once build_shaders.sh compiled them,
+// rectangles are drawn as triangles until then
+#ifdef __has_include
+#if __has_include("shaders/sprite_vert_spv.h") &&                            \
+    __has_include("shaders/sprite_vert_msl.h")
+#include "shaders/sprite_vert_spv.h"
+#include "shaders/sprite_vert_msl.h"
+#define SPRITE_SHADER
+#endif
+#endif
 
 typedef struct {
     int x, y;
@@ -30,20 +45,118 @@ static bool swapchain_ok = false;
 static SDL_GPUTexture* vram_render = NULL;
 static SDL_GPUTexture* vram_sample = NULL;
 static SDL_GPUSampler* vram_sampler = NULL;
-static SDL_GPUTexture* scaled_vram_render = NULL;
+// Upscaled, only the drawing areas the game renders to have a scaled copy,
+// each in a texture of its own allocated by the first batch drawn there.
+// Everything else, texture pages included, only exists at native resolution
+// in vram_render, where the batches are downsampled back to.
+#define MAX_SCALED_REGIONS 8
+typedef struct {
+    SDL_GPUTexture* texture;
+    SDL_Rect rect; // in VRAM pixels, aligned to the tiles
+    Uint64 last_use;
+} ScaledRegion;
+static ScaledRegion scaled_regions[MAX_SCALED_REGIONS];
+static int n_scaled_regions = 0;
+static ScaledRegion* scaled_region = NULL; // the batch renders to this one
+static Uint64 scaled_use_clock = 0;
+
+// Finished frames waiting for the swapchain, oldest first, each copied out
+// of VRAM at VSync; see Psyz_VideoSetPresentQueue.
+typedef struct {
+    SDL_GPUTexture* texture;
+    Uint32 tex_w, tex_h;
+    float aspect;
+} PresentSlot;
+static PresentSlot present_slots[PSYZ_PRESENT_QUEUE_MAX];
+static int present_first = 0;
+static int present_count = 0;
 static unsigned internal_res = 1;
 static unsigned set_internal_res = 1;
-static SDL_GPUBuffer* vbuf = NULL;
-static SDL_GPUBuffer* ibuf = NULL;
-static SDL_GPUBuffer* clear_vbuf = NULL;
-static SDL_GPUTransferBuffer* vtx_transfer = NULL;
 static SDL_GPUTransferBuffer* tex_upload_transfer = NULL;
 static SDL_GPUTransferBuffer* tex_download_transfer = NULL;
 static SDL_GPUGraphicsPipeline* pipe_tri_add = NULL;
 static SDL_GPUGraphicsPipeline* pipe_tri_sub = NULL;
 static SDL_GPUGraphicsPipeline* pipe_clear = NULL;
+// NULL when the device cannot draw instanced sprites, see PushSprite
+static SDL_GPUGraphicsPipeline* pipe_sprite_add = NULL;
+static SDL_GPUGraphicsPipeline* pipe_sprite_sub = NULL;
 static SDL_GPUCommandBuffer* pending_cmd = NULL;
 
+// A SPRT or TILE drawn as a single instance of sprite.vert, which expands it
+// to its four corners: a quarter of the bytes of its vertices and indices
+typedef struct {
+    short x, y;
+    u16 u, v, c, t;
+    u8 r, g, b, a;
+    u32 twin;
+    short w, h;
+} SpriteInstance;
+
+// The batches of a frame are appended to the buffers of its stream slot,
+// written again once the fence of the frame that last used them signalled,
+// so that uploads neither wait for the GPU nor rely on buffer renaming.
+// Slots are sized from the high-water mark of the previous frames.
+#define FRAMES_IN_FLIGHT 3
+#define STREAM_MAX_VERTICES (MAX_VERTEX_COUNT * 4)
+#define STREAM_INDICES(vertices) ((vertices) / 4 * 6)
+#define STREAM_SPRITES(vertices) ((vertices) / 4)
+typedef struct {
+    SDL_GPUBuffer* vbuf;
+    SDL_GPUBuffer* ibuf;
+    SDL_GPUBuffer* sbuf;
+    SDL_GPUTransferBuffer* transfer; // vertices, indices, then sprites
+    SDL_GPUFence* fence;
+} StreamSlot;
+static StreamSlot stream[FRAMES_IN_FLIGHT];
+static int stream_slot = 0;
+static Uint32 stream_capacity = 0; // vertices per slot
+static Uint32 stream_vertices = 0; // appended to the slot by this frame
+static Uint32 stream_indices = 0;
+static Uint32 stream_sprites = 0;
+// streamed by the frame, more than the slot holds when it had to wrap
+static Uint32 stream_frame_vertices = 0;
+static Uint32 stream_frame_indices = 0;
+static Uint32 stream_frame_sprites = 0;
+
+// StoreImage downloads in flight, each in a transfer buffer of the pool kept
+// across frames. They land in the game memory in submission order once
+// their fence signalled, see ResolveReadbacks.
+#define MAX_READBACKS 16
+typedef struct {
+    SDL_GPUTransferBuffer* transfer;
+    Uint32 capacity;
+    SDL_GPUFence* fence;
+    // the rendered tiles of the request, one after the other in the buffer,
+    // or the request itself when it reaches outside of VRAM
+    SDL_Rect rects[VRAM_TILE_MAX_RECTS];
+    int n_rects;
+    SDL_Rect rect;
+    u16* dst;
+    bool direct; // lands in the game memory rather than the shadow
+} Readback;
+static Readback readbacks[MAX_READBACKS];
+static int n_readbacks = 0;
+// tiles the downloads in flight will write to the shadow
+static VramTiles readback_tiles = {0};
+static void ResolveReadbacks(void);
+
+// Presented frames downloaded for the capture. Each download is recorded in
+// the command buffer of its frame and only mapped once the fence of the
+// frame signalled, a frame or two later, so that capturing never waits for
+// the GPU.
+#define CAPTURE_SLOTS 3
+typedef struct {
+    SDL_GPUTransferBuffer* transfer;
+    Uint32 capacity;
+    int stream; // slot of the frame, see StreamNextFrame
+    int w, h;
+    unsigned long long frame;
+} CaptureSlot;
+static CaptureSlot capture_slots[CAPTURE_SLOTS];
+static int capture_first = 0; // the oldest download in flight
+static int capture_count = 0;
+static void SyncShadowRegion(int x, int y, int w, int h);
+
 static Posi display_area = {0, 0};
 static Posi display_size = {256, 240};
 static Posi cur_display_size = {-1, -1};
@@ -78,13 +191,6 @@ static SDL_GPUCommandBuffer* AcquireCmd(void) {
     return pending_cmd;
 }
 
-static void SubmitCmd(void) {
-    if (pending_cmd) {
-        SDL_SubmitGPUCommandBuffer(pending_cmd);
-        pending_cmd = NULL;
-    }
-}
-
 static void SubmitCmdAndWait(void) {
     if (!pending_cmd) {
         return;
@@ -98,6 +204,108 @@ static void SubmitCmdAndWait(void) {
     }
 }
 
+static void ReleaseStreamBuffers(void) {
+    for (int i = 0; i < FRAMES_IN_FLIGHT; i++) {
+        StreamSlot* slot = &stream[i];
+        if (slot->vbuf) {
+            SDL_ReleaseGPUBuffer(device, slot->vbuf);
+            slot->vbuf = NULL;
+        }
+        if (slot->ibuf) {
+            SDL_ReleaseGPUBuffer(device, slot->ibuf);
+            slot->ibuf = NULL;
+        }
+        if (slot->sbuf) {
+            SDL_ReleaseGPUBuffer(device, slot->sbuf);
+            slot->sbuf = NULL;
+        }
+        if (slot->transfer) {
+            SDL_ReleaseGPUTransferBuffer(device, slot->transfer);
+            slot->transfer = NULL;
+        }
+    }
+}
+
+static bool CreateStream(Uint32 capacity) {
+    const SDL_GPUBufferCreateInfo vbuf_info = {
+        .usage = SDL_GPU_BUFFERUSAGE_VERTEX,
+        .size = capacity * sizeof(Vertex),
+    };
+    const SDL_GPUBufferCreateInfo ibuf_info = {
+        .usage = SDL_GPU_BUFFERUSAGE_INDEX,
+        .size = STREAM_INDICES(capacity) * sizeof(u16),
+    };
+    const SDL_GPUBufferCreateInfo sbuf_info = {
+        .usage = SDL_GPU_BUFFERUSAGE_VERTEX,
+        .size = STREAM_SPRITES(capacity) * sizeof(SpriteInstance),
+    };
+    const SDL_GPUTransferBufferCreateInfo transfer_info = {
+        .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
+        .size = vbuf_info.size + ibuf_info.size + sbuf_info.size,
+    };
+    for (int i = 0; i < FRAMES_IN_FLIGHT; i++) {
+        StreamSlot* slot = &stream[i];
+        slot->vbuf = SDL_CreateGPUBuffer(device, &vbuf_info);
+        slot->ibuf = SDL_CreateGPUBuffer(device, &ibuf_info);
+        slot->sbuf = SDL_CreateGPUBuffer(device, &sbuf_info);
+        slot->transfer = SDL_CreateGPUTransferBuffer(device, &transfer_info);
+        if (!slot->vbuf || !slot->ibuf || !slot->sbuf || !slot->transfer) {
+            ERRORF("cannot stream %u vertices: %s", capacity, SDL_GetError());
+            ReleaseStreamBuffers();
+            return false;
+        }
+    }
+    stream_capacity = capacity;
+    return true;
+}
+
+// Hands the fence of the frame to its slot and moves to the next one, grown
+// when the frame did not fit. Buffers of the slots still in flight are only
+// released by SDL once the GPU is done with them.
+static void StreamNextFrame(SDL_GPUFence* fence) {
+    stream[stream_slot].fence = fence;
+    stream_slot = (stream_slot + 1) % FRAMES_IN_FLIGHT;
+    StreamSlot* slot = &stream[stream_slot];
+    if (slot->fence) {
+        SDL_WaitForGPUFences(device, true, &slot->fence, 1);
+        SDL_ReleaseGPUFence(device, slot->fence);
+        slot->fence = NULL;
+    }
+
+    const Uint32 need = SDL_max(
+        SDL_max(stream_frame_vertices, (stream_frame_indices * 4 + 5) / 6),
+        stream_frame_sprites * 4);
+    if (need > stream_capacity && stream_capacity < STREAM_MAX_VERTICES) {
+        const Uint32 prev_capacity = stream_capacity;
+        Uint32 capacity = stream_capacity;
+        while (capacity < need && capacity < STREAM_MAX_VERTICES) {
+            capacity *= 2;
+        }
+        ReleaseStreamBuffers();
+        if (CreateStream(capacity)) {
+            INFOF("vertex stream grown to %u vertices per frame", capacity);
+        } else {
+            CreateStream(prev_capacity);
+        }
+    }
+    stream_vertices = 0;
+    stream_indices = 0;
+    stream_sprites = 0;
+    stream_frame_vertices = 0;
+    stream_frame_indices = 0;
+    stream_frame_sprites = 0;
+}
+
+// the fence tells when the stream slot of the frame can be written again
+static void SubmitFrame(void) {
+    SDL_GPUFence* fence = NULL;
+    if (pending_cmd) {
+        fence = SDL_SubmitGPUCommandBufferAndAcquireFence(pending_cmd);
+        pending_cmd = NULL;
+    }
+    StreamNextFrame(fence);
+}
+
 static SDL_GPUShader* CreateShader(
     const unsigned char* spirv, unsigned int spirv_len,
     const unsigned char* msl, unsigned int msl_len, SDL_GPUShaderStage stage,
@@ -129,12 +337,37 @@ static SDL_GPUShader* CreateShader(
     return shader;
 }
 
+// sprites feed the same attributes from their instance, plus their size
+static const SDL_GPUVertexAttribute sprite_attribs[] = {
+    {.location = 0,
+     .buffer_slot = 0,
+     .format = SDL_GPU_VERTEXELEMENTFORMAT_SHORT2,
+     .offset = offsetof(SpriteInstance, x)},
+    {.location = 1,
+     .buffer_slot = 0,
+     .format = SDL_GPU_VERTEXELEMENTFORMAT_USHORT4,
+     .offset = offsetof(SpriteInstance, u)},
+    {.location = 2,
+     .buffer_slot = 0,
+     .format = SDL_GPU_VERTEXELEMENTFORMAT_UBYTE4_NORM,
+     .offset = offsetof(SpriteInstance, r)},
+    {.location = 3,
+     .buffer_slot = 0,
+     .format = SDL_GPU_VERTEXELEMENTFORMAT_UBYTE4,
+     .offset = offsetof(SpriteInstance, twin)},
+    {.location = 4,
+     .buffer_slot = 0,
+     .format = SDL_GPU_VERTEXELEMENTFORMAT_SHORT2,
+     .offset = offsetof(SpriteInstance, w)},
+};
+
 static SDL_GPUGraphicsPipeline* CreatePsxPipeline(
-    SDL_GPUShader* vs, SDL_GPUShader* fs, bool subtract) {
+    SDL_GPUShader* vs, SDL_GPUShader* fs, bool subtract, bool sprites) {
     const SDL_GPUVertexBufferDescription vb_desc = {
         .slot = 0,
-        .pitch = sizeof(Vertex),
-        .input_rate = SDL_GPU_VERTEXINPUTRATE_VERTEX,
+        .pitch = sprites ? sizeof(SpriteInstance) : sizeof(Vertex),
+        .input_rate = sprites ? SDL_GPU_VERTEXINPUTRATE_INSTANCE
+                              : SDL_GPU_VERTEXINPUTRATE_VERTEX,
     };
     const SDL_GPUVertexAttribute attribs[] = {
         {.location = 0,
@@ -178,10 +411,12 @@ static SDL_GPUGraphicsPipeline* CreatePsxPipeline(
             {
                 .vertex_buffer_descriptions = &vb_desc,
                 .num_vertex_buffers = 1,
-                .vertex_attributes = attribs,
-                .num_vertex_attributes = LENU(attribs),
+                .vertex_attributes = sprites ? sprite_attribs : attribs,
+                .num_vertex_attributes =
+                    sprites ? LENU(sprite_attribs) : LENU(attribs),
             },
-        .primitive_type = SDL_GPU_PRIMITIVETYPE_TRIANGLELIST,
+        .primitive_type = sprites ? SDL_GPU_PRIMITIVETYPE_TRIANGLESTRIP
+                                  : SDL_GPU_PRIMITIVETYPE_TRIANGLELIST,
         .target_info =
             {
                 .color_target_descriptions = &target,
@@ -256,6 +491,7 @@ static bool CreateGpuResources(void) {
         .num_levels = 1,
     };
     vram_render = SDL_CreateGPUTexture(device, &render_info);
+    Shadow_Reset();
     SDL_GPUTextureCreateInfo sample_info = render_info;
     sample_info.usage = SDL_GPU_TEXTUREUSAGE_SAMPLER;
     vram_sample = SDL_CreateGPUTexture(device, &sample_info);
@@ -278,32 +514,10 @@ static bool CreateGpuResources(void) {
         return false;
     }
 
-    const SDL_GPUBufferCreateInfo vbuf_info = {
-        .usage = SDL_GPU_BUFFERUSAGE_VERTEX,
-        .size = MAX_VERTEX_COUNT * sizeof(Vertex),
-    };
-    vbuf = SDL_CreateGPUBuffer(device, &vbuf_info);
-    const SDL_GPUBufferCreateInfo ibuf_info = {
-        .usage = SDL_GPU_BUFFERUSAGE_INDEX,
-        .size = MAX_INDEX_COUNT * sizeof(u16),
-    };
-    ibuf = SDL_CreateGPUBuffer(device, &ibuf_info);
-    const SDL_GPUBufferCreateInfo clear_vbuf_info = {
-        .usage = SDL_GPU_BUFFERUSAGE_VERTEX,
-        .size = 4 * sizeof(Vertex),
-    };
-    clear_vbuf = SDL_CreateGPUBuffer(device, &clear_vbuf_info);
-    if (!vbuf || !ibuf || !clear_vbuf) {
-        ERRORF("SDL_CreateGPUBuffer: %s", SDL_GetError());
+    if (!CreateStream(MAX_VERTEX_COUNT)) {
         return false;
     }
 
-    const SDL_GPUTransferBufferCreateInfo vtx_transfer_info = {
-        .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
-        .size =
-            MAX_VERTEX_COUNT * sizeof(Vertex) + MAX_INDEX_COUNT * sizeof(u16),
-    };
-    vtx_transfer = SDL_CreateGPUTransferBuffer(device, &vtx_transfer_info);
     const SDL_GPUTransferBufferCreateInfo upload_info = {
         .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
         .size = VRAM_BYTES,
@@ -314,7 +528,7 @@ static bool CreateGpuResources(void) {
         .size = VRAM_BYTES,
     };
     tex_download_transfer = SDL_CreateGPUTransferBuffer(device, &download_info);
-    if (!vtx_transfer || !tex_upload_transfer || !tex_download_transfer) {
+    if (!tex_upload_transfer || !tex_download_transfer) {
         ERRORF("SDL_CreateGPUTransferBuffer: %s", SDL_GetError());
         return false;
     }
@@ -331,12 +545,34 @@ static bool CreateGpuResources(void) {
     SDL_GPUShader* clear_fs =
         CreateShader(clear_frag_spv, clear_frag_spv_len, clear_frag_msl,
                      clear_frag_msl_len, SDL_GPU_SHADERSTAGE_FRAGMENT, 0, 0);
+#ifdef SPRITE_SHADER
+    SDL_GPUShader* sprite_vs =
+        CreateShader(sprite_vert_spv, sprite_vert_spv_len, sprite_vert_msl,
+                     sprite_vert_msl_len, SDL_GPU_SHADERSTAGE_VERTEX, 0, 1);
+#else
+    SDL_GPUShader* sprite_vs = NULL;
+#endif
     bool shaders_ok = psx_vs && psx_fs && clear_vs && clear_fs;
     if (shaders_ok) {
-        pipe_tri_add = CreatePsxPipeline(psx_vs, psx_fs, false);
-        pipe_tri_sub = CreatePsxPipeline(psx_vs, psx_fs, true);
+        pipe_tri_add = CreatePsxPipeline(psx_vs, psx_fs, false, false);
+        pipe_tri_sub = CreatePsxPipeline(psx_vs, psx_fs, true, false);
         pipe_clear = CreateClearPipeline(clear_vs, clear_fs);
     }
+    if (shaders_ok && sprite_vs) {
+        pipe_sprite_add = CreatePsxPipeline(sprite_vs, psx_fs, false, true);
+        pipe_sprite_sub = CreatePsxPipeline(sprite_vs, psx_fs, true, true);
+    }
+    if (!pipe_sprite_add || !pipe_sprite_sub) {
+        INFOF("instanced sprites not supported, drawing them as triangles");
+        if (pipe_sprite_add) {
+            SDL_ReleaseGPUGraphicsPipeline(device, pipe_sprite_add);
+            pipe_sprite_add = NULL;
+        }
+        if (pipe_sprite_sub) {
+            SDL_ReleaseGPUGraphicsPipeline(device, pipe_sprite_sub);
+            pipe_sprite_sub = NULL;
+        }
+    }
     if (psx_vs) {
         SDL_ReleaseGPUShader(device, psx_vs);
     }
@@ -349,6 +585,9 @@ static bool CreateGpuResources(void) {
     if (clear_fs) {
         SDL_ReleaseGPUShader(device, clear_fs);
     }
+    if (sprite_vs) {
+        SDL_ReleaseGPUShader(device, sprite_vs);
+    }
     return shaders_ok && pipe_tri_add && pipe_tri_sub && pipe_clear;
 }
 
@@ -427,115 +666,314 @@ static void PlatformBackend_SetDriverVsync(bool enable) {
 static void UpdateScissor(void);
 
 static SDL_GPUTexture* GetRenderTarget(void) {
-    return internal_res <= 1 ? vram_render : scaled_vram_render;
+    return internal_res <= 1 ? vram_render : scaled_region->texture;
 }
 
-static SDL_Rect vram_dirty = {0, 0, 0, 0};
-static void MarkVramDirty(SDL_Rect r) {
-    if (r.w <= 0 || r.h <= 0) {
-        return;
+// texels and CLUT entries a primitive may fetch, at texture page granularity
+static void MarkSampledTiles(VramTiles* tiles, u16 tpage, u16 clut) {
+    const int page_x = (tpage & 0xF) * 64;
+    const int page_y = ((tpage >> 4) & 1) * 256;
+    const int depth = (tpage >> 7) & 3;
+    const int page_w = depth == 0 ? 64 : depth == 1 ? 128 : 256;
+    MarkTiles(tiles, page_x, page_y, page_w, 256);
+    if (page_x + page_w > VRAM_W) {
+        MarkTiles(tiles, 0, page_y, page_x + page_w - VRAM_W, 256);
     }
-    int x0 = CLAMP(r.x, 0, VRAM_W);
-    int y0 = CLAMP(r.y, 0, VRAM_H);
-    int x1 = CLAMP(r.x + r.w, 0, VRAM_W);
-    int y1 = CLAMP(r.y + r.h, 0, VRAM_H);
-    if (x1 <= x0 || y1 <= y0) {
-        return;
+    if (depth < 2) {
+        MarkTiles(tiles, (clut & 0x3F) * 16, (clut >> 6) & 0x1FF,
+                  depth == 0 ? 16 : 256, 1);
     }
-    if (vram_dirty.w <= 0 || vram_dirty.h <= 0) {
-        vram_dirty = (SDL_Rect){x0, y0, x1 - x0, y1 - y0};
-        return;
+}
+
+// tiles of vram_render not yet mirrored into vram_sample
+static VramTiles vram_dirty = {0};
+static void MarkVramDirty(SDL_Rect r) {
+    MarkTiles(&vram_dirty, r.x, r.y, r.w, r.h);
+}
+
+// VRAM transfers and runs of sprites are recorded along with the triangles
+// of the batch and replayed in submission order when it is flushed, so that
+// consecutive uploads and moves share a copy pass while fills and sprites
+// are drawn in the render pass of the triangles
+typedef enum {
+    CMD_CLEAR,
+    CMD_LOAD,
+    CMD_MOVE,
+    CMD_SPRITES,
+} BatchCmdKind;
+typedef struct {
+    BatchCmdKind kind;
+    int at; // indices recorded before the command, drawn ahead of it
+    SDL_Rect rect;
+    int src_x; // MoveImage source
+    int src_y;
+    Uint32 offset; // LoadImage pixels in tex_upload_transfer
+    int vertex;    // first of the four ClearImage vertices
+    int first;     // sprites of the run
+    int count;
+} BatchCmd;
+#define MAX_BATCH_CMDS 1024
+// D3D12 wants texture uploads to start on a 512 bytes boundary
+#define XFER_UPLOAD_ALIGNED(n) (((n) + 511) & ~(Uint32)511)
+static BatchCmd batch_cmds[MAX_BATCH_CMDS];
+static int n_batch_cmds = 0;
+static Uint32 xfer_upload_size = 0;
+// the transfer that first queued behind primitives of the batch, whose
+// submission the transfer caused even when it is recorded in the same batch
+static PsyzFlushReason xfer_reason = PSYZ_FLUSH_EXEQUE;
+
+// anything reading VRAM outside of a flush must see the recorded transfers
+static void FlushPendingTransfers(void) {
+    if (n_batch_cmds) {
+        Draw_FlushBuffer();
+    }
+}
+
+static BatchCmd* QueueCmd(BatchCmdKind kind, PsyzFlushReason reason) {
+    if (n_batch_cmds == MAX_BATCH_CMDS) {
+        Draw_FlushBufferFor(reason);
     }
-    int ux0 = x0 < vram_dirty.x ? x0 : vram_dirty.x;
-    int uy0 = y0 < vram_dirty.y ? y0 : vram_dirty.y;
-    int ux1 =
-        x1 > vram_dirty.x + vram_dirty.w ? x1 : vram_dirty.x + vram_dirty.w;
-    int uy1 =
-        y1 > vram_dirty.y + vram_dirty.h ? y1 : vram_dirty.y + vram_dirty.h;
-    vram_dirty = (SDL_Rect){ux0, uy0, ux1 - ux0, uy1 - uy0};
+    BatchCmd* entry = &batch_cmds[n_batch_cmds++];
+    entry->kind = kind;
+    entry->at = n_indices;
+    return entry;
+}
+
+static bool IntersectRects(
+    const SDL_Rect* a, const SDL_Rect* b, SDL_Rect* out) {
+    const int x0 = SDL_max(a->x, b->x);
+    const int y0 = SDL_max(a->y, b->y);
+    const int x1 = SDL_min(a->x + a->w, b->x + b->w);
+    const int y1 = SDL_min(a->y + a->h, b->y + b->h);
+    *out = (SDL_Rect){x0, y0, x1 - x0, y1 - y0};
+    return x1 > x0 && y1 > y0;
 }
-static void ResetVramDirty(void) { vram_dirty = (SDL_Rect){0, 0, 0, 0}; }
 
-// mirror a native VRAM region into the scaled render target
+static bool RectContains(const SDL_Rect* outer, const SDL_Rect* inner) {
+    return inner->x >= outer->x && inner->y >= outer->y &&
+           inner->x + inner->w <= outer->x + outer->w &&
+           inner->y + inner->h <= outer->y + outer->h;
+}
+
+// mirror a native VRAM region into the scaled regions it overlaps
 static void SyncNativeVramToScaled(int x, int y, int w, int h) {
-    if (internal_res <= 1 || !scaled_vram_render || w <= 0 || h <= 0) {
+    if (internal_res <= 1 || !n_scaled_regions || w <= 0 || h <= 0) {
         return;
     }
     SDL_GPUCommandBuffer* cmd = AcquireCmd();
     if (!cmd) {
         return;
     }
-    const SDL_GPUBlitInfo blit = {
-        .source = {.texture = vram_render,
-                   .x = (Uint32)x,
-                   .y = (Uint32)y,
-                   .w = (Uint32)w,
-                   .h = (Uint32)h},
-        .destination = {.texture = scaled_vram_render,
-                        .x = (Uint32)(x * internal_res),
-                        .y = (Uint32)(y * internal_res),
-                        .w = (Uint32)(w * internal_res),
-                        .h = (Uint32)(h * internal_res)},
-        .load_op = SDL_GPU_LOADOP_LOAD,
-        .filter = SDL_GPU_FILTER_NEAREST,
-    };
-    SDL_BlitGPUTexture(cmd, &blit);
+    const SDL_Rect native = {x, y, w, h};
+    for (int i = 0; i < n_scaled_regions; i++) {
+        const ScaledRegion* region = &scaled_regions[i];
+        SDL_Rect r;
+        if (!IntersectRects(&native, &region->rect, &r)) {
+            continue;
+        }
+        const int dst_x = r.x - region->rect.x;
+        const int dst_y = r.y - region->rect.y;
+        const SDL_GPUBlitInfo blit = {
+            .source = {.texture = vram_render,
+                       .x = (Uint32)r.x,
+                       .y = (Uint32)r.y,
+                       .w = (Uint32)r.w,
+                       .h = (Uint32)r.h},
+            .destination = {.texture = region->texture,
+                            .x = (Uint32)(dst_x * internal_res),
+                            .y = (Uint32)(dst_y * internal_res),
+                            .w = (Uint32)(r.w * internal_res),
+                            .h = (Uint32)(r.h * internal_res)},
+            .load_op = SDL_GPU_LOADOP_LOAD,
+            .filter = SDL_GPU_FILTER_NEAREST,
+        };
+        SDL_BlitGPUTexture(cmd, &blit);
+    }
 }
 
-static void SyncScaledVramToNative(void) {
-    if (internal_res <= 1 || !scaled_vram_render) {
+// downsample the tiles a batch drew to, within the draw area
+static void SyncScaledVramToNative(const VramTiles* written) {
+    if (internal_res <= 1 || !scaled_region) {
         return;
     }
-    int x0 = CLAMP(draw_area_start.x, 0, VRAM_W);
-    int y0 = CLAMP(draw_area_start.y, 0, VRAM_H);
-    int x1 = CLAMP(draw_area_end.x + 1, 0, VRAM_W);
-    int y1 = CLAMP(draw_area_end.y + 1, 0, VRAM_H);
-    if (x1 <= x0 || y1 <= y0) {
+    const SDL_Rect* region = &scaled_region->rect;
+    const int area_x0 = CLAMP(draw_area_start.x, region->x, VRAM_W);
+    const int area_y0 = CLAMP(draw_area_start.y, region->y, VRAM_H);
+    const int area_x1 =
+        CLAMP(draw_area_end.x + 1, 0, region->x + region->w);
+    const int area_y1 =
+        CLAMP(draw_area_end.y + 1, 0, region->y + region->h);
+    if (area_x1 <= area_x0 || area_y1 <= area_y0) {
         return;
     }
     SDL_GPUCommandBuffer* cmd = AcquireCmd();
     if (!cmd) {
         return;
     }
-    const SDL_GPUBlitInfo blit = {
-        .source = {.texture = scaled_vram_render,
-                   .x = (Uint32)(x0 * internal_res),
-                   .y = (Uint32)(y0 * internal_res),
-                   .w = (Uint32)((x1 - x0) * internal_res),
-                   .h = (Uint32)((y1 - y0) * internal_res)},
-        .destination = {.texture = vram_render,
-                        .x = (Uint32)x0,
-                        .y = (Uint32)y0,
-                        .w = (Uint32)(x1 - x0),
-                        .h = (Uint32)(y1 - y0)},
-        .load_op = SDL_GPU_LOADOP_LOAD,
-        .filter = SDL_GPU_FILTER_NEAREST,
-    };
-    SDL_BlitGPUTexture(cmd, &blit);
-    MarkVramDirty((SDL_Rect){x0, y0, x1 - x0, y1 - y0});
+    SDL_Rect rects[VRAM_TILE_MAX_RECTS];
+    const int n = TilesToRects(written, rects);
+    for (int i = 0; i < n; i++) {
+        const int x0 = SDL_max(rects[i].x, area_x0);
+        const int y0 = SDL_max(rects[i].y, area_y0);
+        const int x1 = SDL_min(rects[i].x + rects[i].w, area_x1);
+        const int y1 = SDL_min(rects[i].y + rects[i].h, area_y1);
+        if (x1 <= x0 || y1 <= y0) {
+            continue;
+        }
+        const SDL_GPUBlitInfo blit = {
+            .source = {.texture = scaled_region->texture,
+                       .x = (Uint32)((x0 - region->x) * internal_res),
+                       .y = (Uint32)((y0 - region->y) * internal_res),
+                       .w = (Uint32)((x1 - x0) * internal_res),
+                       .h = (Uint32)((y1 - y0) * internal_res)},
+            .destination = {.texture = vram_render,
+                            .x = (Uint32)x0,
+                            .y = (Uint32)y0,
+                            .w = (Uint32)(x1 - x0),
+                            .h = (Uint32)(y1 - y0)},
+            .load_op = SDL_GPU_LOADOP_LOAD,
+            .filter = SDL_GPU_FILTER_NEAREST,
+        };
+        SDL_BlitGPUTexture(cmd, &blit);
+        pipe_stats.vram_copy_bytes += (Uint64)(x1 - x0) * (y1 - y0) * 4;
+        MarkVramDirty((SDL_Rect){x0, y0, x1 - x0, y1 - y0});
+    }
+}
+
+static void ReleaseScaledRegion(int i) {
+    SDL_ReleaseGPUTexture(device, scaled_regions[i].texture);
+    scaled_regions[i] = scaled_regions[--n_scaled_regions];
+    scaled_region = NULL;
+}
+
+static void ReleaseScaledRegions(void) {
+    while (n_scaled_regions) {
+        ReleaseScaledRegion(n_scaled_regions - 1);
+    }
 }
 
-static bool CreateScaledVramTarget(unsigned n) {
-    if (scaled_vram_render) {
-        SDL_ReleaseGPUTexture(device, scaled_vram_render);
-        scaled_vram_render = NULL;
+static ScaledRegion* FindScaledRegion(const SDL_Rect* rect) {
+    for (int i = 0; i < n_scaled_regions; i++) {
+        if (RectContains(&scaled_regions[i].rect, rect)) {
+            return &scaled_regions[i];
+        }
     }
+    return NULL;
+}
+
+// The new region swallows the ones it overlaps, moving their scaled pixels
+// over, so that a pixel of VRAM is never upscaled twice. The rest of it
+// starts as an upscale of native VRAM.
+static ScaledRegion* CreateScaledRegion(SDL_Rect rect) {
+    for (bool grown = true; grown;) {
+        grown = false;
+        for (int i = 0; i < n_scaled_regions; i++) {
+            const SDL_Rect* other = &scaled_regions[i].rect;
+            SDL_Rect common;
+            if (!IntersectRects(&rect, other, &common) ||
+                RectContains(&rect, other)) {
+                continue;
+            }
+            const int x0 = SDL_min(rect.x, other->x);
+            const int y0 = SDL_min(rect.y, other->y);
+            const int x1 = SDL_max(rect.x + rect.w, other->x + other->w);
+            const int y1 = SDL_max(rect.y + rect.h, other->y + other->h);
+            rect = (SDL_Rect){x0, y0, x1 - x0, y1 - y0};
+            grown = true;
+        }
+    }
+    SDL_GPUCommandBuffer* cmd = AcquireCmd();
+    if (!cmd) {
+        return NULL;
+    }
+    const unsigned n = internal_res;
     const SDL_GPUTextureCreateInfo info = {
         .type = SDL_GPU_TEXTURETYPE_2D,
         .format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM,
         .usage =
             SDL_GPU_TEXTUREUSAGE_COLOR_TARGET | SDL_GPU_TEXTUREUSAGE_SAMPLER,
-        .width = VRAM_W * n,
-        .height = VRAM_H * n,
+        .width = (Uint32)rect.w * n,
+        .height = (Uint32)rect.h * n,
         .layer_count_or_depth = 1,
         .num_levels = 1,
     };
-    scaled_vram_render = SDL_CreateGPUTexture(device, &info);
-    if (!scaled_vram_render) {
-        ERRORF(
-            "scaled VRAM texture creation failed (%dx): %s", n, SDL_GetError());
+    SDL_GPUTexture* texture = SDL_CreateGPUTexture(device, &info);
+    if (!texture) {
+        ERRORF("scaled VRAM texture creation failed (%dx%d at %dx): %s",
+               rect.w, rect.h, n, SDL_GetError());
+        return NULL;
+    }
+    const SDL_GPUBlitInfo blit = {
+        .source = {.texture = vram_render,
+                   .x = (Uint32)rect.x,
+                   .y = (Uint32)rect.y,
+                   .w = (Uint32)rect.w,
+                   .h = (Uint32)rect.h},
+        .destination = {.texture = texture,
+                        .w = (Uint32)rect.w * n,
+                        .h = (Uint32)rect.h * n},
+        .load_op = SDL_GPU_LOADOP_DONT_CARE,
+        .filter = SDL_GPU_FILTER_NEAREST,
+    };
+    SDL_BlitGPUTexture(cmd, &blit);
+    SDL_GPUCopyPass* copy = NULL;
+    for (int i = n_scaled_regions - 1; i >= 0; i--) {
+        const ScaledRegion* other = &scaled_regions[i];
+        if (!RectContains(&rect, &other->rect)) {
+            continue;
+        }
+        if (!copy) {
+            copy = SDL_BeginGPUCopyPass(cmd);
+        }
+        const SDL_GPUTextureLocation src = {.texture = other->texture};
+        const SDL_GPUTextureLocation dst = {
+            .texture = texture,
+            .x = (Uint32)(other->rect.x - rect.x) * n,
+            .y = (Uint32)(other->rect.y - rect.y) * n};
+        SDL_CopyGPUTextureToTexture(copy, &src, &dst,
+                                    (Uint32)other->rect.w * n,
+                                    (Uint32)other->rect.h * n, 1, false);
+        ReleaseScaledRegion(i);
+    }
+    if (copy) {
+        SDL_EndGPUCopyPass(copy);
+    }
+    // the least recently drawn region goes, its pixels are in native VRAM
+    if (n_scaled_regions == MAX_SCALED_REGIONS) {
+        int lru = 0;
+        for (int i = 1; i < n_scaled_regions; i++) {
+            if (scaled_regions[i].last_use < scaled_regions[lru].last_use) {
+                lru = i;
+            }
+        }
+        ReleaseScaledRegion(lru);
+    }
+    ScaledRegion* region = &scaled_regions[n_scaled_regions++];
+    *region = (ScaledRegion){.texture = texture, .rect = rect};
+    INFOF("scaled VRAM region %d,%d %dx%d allocated (%dx%d)", rect.x, rect.y,
+          rect.w, rect.h, rect.w * n, rect.h * n);
+    return region;
+}
+
+// picks the region the next batch renders to, covering the drawing area
+static bool SelectScaledRegion(void) {
+    const int tile = VRAM_TILE_SIZE;
+    int x0 = CLAMP(scissor_rect.x, 0, VRAM_W - tile) & ~(tile - 1);
+    int y0 = CLAMP(scissor_rect.y, 0, VRAM_H - tile) & ~(tile - 1);
+    int x1 = CLAMP(scissor_rect.x + scissor_rect.w, x0 + 1, VRAM_W);
+    int y1 = CLAMP(scissor_rect.y + scissor_rect.h, y0 + 1, VRAM_H);
+    x1 = (x1 + tile - 1) & ~(tile - 1);
+    y1 = (y1 + tile - 1) & ~(tile - 1);
+    const SDL_Rect rect = {x0, y0, x1 - x0, y1 - y0};
+    ScaledRegion* region = FindScaledRegion(&rect);
+    if (!region) {
+        region = CreateScaledRegion(rect);
+    }
+    if (!region) {
         return false;
     }
+    region->last_use = ++scaled_use_clock;
+    scaled_region = region;
     return true;
 }
 
@@ -562,36 +1000,273 @@ static void ApplyPendingInternalRes(void) {
     if (!sdl3_window || !is_platform_init_successful) {
         return;
     }
-    unsigned n = AdjustInternalRes(set_internal_res);
+    const unsigned n = AdjustInternalRes(set_internal_res);
     if (n == internal_res) {
         return;
     }
-    Draw_FlushBuffer(); // render pending prims with the old multiplier
-    if (n > 1 && !CreateScaledVramTarget(n)) {
-        n = 1;
-        set_internal_res = 1;
-    }
-    if (n > 1) {
-        // upscale the whole native VRAM into the freshly created scaled target
-        SDL_GPUCommandBuffer* cmd = AcquireCmd();
-        if (cmd) {
-            const SDL_GPUBlitInfo blit = {
-                .source = {.texture = vram_render, .w = VRAM_W, .h = VRAM_H},
-                .destination = {.texture = scaled_vram_render,
-                                .w = VRAM_W * n,
-                                .h = VRAM_H * n},
-                .load_op = SDL_GPU_LOADOP_DONT_CARE,
-                .filter = SDL_GPU_FILTER_NEAREST,
-            };
-            SDL_BlitGPUTexture(cmd, &blit);
-        }
-    } else if (scaled_vram_render) {
-        SDL_ReleaseGPUTexture(device, scaled_vram_render);
-        scaled_vram_render = NULL;
-    }
+    Draw_FlushBufferFor(PSYZ_FLUSH_STATE); // render prims at the old res
+    // drawn to again, the regions come back at the new scale
+    ReleaseScaledRegions();
     internal_res = n;
     UpdateScissor();
-    INFOF("internal resolution set to %dx (%dx%d)", n, VRAM_W * n, VRAM_H * n);
+    INFOF("internal resolution set to %dx", n);
+}
+
+// the part of VRAM on display, in the texture holding it, and its aspect
+static float GetShownRegion(SDL_GPUBlitRegion* src) {
+    if (debug_show_vram) {
+        *src = (SDL_GPUBlitRegion){
+            .texture = vram_render, .w = VRAM_W, .h = VRAM_H};
+        return (float)VRAM_W / (float)VRAM_H;
+    }
+    // a display area never drawn to upscaled is shown native
+    const SDL_Rect shown = {
+        display_area.x, display_area.y, display_size.x, display_size.y};
+    const ScaledRegion* region = NULL;
+    if (internal_res > 1) {
+        region = FindScaledRegion(&shown);
+    }
+    const Uint32 n = region ? internal_res : 1;
+    const SDL_Rect origin = region ? region->rect : (SDL_Rect){0};
+    *src = (SDL_GPUBlitRegion){
+        .texture = region ? region->texture : vram_render,
+        .x = (Uint32)(shown.x - origin.x) * n,
+        .y = (Uint32)(shown.y - origin.y) * n,
+        .w = (Uint32)shown.w * n,
+        .h = (Uint32)shown.h * n,
+    };
+    return GetCurrentGameAspectRatio(display_size.x, display_size.y);
+}
+
+static void BlitToSwapchain(
+    SDL_GPUCommandBuffer* cmd, SDL_GPUTexture* swapchain, Uint32 sc_w,
+    Uint32 sc_h, const SDL_GPUBlitRegion* src, float game_aspect) {
+    WndSize win = {(int)sc_w, (int)sc_h};
+    SDL_Rect dst = FitGameToWindow(game_aspect, win);
+
+    const SDL_GPUBlitInfo blit = {
+        .source = *src,
+        .destination =
+            {
+                .texture = swapchain,
+                .x = (Uint32)dst.x,
+                .y = (Uint32)dst.y,
+                .w = (Uint32)dst.w,
+                .h = (Uint32)dst.h,
+            },
+        // clear the swapchain to black first so the horizontal or
+        // vertical bars around the game output are black
+        .load_op = SDL_GPU_LOADOP_CLEAR,
+        .clear_color = {0.0f, 0.0f, 0.0f, 1.0f},
+        .filter = SDL_GPU_FILTER_NEAREST,
+    };
+    SDL_BlitGPUTexture(cmd, &blit);
+    if (overlay_frame_cb) {
+        overlay_frame_cb();
+    }
+    if (overlay_render_cb) {
+        SDL_GPUColorTargetInfo target = {
+            .texture = swapchain,
+            .load_op = SDL_GPU_LOADOP_LOAD,
+            .store_op = SDL_GPU_STOREOP_STORE,
+        };
+        SDL_GPURenderPass* pass = SDL_BeginGPURenderPass(cmd, &target, 1, NULL);
+        overlay_render_cb(cmd, pass);
+        SDL_EndGPURenderPass(pass);
+    }
+}
+
+static void DropQueuedFrame(void) {
+    present_first = (present_first + 1) % PSYZ_PRESENT_QUEUE_MAX;
+    present_count--;
+}
+
+// copies the frame aside, the game may draw over its VRAM from now on
+static void QueueFrame(
+    SDL_GPUCommandBuffer* cmd, const SDL_GPUBlitRegion* src, float aspect) {
+    const int i = (present_first + present_count) % PSYZ_PRESENT_QUEUE_MAX;
+    PresentSlot* slot = &present_slots[i];
+    if (slot->tex_w != src->w || slot->tex_h != src->h) {
+        if (slot->texture) {
+            SDL_ReleaseGPUTexture(device, slot->texture);
+        }
+        const SDL_GPUTextureCreateInfo info = {
+            .type = SDL_GPU_TEXTURETYPE_2D,
+            .format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM,
+            .usage = SDL_GPU_TEXTUREUSAGE_SAMPLER,
+            .width = src->w,
+            .height = src->h,
+            .layer_count_or_depth = 1,
+            .num_levels = 1,
+        };
+        slot->texture = SDL_CreateGPUTexture(device, &info);
+        slot->tex_w = slot->texture ? src->w : 0;
+        slot->tex_h = slot->texture ? src->h : 0;
+        if (!slot->texture) {
+            ERRORF("SDL_CreateGPUTexture: %s", SDL_GetError());
+            return;
+        }
+    }
+    SDL_GPUCopyPass* copy = SDL_BeginGPUCopyPass(cmd);
+    const SDL_GPUTextureLocation from = {
+        .texture = src->texture, .x = src->x, .y = src->y};
+    const SDL_GPUTextureLocation to = {.texture = slot->texture};
+    SDL_CopyGPUTextureToTexture(copy, &from, &to, src->w, src->h, 1, false);
+    SDL_EndGPUCopyPass(copy);
+    slot->aspect = aspect;
+    present_count++;
+}
+
+static void PresentQueuedFrame(SDL_GPUCommandBuffer* cmd,
+                               SDL_GPUTexture* swapchain, Uint32 sc_w,
+                               Uint32 sc_h) {
+    const PresentSlot* slot = &present_slots[present_first];
+    const SDL_GPUBlitRegion src = {
+        .texture = slot->texture, .w = slot->tex_w, .h = slot->tex_h};
+    BlitToSwapchain(cmd, swapchain, sc_w, sc_h, &src, slot->aspect);
+    DropQueuedFrame();
+}
+
+// Shows the frame when the swapchain has an image free, otherwise queues it
+// for a later VSync. The swapchain is only waited for when the queue is
+// full. Frames wait only as long as the swapchain has no image: with one
+// free again, every VSync skips the oldest frame waiting, so that the
+// latency the queue built up drains back to none.
+static void PresentFrame(SDL_GPUCommandBuffer* cmd) {
+    const int depth = (int)present_queue_depth;
+    // a lowered depth drops the frames over it rather than show them late
+    while (present_count > depth) {
+        DropQueuedFrame();
+    }
+    const bool full = present_count == depth;
+    SDL_GPUTexture* swapchain = NULL;
+    Uint32 sc_w = 0, sc_h = 0;
+    if (full) {
+        if (!SDL_WaitAndAcquireGPUSwapchainTexture(
+                cmd, sdl3_window, &swapchain, &sc_w, &sc_h)) {
+            WARNF("SDL_WaitAndAcquireGPUSwapchainTexture: %s", SDL_GetError());
+        }
+    } else if (!SDL_AcquireGPUSwapchainTexture(
+                   cmd, sdl3_window, &swapchain, &sc_w, &sc_h)) {
+        WARNF("SDL_AcquireGPUSwapchainTexture: %s", SDL_GetError());
+    }
+    SDL_GPUBlitRegion src;
+    const float aspect = GetShownRegion(&src);
+    if (present_count && (swapchain || full)) {
+        DropQueuedFrame();
+    }
+    if (!swapchain) {
+        if (depth) {
+            QueueFrame(cmd, &src, aspect);
+        }
+        return;
+    }
+    if (!present_count) {
+        BlitToSwapchain(cmd, swapchain, sc_w, sc_h, &src, aspect);
+        return;
+    }
+    PresentQueuedFrame(cmd, swapchain, sc_w, sc_h);
+    QueueFrame(cmd, &src, aspect);
+}
+
+// Hands the downloads that completed over to the capture, in frame order.
+// The fence of a frame is gone once its stream slot was waited for, which
+// happens at the latest FRAMES_IN_FLIGHT frames later, before the slot gets
+// the fence of another frame.
+static void ResolveCaptures(void) {
+    while (capture_count) {
+        CaptureSlot* slot = &capture_slots[capture_first];
+        SDL_GPUFence* fence = stream[slot->stream].fence;
+        if (fence && !SDL_QueryGPUFence(device, fence)) {
+            return;
+        }
+        capture_first = (capture_first + 1) % CAPTURE_SLOTS;
+        capture_count--;
+
+        void* dst = Capture_Begin(
+            slot->w, slot->h, CAPTURE_SOURCE_RGBA8888, slot->frame);
+        if (!dst) {
+            continue;
+        }
+        const u8* map =
+            SDL_MapGPUTransferBuffer(device, slot->transfer, false);
+        if (!map) {
+            ERRORF("SDL_MapGPUTransferBuffer: %s", SDL_GetError());
+            Capture_Cancel(dst);
+            continue;
+        }
+        memcpy(dst, map, (size_t)slot->w * slot->h * 4);
+        SDL_UnmapGPUTransferBuffer(device, slot->transfer);
+        Capture_Commit(dst);
+    }
+}
+
+// records the download of the display area, at the resolution it is about
+// to be presented at, in the command buffer of the frame
+static void CaptureFrame(void) {
+    if (capture_count == CAPTURE_SLOTS) {
+        Capture_Drop();
+        return;
+    }
+    const SDL_Rect shown = {
+        display_area.x, display_area.y,
+        SDL_min(display_size.x, VRAM_W - display_area.x),
+        SDL_min(display_size.y, VRAM_H - display_area.y)};
+    if (shown.w <= 0 || shown.h <= 0) {
+        return;
+    }
+    const ScaledRegion* scaled = NULL;
+    if (internal_res > 1) {
+        scaled = FindScaledRegion(&shown);
+    }
+    const int n = scaled ? (int)internal_res : 1;
+    const SDL_Rect origin = scaled ? scaled->rect : (SDL_Rect){0};
+    const int w = shown.w * n;
+    const int h = shown.h * n;
+    CaptureSlot* slot =
+        &capture_slots[(capture_first + capture_count) % CAPTURE_SLOTS];
+    const Uint32 size = (Uint32)(w * h * 4);
+    if (slot->capacity < size) {
+        if (slot->transfer) {
+            SDL_ReleaseGPUTransferBuffer(device, slot->transfer);
+        }
+        const SDL_GPUTransferBufferCreateInfo info = {
+            .usage = SDL_GPU_TRANSFERBUFFERUSAGE_DOWNLOAD,
+            .size = size,
+        };
+        slot->transfer = SDL_CreateGPUTransferBuffer(device, &info);
+        slot->capacity = slot->transfer ? size : 0;
+        if (!slot->transfer) {
+            ERRORF("SDL_CreateGPUTransferBuffer: %s", SDL_GetError());
+            Capture_Drop();
+            return;
+        }
+    }
+    SDL_GPUCommandBuffer* cmd = AcquireCmd();
+    if (!cmd) {
+        Capture_Drop();
+        return;
+    }
+    SDL_GPUCopyPass* copy = SDL_BeginGPUCopyPass(cmd);
+    const SDL_GPUTextureRegion region = {
+        .texture = scaled ? scaled->texture : vram_render,
+        .x = (Uint32)((shown.x - origin.x) * n),
+        .y = (Uint32)((shown.y - origin.y) * n),
+        .w = (Uint32)w,
+        .h = (Uint32)h,
+        .d = 1,
+    };
+    const SDL_GPUTextureTransferInfo transfer = {
+        .transfer_buffer = slot->transfer,
+    };
+    SDL_DownloadFromGPUTexture(copy, &region, &transfer);
+    SDL_EndGPUCopyPass(copy);
+    slot->stream = stream_slot;
+    slot->w = w;
+    slot->h = h;
+    slot->frame = gpu_stats.total_frames;
+    capture_count++;
+    pipe_stats.readback_bytes += size;
 }
 
 static void PlatformBackend_Present(void) {
@@ -603,78 +1278,41 @@ static void PlatformBackend_Present(void) {
         return;
     }
 
+    FlushPendingTransfers();
+    if (auto_res_max) {
+        set_internal_res = AutoInternalRes(internal_res);
+    }
     ApplyPendingInternalRes();
+    ResolveCaptures();
+    if (Capture_IsActive()) {
+        CaptureFrame();
+    }
 
     SDL_GPUCommandBuffer* cmd = AcquireCmd();
     if (!cmd) {
         return;
     }
     if (swapchain_ok) {
-        SDL_GPUTexture* swapchain = NULL;
-        Uint32 sc_w = 0, sc_h = 0;
-        if (!SDL_WaitAndAcquireGPUSwapchainTexture(
-                cmd, sdl3_window, &swapchain, &sc_w, &sc_h)) {
-            WARNF("SDL_WaitAndAcquireGPUSwapchainTexture: %s", SDL_GetError());
-        }
-        if (swapchain) {
-            const Uint32 n = internal_res;
-            SDL_GPUBlitRegion src = {
-                .texture = GetRenderTarget(),
-                .x = (Uint32)display_area.x * n,
-                .y = (Uint32)display_area.y * n,
-                .w = (Uint32)display_size.x * n,
-                .h = (Uint32)display_size.y * n,
-            };
-            float game_aspect =
-                GetCurrentGameAspectRatio(display_size.x, display_size.y);
-            if (debug_show_vram) {
-                src.x = 0;
-                src.y = 0;
-                src.w = VRAM_W * n;
-                src.h = VRAM_H * n;
-                game_aspect = (float)VRAM_W / (float)VRAM_H;
-            }
-
-            WndSize win = {(int)sc_w, (int)sc_h};
-            SDL_Rect dst = FitGameToWindow(game_aspect, win);
-
-            const SDL_GPUBlitInfo blit = {
-                .source = src,
-                .destination =
-                    {
-                        .texture = swapchain,
-                        .x = (Uint32)dst.x,
-                        .y = (Uint32)dst.y,
-                        .w = (Uint32)dst.w,
-                        .h = (Uint32)dst.h,
-                    },
-                // clear the swapchain to black first so the horizontal or
-                // vertical bars around the game output are black
-                .load_op = SDL_GPU_LOADOP_CLEAR,
-                .clear_color = {0.0f, 0.0f, 0.0f, 1.0f},
-                .filter = SDL_GPU_FILTER_NEAREST,
-            };
-            SDL_BlitGPUTexture(cmd, &blit);
-            if (overlay_frame_cb) {
-                overlay_frame_cb();
-            }
-            if (overlay_render_cb) {
-                SDL_GPUColorTargetInfo target = {
-                    .texture = swapchain,
-                    .load_op = SDL_GPU_LOADOP_LOAD,
-                    .store_op = SDL_GPU_STOREOP_STORE,
-                };
-                SDL_GPURenderPass* pass =
-                    SDL_BeginGPURenderPass(cmd, &target, 1, NULL);
-                overlay_render_cb(cmd, pass);
-                SDL_EndGPURenderPass(pass);
-            }
-        }
+        PresentFrame(cmd);
     } else if (overlay_frame_cb) {
         overlay_frame_cb();
     }
     finish_time = SDL_GetPerformanceCounter();
-    SubmitCmd();
+    SubmitFrame();
+    // the downloads were submitted before the frame, which keeps rendering
+    ResolveReadbacks();
+}
+
+// the frame is not shown, but its transfers and downloads still complete
+static void PlatformBackend_SkipPresent(void) {
+    if (!sdl3_window && !InitPlatform()) {
+        return;
+    }
+    FlushPendingTransfers();
+    ResolveCaptures();
+    finish_time = SDL_GetPerformanceCounter();
+    SubmitFrame();
+    ResolveReadbacks();
 }
 
 static void QuitPlatform(void) {
@@ -696,6 +1334,14 @@ static void QuitPlatform(void) {
             SDL_ReleaseGPUGraphicsPipeline(device, pipe_clear);
             pipe_clear = NULL;
         }
+        if (pipe_sprite_add) {
+            SDL_ReleaseGPUGraphicsPipeline(device, pipe_sprite_add);
+            pipe_sprite_add = NULL;
+        }
+        if (pipe_sprite_sub) {
+            SDL_ReleaseGPUGraphicsPipeline(device, pipe_sprite_sub);
+            pipe_sprite_sub = NULL;
+        }
         if (vram_render) {
             SDL_ReleaseGPUTexture(device, vram_render);
             vram_render = NULL;
@@ -704,30 +1350,33 @@ static void QuitPlatform(void) {
             SDL_ReleaseGPUTexture(device, vram_sample);
             vram_sample = NULL;
         }
-        if (scaled_vram_render) {
-            SDL_ReleaseGPUTexture(device, scaled_vram_render);
-            scaled_vram_render = NULL;
+        ReleaseScaledRegions();
+        for (int i = 0; i < PSYZ_PRESENT_QUEUE_MAX; i++) {
+            if (present_slots[i].texture) {
+                SDL_ReleaseGPUTexture(device, present_slots[i].texture);
+            }
         }
+        memset(present_slots, 0, sizeof(present_slots));
+        present_first = 0;
+        present_count = 0;
         if (vram_sampler) {
             SDL_ReleaseGPUSampler(device, vram_sampler);
             vram_sampler = NULL;
         }
-        if (vbuf) {
-            SDL_ReleaseGPUBuffer(device, vbuf);
-            vbuf = NULL;
-        }
-        if (ibuf) {
-            SDL_ReleaseGPUBuffer(device, ibuf);
-            ibuf = NULL;
-        }
-        if (clear_vbuf) {
-            SDL_ReleaseGPUBuffer(device, clear_vbuf);
-            clear_vbuf = NULL;
-        }
-        if (vtx_transfer) {
-            SDL_ReleaseGPUTransferBuffer(device, vtx_transfer);
-            vtx_transfer = NULL;
+        ReleaseStreamBuffers();
+        for (int i = 0; i < FRAMES_IN_FLIGHT; i++) {
+            if (stream[i].fence) {
+                SDL_ReleaseGPUFence(device, stream[i].fence);
+                stream[i].fence = NULL;
+            }
         }
+        stream_slot = 0;
+        stream_vertices = 0;
+        stream_indices = 0;
+        stream_sprites = 0;
+        stream_frame_vertices = 0;
+        stream_frame_indices = 0;
+        stream_frame_sprites = 0;
         if (tex_upload_transfer) {
             SDL_ReleaseGPUTransferBuffer(device, tex_upload_transfer);
             tex_upload_transfer = NULL;
@@ -736,6 +1385,26 @@ static void QuitPlatform(void) {
             SDL_ReleaseGPUTransferBuffer(device, tex_download_transfer);
             tex_download_transfer = NULL;
         }
+        // the game is shutting down, its destinations may be gone already
+        for (int i = 0; i < MAX_READBACKS; i++) {
+            if (readbacks[i].fence) {
+                SDL_ReleaseGPUFence(device, readbacks[i].fence);
+            }
+            if (readbacks[i].transfer) {
+                SDL_ReleaseGPUTransferBuffer(device, readbacks[i].transfer);
+            }
+            readbacks[i] = (Readback){0};
+        }
+        n_readbacks = 0;
+        for (int i = 0; i < CAPTURE_SLOTS; i++) {
+            if (capture_slots[i].transfer) {
+                SDL_ReleaseGPUTransferBuffer(
+                    device, capture_slots[i].transfer);
+            }
+            capture_slots[i] = (CaptureSlot){0};
+        }
+        capture_first = 0;
+        capture_count = 0;
         if (swapchain_ok) {
             SDL_ReleaseWindowFromGPUDevice(device, sdl3_window);
             swapchain_ok = false;
@@ -788,6 +1457,7 @@ static bool DownloadVramRegionAsRGBA8888(int x, int y, int w, int h, u8* out) {
     }
     memcpy(out, map, (size_t)w * h * 4);
     SDL_UnmapGPUTransferBuffer(device, tex_download_transfer);
+    pipe_stats.readback_bytes += (Uint64)w * h * 4;
     return true;
 }
 
@@ -796,6 +1466,8 @@ static unsigned char* AllocRgb888Region(int x, int y, int w, int h) {
         ERRORF("GPU device not initialized");
         return NULL;
     }
+    Psyz_GpuDrawDeferred(x, y, w, h);
+    FlushPendingTransfers();
 
     unsigned char* pixels = malloc((size_t)w * h * 3);
     u8* rgba = malloc((size_t)w * h * 4);
@@ -810,15 +1482,7 @@ static unsigned char* AllocRgb888Region(int x, int y, int w, int h) {
         free(rgba);
         return NULL;
     }
-    const u8* src = rgba;
-    unsigned char* dst = pixels;
-    for (int i = 0; i < w * h; i++) {
-        dst[0] = src[0];
-        dst[1] = src[1];
-        dst[2] = src[2];
-        dst += 3;
-        src += 4;
-    }
+    Pixel_Rgba8888ToRgb888(rgba, pixels, (size_t)w * h);
     free(rgba);
     return pixels;
 }
@@ -847,7 +1511,7 @@ static void UpdateScissor() {
     if (!sdl3_window || !InitPlatform()) {
         return;
     }
-    Draw_FlushBuffer();
+    Draw_FlushBufferFor(PSYZ_FLUSH_STATE);
 
     scissor_rect.x = draw_area_start.x;
     scissor_rect.y = draw_area_start.y;
@@ -867,6 +1531,7 @@ int Psyz_VideoSetInternalResolution(unsigned multiplier) {
         return -1;
     }
     set_internal_res = multiplier;
+    auto_res_max = 0;
     if (sdl3_window && is_platform_init_successful) {
         ApplyPendingInternalRes();
     }
@@ -913,6 +1578,7 @@ void Draw_DisplayEnable(unsigned int on) {
         if (!sdl3_window && !InitPlatform()) {
             return;
         }
+        FlushPendingTransfers();
         // when display is on, clear background in black
         SDL_GPUCommandBuffer* cmd = AcquireCmd();
         if (!cmd) {
@@ -926,17 +1592,9 @@ void Draw_DisplayEnable(unsigned int on) {
         };
         SDL_GPURenderPass* pass = SDL_BeginGPURenderPass(cmd, &target, 1, NULL);
         SDL_EndGPURenderPass(pass);
-        if (internal_res > 1 && scaled_vram_render) {
-            const SDL_GPUColorTargetInfo scaled_target = {
-                .texture = scaled_vram_render,
-                .clear_color = {0, 0, 0, 1},
-                .load_op = SDL_GPU_LOADOP_CLEAR,
-                .store_op = SDL_GPU_STOREOP_STORE,
-            };
-            SDL_GPURenderPass* scaled_pass =
-                SDL_BeginGPURenderPass(cmd, &scaled_target, 1, NULL);
-            SDL_EndGPURenderPass(scaled_pass);
-        }
+        Shadow_Fill(0, 0, VRAM_W, VRAM_H, 0);
+        // upscaled again from the black native VRAM once drawn to
+        ReleaseScaledRegions();
     } else {
         ApplyDisplayPendingChanges();
     }
@@ -946,7 +1604,7 @@ void Draw_DisplayArea(unsigned int x, unsigned int y) {
     display_area.x = (int)x;
     display_area.y = (int)y;
 
-    Draw_FlushBuffer();
+    Draw_FlushBufferFor(PSYZ_FLUSH_STATE);
     ApplyDisplayPendingChanges();
 }
 
@@ -996,16 +1654,92 @@ void Draw_SetDisplayMode(DisplayMode* mode) {
     }
 }
 
-int Draw_ExequeSync() { return 0; }
+int Draw_ExequeSync() {
+    if (readback_mode != PSYZ_READBACK_NEXT_FRAME) {
+        ResolveReadbacks();
+    }
+    return 0;
+}
 
 // optimization to avoid sampling the VRAM on an untextured batch draw
 static bool batch_has_texture = false;
-int Draw_PushPrim(u_long* packets, int max_len) {
+
+#define MAX_SPRITE_COUNT (MAX_VERTEX_COUNT / 4)
+static SpriteInstance sprite_buf[MAX_SPRITE_COUNT];
+static int n_sprites = 0;
+
+// Records a TILE or SPRT as one instance in the sprite run the batch ends
+// with, or starts a new run after the triangles recorded so far. Returns 0
+// when the rectangle has to go through the triangles instead.
+static int PushSprite(const u32* packets, int max_len) {
+    const int code = (int)(*packets >> 24);
+    const Gp0Desc* desc = &gp0_desc[code];
+    if (!pipe_sprite_add || !fast_paths || desc->kind != GP0_KIND_RECT ||
+        max_len < desc->len) {
+        return 0;
+    }
+    if (n_sprites == MAX_SPRITE_COUNT) {
+        Draw_FlushBufferFor(PSYZ_FLUSH_BUFFER_FULL);
+    }
+    BatchCmd* run = n_batch_cmds ? &batch_cmds[n_batch_cmds - 1] : NULL;
+    if (!run || run->kind != CMD_SPRITES || run->at != n_indices) {
+        run = QueueCmd(CMD_SPRITES, PSYZ_FLUSH_BUFFER_FULL);
+        run->first = n_sprites;
+        run->count = 0;
+    }
+
+    SpriteInstance* s = &sprite_buf[n_sprites];
+    const bool textured = (code & GP0_TEXTURED) != 0;
+    int word = 1;
+    // untextured TILE opcodes can have the raw texture bit set too, where
+    // it does not apply
+    *(u32*)&s->r =
+        PrimRGBA(packets, textured ? code : code & ~GP0_RAW_TEXTURE);
+    s->x = s11((short)(packets[word] & 0xFFFF));
+    s->y = s11((short)(packets[word] >> 16));
+    word++;
+    if (textured) {
+        s->u = (u8)packets[word];
+        s->v = (u8)(packets[word] >> 8);
+        s->c = (u16)(packets[word] >> 16);
+        s->t = cur_tpage;
+        word++;
+    } else {
+        s->u = s->v = 0;
+        s->c = 0xFFFF;
+        s->t = cur_tpage | TPAGE_NOTEXTURE;
+    }
+    if (desc->size) {
+        s->w = s->h = desc->size;
+    } else {
+        s->w = (s16)(packets[word] & 0xFFFF);
+        s->h = (s16)(packets[word] >> 16);
+    }
+    s->twin = cur_twin;
+    n_sprites++;
+    run->count++;
+    pipe_stats.instances++;
+    batch_has_texture |= textured;
+    return desc->len;
+}
+
+int Draw_PushPrim(u32* packets, int max_len) {
+    CountPrim(*packets);
+    int sprite = PushSprite(packets, max_len);
+    if (sprite) {
+        return sprite;
+    }
+    int fast = PushPrimFast(packets, max_len);
+    if (fast) {
+        batch_has_texture = true; // only textured primitives have fast paths
+        return fast;
+    }
     int len = max_len;
     int code = (int)(*packets >> 24) & 0xFF;
-    bool isPoly = !(code & 0x40);
-    bool isLine = (code & 0x40) && !(code & 0x20);
-    bool isTile = (code & 0x40) && (code & 0x20);
+    u8 kind = gp0_desc[code].kind;
+    bool isPoly = kind == GP0_KIND_POLY;
+    bool isLine = kind == GP0_KIND_LINE;
+    bool isTile = kind == GP0_KIND_RECT;
     bool isTextured = (code & TEXTURED) != 0;
     bool isGouraud = (code & GOURAUD) != 0;
     bool isShadeTex = !((code & 1) && isTextured && !isLine);
@@ -1278,7 +2012,7 @@ void Draw_SetAreaEnd(int x, int y) {
     UpdateScissor();
 }
 void Draw_SetOffset(int x, int y) {
-    Draw_FlushBuffer();
+    Draw_FlushBufferFor(PSYZ_FLUSH_STATE);
 
     x = x % VRAM_W;
     y = y % VRAM_H;
@@ -1292,6 +2026,22 @@ void Draw_SetOffset(int x, int y) {
     draw_offset.y = y;
 }
 
+// Upscaled, a transfer goes to the native VRAM and is mirrored right away
+// into the scaled target, so it runs on its own rather than in the batch.
+static BatchCmd* QueueXfer(BatchCmdKind kind, PsyzFlushReason reason) {
+    if (internal_res > 1) {
+        Draw_FlushBufferFor(reason);
+    } else if ((n_indices || n_sprites) && xfer_reason == PSYZ_FLUSH_EXEQUE) {
+        xfer_reason = reason;
+    }
+    return QueueCmd(kind, reason);
+}
+static void CommitXfer(void) {
+    if (internal_res > 1) {
+        Draw_FlushBuffer();
+    }
+}
+
 void Draw_ClearImage(PS1_RECT* rect, u_char r, u_char g, u_char b) {
     if (rect->w == 0 || rect->h == 0) {
         return;
@@ -1299,12 +2049,17 @@ void Draw_ClearImage(PS1_RECT* rect, u_char r, u_char g, u_char b) {
     if (!sdl3_window && !InitPlatform()) {
         return;
     }
-    SDL_GPUCommandBuffer* cmd = AcquireCmd();
-    if (!cmd) {
-        return;
-    }
-
-    Vertex quad[4] = {0};
+    SyncShadowRegion(rect->x, rect->y, rect->w, rect->h);
+    const u16 color =
+        (u16)(color_8to5(r) | color_8to5(g) << 5 | color_8to5(b) << 10);
+    Shadow_Fill(rect->x, rect->y, rect->w, rect->h, color);
+    Draw_EnsureBufferWillNotOverflow(4, 0);
+    BatchCmd* xfer = QueueXfer(CMD_CLEAR, PSYZ_FLUSH_LOAD_IMAGE);
+    xfer->rect = (SDL_Rect){rect->x, rect->y, rect->w, rect->h};
+    xfer->vertex = n_vertices;
+
+    Vertex* quad = vertex_cur;
+    memset(quad, 0, sizeof(*quad) * 4);
     quad[0].x = rect->x;
     quad[0].y = rect->y;
     quad[1].x = (short)(rect->x + rect->w);
@@ -1319,35 +2074,108 @@ void Draw_ClearImage(PS1_RECT* rect, u_char r, u_char g, u_char b) {
         quad[i].b = b;
         quad[i].a = 0;
     }
+    Draw_EnqueueBuffer(4, 0);
+    CommitXfer();
+}
 
-    Vertex* map = SDL_MapGPUTransferBuffer(device, vtx_transfer, true);
-    if (!map) {
-        ERRORF("SDL_MapGPUTransferBuffer: %s", SDL_GetError());
+// the source of an upload may be the destination of a download in flight
+static bool ReadbackPendingIn(const void* p, size_t pixels) {
+    const u16* start = (const u16*)p;
+    const u16* end = start + pixels;
+    for (int i = 0; i < n_readbacks; i++) {
+        const Readback* rb = &readbacks[i];
+        const size_t rb_pixels = (size_t)rb->rect.w * rb->rect.h;
+        if (rb->dst < end && start < rb->dst + rb_pixels) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Waits for the downloads in flight and converts them into the shadow and
+// the memory of the game, the oldest first so that the latest of two
+// overlapping wins.
+static void ResolveReadbacks(void) {
+    if (!n_readbacks) {
         return;
     }
-    memcpy(map, quad, sizeof(quad));
-    SDL_UnmapGPUTransferBuffer(device, vtx_transfer);
+    for (int i = 0; i < n_readbacks; i++) {
+        Readback* rb = &readbacks[i];
+        if (rb->fence) {
+            SDL_WaitForGPUFences(device, true, &rb->fence, 1);
+            SDL_ReleaseGPUFence(device, rb->fence);
+            rb->fence = NULL;
+        }
+        const u8* map = SDL_MapGPUTransferBuffer(device, rb->transfer, false);
+        if (!map) {
+            ERRORF("SDL_MapGPUTransferBuffer: %s", SDL_GetError());
+            continue;
+        }
+        if (rb->direct) {
+            Pixel_Rgba8888ToRgb5551(
+                map, rb->dst, (size_t)rb->rect.w * rb->rect.h);
+        } else {
+            size_t offset = 0;
+            for (int j = 0; j < rb->n_rects; j++) {
+                const SDL_Rect* r = &rb->rects[j];
+                const size_t pixels = (size_t)r->w * r->h;
+                u16* tmp = (u16*)GetVramConvertBuffer(pixels * sizeof(u16));
+                if (!tmp) {
+                    break;
+                }
+                Pixel_Rgba8888ToRgb5551(map + offset, tmp, pixels);
+                Shadow_Write(r->x, r->y, r->w, r->h, tmp);
+                offset += pixels * 4;
+            }
+        }
+        SDL_UnmapGPUTransferBuffer(device, rb->transfer);
+        if (!rb->direct) {
+            Shadow_Store(rb->rect.x, rb->rect.y, rb->rect.w, rb->rect.h,
+                         rb->dst);
+        }
+    }
+    n_readbacks = 0;
+    memset(&readback_tiles, 0, sizeof(readback_tiles));
+}
 
-    SDL_GPUCopyPass* copy = SDL_BeginGPUCopyPass(cmd);
-    const SDL_GPUTransferBufferLocation src = {.transfer_buffer = vtx_transfer};
-    const SDL_GPUBufferRegion dst = {
-        .buffer = clear_vbuf, .size = sizeof(quad)};
-    SDL_UploadToGPUBuffer(copy, &src, &dst, true);
-    SDL_EndGPUCopyPass(copy);
+// the shadow of the region is about to be read or written by the CPU
+static void SyncShadowRegion(int x, int y, int w, int h) {
+    if (!n_readbacks) {
+        return;
+    }
+    VramTiles region = {0};
+    MarkTiles(&region, x, y, w, h);
+    for (int row = 0; row < VRAM_TILE_ROWS; row++) {
+        if (region.rows[row] & readback_tiles.rows[row]) {
+            ResolveReadbacks();
+            return;
+        }
+    }
+}
 
-    const SDL_GPUColorTargetInfo target = {
-        .texture = vram_render,
-        .load_op = SDL_GPU_LOADOP_LOAD,
-        .store_op = SDL_GPU_STOREOP_STORE,
-    };
-    SDL_GPURenderPass* pass = SDL_BeginGPURenderPass(cmd, &target, 1, NULL);
-    SDL_BindGPUGraphicsPipeline(pass, pipe_clear);
-    const SDL_GPUBufferBinding vb = {.buffer = clear_vbuf};
-    SDL_BindGPUVertexBuffers(pass, 0, &vb, 1);
-    SDL_DrawGPUPrimitives(pass, 4, 1, 0, 0);
-    SDL_EndGPURenderPass(pass);
-    MarkVramDirty((SDL_Rect){rect->x, rect->y, rect->w, rect->h});
-    SyncNativeVramToScaled(rect->x, rect->y, rect->w, rect->h);
+// takes a transfer buffer from the pool, grown to hold the download
+static Readback* AllocReadback(Uint32 size) {
+    if (n_readbacks == MAX_READBACKS) {
+        ResolveReadbacks();
+    }
+    Readback* rb = &readbacks[n_readbacks];
+    if (rb->capacity < size) {
+        if (rb->transfer) {
+            SDL_ReleaseGPUTransferBuffer(device, rb->transfer);
+        }
+        const SDL_GPUTransferBufferCreateInfo info = {
+            .usage = SDL_GPU_TRANSFERBUFFERUSAGE_DOWNLOAD,
+            .size = size,
+        };
+        rb->transfer = SDL_CreateGPUTransferBuffer(device, &info);
+        rb->capacity = rb->transfer ? size : 0;
+        if (!rb->transfer) {
+            ERRORF("SDL_CreateGPUTransferBuffer: %s", SDL_GetError());
+            return NULL;
+        }
+    }
+    n_readbacks++;
+    return rb;
 }
 
 void Draw_LoadImage(PS1_RECT* rect, u_long* p) {
@@ -1357,36 +2185,31 @@ void Draw_LoadImage(PS1_RECT* rect, u_long* p) {
     if (!sdl3_window && !InitPlatform()) {
         return;
     }
-    SDL_GPUCommandBuffer* cmd = AcquireCmd();
-    if (!cmd) {
-        return;
-    }
-    u8* map = SDL_MapGPUTransferBuffer(device, tex_upload_transfer, true);
+    const size_t pixels = (size_t)rect->w * rect->h;
+    if (ReadbackPendingIn(p, pixels)) {
+        ResolveReadbacks();
+    }
+    SyncShadowRegion(rect->x, rect->y, rect->w, rect->h);
+    Shadow_Load(rect->x, rect->y, rect->w, rect->h, (const u16*)p);
+    const Uint32 size = (Uint32)(pixels * 4);
+    if (XFER_UPLOAD_ALIGNED(xfer_upload_size) + size > VRAM_BYTES) {
+        Draw_FlushBufferFor(PSYZ_FLUSH_LOAD_IMAGE);
+    }
+    BatchCmd* xfer = QueueXfer(CMD_LOAD, PSYZ_FLUSH_LOAD_IMAGE);
+    const Uint32 offset = XFER_UPLOAD_ALIGNED(xfer_upload_size);
+    // the first upload of a batch cycles away from the data of the last one
+    u8* map = SDL_MapGPUTransferBuffer(device, tex_upload_transfer, !offset);
     if (!map) {
         ERRORF("SDL_MapGPUTransferBuffer: %s", SDL_GetError());
+        n_batch_cmds--;
         return;
     }
-    ConvertRgb5551ToRgba8888((const u16*)p, map, (size_t)rect->w * rect->h);
+    Pixel_Rgb5551ToRgba8888((const u16*)p, map + offset, pixels);
     SDL_UnmapGPUTransferBuffer(device, tex_upload_transfer);
-
-    SDL_GPUCopyPass* copy = SDL_BeginGPUCopyPass(cmd);
-    const SDL_GPUTextureTransferInfo src = {
-        .transfer_buffer = tex_upload_transfer,
-        .pixels_per_row = rect->w,
-        .rows_per_layer = rect->h,
-    };
-    const SDL_GPUTextureRegion dst = {
-        .texture = vram_render,
-        .x = (Uint32)rect->x,
-        .y = (Uint32)rect->y,
-        .w = rect->w,
-        .h = rect->h,
-        .d = 1,
-    };
-    SDL_UploadToGPUTexture(copy, &src, &dst, false);
-    SDL_EndGPUCopyPass(copy);
-    MarkVramDirty((SDL_Rect){rect->x, rect->y, rect->w, rect->h});
-    SyncNativeVramToScaled(rect->x, rect->y, rect->w, rect->h);
+    xfer->rect = (SDL_Rect){rect->x, rect->y, rect->w, rect->h};
+    xfer->offset = offset;
+    xfer_upload_size = offset + size;
+    CommitXfer();
 }
 
 void Draw_StoreImage(PS1_RECT* rect, u_long* p) {
@@ -1396,25 +2219,87 @@ void Draw_StoreImage(PS1_RECT* rect, u_long* p) {
     if (!device || !vram_render) {
         return;
     }
-    Draw_FlushBuffer(); // flush primitives before operating with the VRAM
+    Draw_FlushBufferFor(PSYZ_FLUSH_STORE_IMAGE);
 
-    const size_t pixels = (size_t)rect->w * rect->h;
-    u8* rgba = malloc(pixels * 4);
-    if (!rgba) {
+    // only the tiles the GPU rendered to are downloaded, the rest of the
+    // request comes from the shadow
+    const bool direct = !InsideVram(rect->x, rect->y, rect->w, rect->h);
+    VramTiles rendered = {0};
+    if (!direct &&
+        !Shadow_TakeRendered(rect->x, rect->y, rect->w, rect->h, &rendered)) {
+        SyncShadowRegion(rect->x, rect->y, rect->w, rect->h);
+        Shadow_Store(rect->x, rect->y, rect->w, rect->h, (u16*)p);
         return;
     }
-    if (DownloadVramRegionAsRGBA8888(
-            rect->x, rect->y, rect->w, rect->h, rgba)) {
-        ConvertRgba8888ToRgb5551(rgba, (u16*)p, pixels);
+    SDL_Rect rects[VRAM_TILE_MAX_RECTS];
+    int n_rects = 1;
+    rects[0] = (SDL_Rect){rect->x, rect->y, rect->w, rect->h};
+    if (!direct) {
+        n_rects = TilesToRects(&rendered, rects);
+    }
+    size_t pixels = 0;
+    for (int i = 0; i < n_rects; i++) {
+        pixels += (size_t)rects[i].w * rects[i].h;
+    }
+    Readback* rb = AllocReadback((Uint32)(pixels * 4));
+    if (!rb) {
+        Shadow_MarkRendered(&rendered);
+        return;
+    }
+    SDL_GPUCommandBuffer* cmd = AcquireCmd();
+    if (!cmd) {
+        Shadow_MarkRendered(&rendered);
+        n_readbacks--;
+        return;
+    }
+    SDL_GPUCopyPass* copy = SDL_BeginGPUCopyPass(cmd);
+    Uint32 offset = 0;
+    for (int i = 0; i < n_rects; i++) {
+        const SDL_GPUTextureRegion region = {
+            .texture = vram_render,
+            .x = (Uint32)rects[i].x,
+            .y = (Uint32)rects[i].y,
+            .w = (Uint32)rects[i].w,
+            .h = (Uint32)rects[i].h,
+            .d = 1,
+        };
+        const SDL_GPUTextureTransferInfo transfer = {
+            .transfer_buffer = rb->transfer,
+            .offset = offset,
+        };
+        SDL_DownloadFromGPUTexture(copy, &region, &transfer);
+        offset += (Uint32)(rects[i].w * rects[i].h * 4);
+    }
+    SDL_EndGPUCopyPass(copy);
+    rb->fence = SDL_SubmitGPUCommandBufferAndAcquireFence(cmd);
+    pending_cmd = NULL;
+    if (!rb->fence) {
+        ERRORF("SDL_SubmitGPUCommandBufferAndAcquireFence: %s", SDL_GetError());
+        Shadow_MarkRendered(&rendered);
+        n_readbacks--;
+        return;
+    }
+    memcpy(rb->rects, rects, n_rects * sizeof(SDL_Rect));
+    rb->n_rects = n_rects;
+    rb->rect = (SDL_Rect){rect->x, rect->y, rect->w, rect->h};
+    rb->dst = (u16*)p;
+    rb->direct = direct;
+    if (!direct) {
+        for (int row = 0; row < VRAM_TILE_ROWS; row++) {
+            readback_tiles.rows[row] |= rendered.rows[row];
+        }
+        MarkTiles(&readback_tiles, rect->x, rect->y, rect->w, rect->h);
+    }
+    pipe_stats.readback_bytes += (Uint64)pixels * 4;
+    if (readback_mode == PSYZ_READBACK_SYNC) {
+        ResolveReadbacks();
     }
-    free(rgba);
 }
 
 void Draw_MoveImage(PS1_RECT* rect, unsigned int x, unsigned int y) {
     if (rect->x == x && rect->y == y) {
         return;
     }
-    Draw_FlushBuffer(); // flush primitives before operating with the VRAM
 
     int src_x = CLAMP(rect->x, 0, VRAM_W - 1);
     int src_y = CLAMP(rect->y, 0, VRAM_H - 1);
@@ -1439,11 +2324,452 @@ void Draw_MoveImage(PS1_RECT* rect, unsigned int x, unsigned int y) {
         return;
     }
 
-    SDL_GPUCommandBuffer* cmd = AcquireCmd();
-    if (!cmd) {
+    if (!sdl3_window && !InitPlatform()) {
         return;
     }
-    SDL_GPUCopyPass* copy = SDL_BeginGPUCopyPass(cmd);
+    SyncShadowRegion(src_x, src_y, copy_w, copy_h);
+    SyncShadowRegion(dst_x, dst_y, copy_w, copy_h);
+    Shadow_Move(src_x, src_y, dst_x, dst_y, copy_w, copy_h);
+    BatchCmd* xfer = QueueXfer(CMD_MOVE, PSYZ_FLUSH_MOVE_IMAGE);
+    xfer->rect = (SDL_Rect){dst_x, dst_y, copy_w, copy_h};
+    xfer->src_x = src_x;
+    xfer->src_y = src_y;
+    CommitXfer();
+}
+
+void Draw_ResetBuffer(void) {
+    n_vertices = 0;
+    n_indices = 0;
+    vertex_cur = vertex_buf;
+    index_cur = index_buf;
+    batch_has_texture = false;
+    n_sprites = 0;
+    n_batch_cmds = 0;
+    xfer_upload_size = 0;
+    xfer_reason = PSYZ_FLUSH_EXEQUE;
+}
+
+// Tiles the primitives of the pending batch between the two indices sample
+// from and draw to. Drawn tiles come from the bounds of every triangle,
+// unless the horizontal grid is stretching them, in which case the whole
+// draw area is assumed.
+static void ScanBatchTiles(
+    int start, int end, VramTiles* sampled, VramTiles* written) {
+    const bool bounded = draw_grid_source_width == draw_grid_target_width;
+    if (!bounded) {
+        MarkTiles(written, scissor_rect.x, scissor_rect.y, scissor_rect.w,
+                  scissor_rect.h);
+    }
+    const int clip_x1 = scissor_rect.x + scissor_rect.w;
+    const int clip_y1 = scissor_rect.y + scissor_rect.h;
+    u32 last_tex = 0xFFFFFFFF;
+    for (int i = start; i + 2 < end; i += 3) {
+        const Vertex* a = &vertex_buf[index_buf[i]];
+        const Vertex* b = &vertex_buf[index_buf[i + 1]];
+        const Vertex* c = &vertex_buf[index_buf[i + 2]];
+        // the texture state is the same for all the vertices of a primitive
+        if (!(a->t & TPAGE_NOTEXTURE)) {
+            const u32 tex = (a->t & 0x1FF) | ((u32)a->c << 16);
+            if (tex != last_tex) {
+                MarkSampledTiles(sampled, a->t, a->c);
+                last_tex = tex;
+            }
+        }
+        if (!bounded) {
+            continue;
+        }
+        // one extra pixel covers the rasterization of the line edges
+        const int x0 = SDL_max(
+            SDL_min(a->x, SDL_min(b->x, c->x)) + draw_offset.x, scissor_rect.x);
+        const int y0 = SDL_max(
+            SDL_min(a->y, SDL_min(b->y, c->y)) + draw_offset.y, scissor_rect.y);
+        const int x1 = SDL_min(
+            SDL_max(a->x, SDL_max(b->x, c->x)) + draw_offset.x + 1, clip_x1);
+        const int y1 = SDL_min(
+            SDL_max(a->y, SDL_max(b->y, c->y)) + draw_offset.y + 1, clip_y1);
+        MarkTiles(written, x0, y0, x1 - x0, y1 - y0);
+    }
+}
+
+// passes of the batch being replayed, at most one of them is open at a time
+typedef struct {
+    SDL_GPUCommandBuffer* cmd;
+    SDL_GPUCopyPass* copy;
+    SDL_GPURenderPass* render;
+    Uint32 base_vertex; // where the batch starts in the stream
+    Uint32 first_index;
+    Uint32 first_sprite;
+    SDL_GPUGraphicsPipeline* cur_pipe;
+    bool cur_subtract;
+} BatchPasses;
+
+static void EndCopyPass(BatchPasses* bp) {
+    if (bp->copy) {
+        SDL_EndGPUCopyPass(bp->copy);
+        bp->copy = NULL;
+    }
+}
+
+static void EndRenderPass(BatchPasses* bp) {
+    if (bp->render) {
+        SDL_EndGPURenderPass(bp->render);
+        bp->render = NULL;
+    }
+}
+
+static void EndPasses(BatchPasses* bp) {
+    EndRenderPass(bp);
+    EndCopyPass(bp);
+}
+
+static SDL_GPUCopyPass* UseCopyPass(BatchPasses* bp) {
+    EndRenderPass(bp);
+    if (!bp->copy) {
+        bp->copy = SDL_BeginGPUCopyPass(bp->cmd);
+    }
+    return bp->copy;
+}
+
+// appends the vertices, indices and sprites of the batch to the stream of
+// the frame
+static bool StreamBatch(BatchPasses* bp) {
+    StreamSlot* slot = &stream[stream_slot];
+    if (!slot->transfer) {
+        return false;
+    }
+    bool cycle = false;
+    if (stream_vertices + n_vertices > stream_capacity ||
+        stream_indices + n_indices > STREAM_INDICES(stream_capacity) ||
+        stream_sprites + n_sprites > STREAM_SPRITES(stream_capacity)) {
+        // the frame outgrew its slot: start over in a renamed transfer
+        // buffer, the slot grows at the end of the frame
+        cycle = true;
+        stream_vertices = 0;
+        stream_indices = 0;
+        stream_sprites = 0;
+    }
+    u8* map = SDL_MapGPUTransferBuffer(device, slot->transfer, cycle);
+    if (!map) {
+        ERRORF("SDL_MapGPUTransferBuffer: %s", SDL_GetError());
+        return false;
+    }
+    const Uint32 vtx_offset = stream_vertices * sizeof(Vertex);
+    const Uint32 vtx_size = (Uint32)(sizeof(Vertex) * n_vertices);
+    const Uint32 idx_offset = stream_indices * sizeof(*index_buf);
+    const Uint32 idx_size = (Uint32)(sizeof(*index_buf) * n_indices);
+    const Uint32 spr_offset = stream_sprites * sizeof(SpriteInstance);
+    const Uint32 spr_size = (Uint32)(sizeof(SpriteInstance) * n_sprites);
+    const Uint32 idx_area = stream_capacity * sizeof(Vertex);
+    const Uint32 spr_area =
+        idx_area + STREAM_INDICES(stream_capacity) * sizeof(*index_buf);
+    memcpy(map + vtx_offset, vertex_buf, vtx_size);
+    memcpy(map + idx_area + idx_offset, index_buf, idx_size);
+    memcpy(map + spr_area + spr_offset, sprite_buf, spr_size);
+    SDL_UnmapGPUTransferBuffer(device, slot->transfer);
+
+    SDL_GPUCopyPass* copy = UseCopyPass(bp);
+    if (vtx_size) {
+        const SDL_GPUTransferBufferLocation vtx_src = {
+            .transfer_buffer = slot->transfer, .offset = vtx_offset};
+        const SDL_GPUBufferRegion vtx_dst = {
+            .buffer = slot->vbuf, .offset = vtx_offset, .size = vtx_size};
+        SDL_UploadToGPUBuffer(copy, &vtx_src, &vtx_dst, false);
+    }
+    if (spr_size) {
+        const SDL_GPUTransferBufferLocation spr_src = {
+            .transfer_buffer = slot->transfer,
+            .offset = spr_area + spr_offset};
+        const SDL_GPUBufferRegion spr_dst = {
+            .buffer = slot->sbuf, .offset = spr_offset, .size = spr_size};
+        SDL_UploadToGPUBuffer(copy, &spr_src, &spr_dst, false);
+    }
+    if (idx_size) {
+        const SDL_GPUTransferBufferLocation idx_src = {
+            .transfer_buffer = slot->transfer,
+            .offset = idx_area + idx_offset};
+        const SDL_GPUBufferRegion idx_dst = {
+            .buffer = slot->ibuf, .offset = idx_offset, .size = idx_size};
+        SDL_UploadToGPUBuffer(copy, &idx_src, &idx_dst, false);
+    }
+    bp->base_vertex = stream_vertices;
+    bp->first_index = stream_indices;
+    bp->first_sprite = stream_sprites;
+    stream_vertices += (Uint32)n_vertices;
+    stream_indices += (Uint32)n_indices;
+    stream_sprites += (Uint32)n_sprites;
+    stream_frame_vertices += (Uint32)n_vertices;
+    stream_frame_indices += (Uint32)n_indices;
+    stream_frame_sprites += (Uint32)n_sprites;
+    return true;
+}
+
+static void SetBatchPassState(SDL_GPURenderPass* pass) {
+    const float grid_scale_x = GetDrawGridXScale();
+    const float render_scale = (float)internal_res;
+    // upscaled, the target only holds the region around the drawing area
+    SDL_Rect origin = {0, 0, VRAM_W, VRAM_H};
+    if (internal_res > 1) {
+        origin = scaled_region->rect;
+    }
+    const SDL_GPUViewport grid_viewport = {
+        .x = ((float)draw_offset.x * (1.0f - grid_scale_x) - (float)origin.x) *
+             render_scale,
+        .y = (float)-origin.y * render_scale,
+        .w = (float)VRAM_W * render_scale * grid_scale_x,
+        .h = (float)VRAM_H * render_scale,
+        .min_depth = 0.0f,
+        .max_depth = 1.0f,
+    };
+    SDL_SetGPUViewport(pass, &grid_viewport);
+    SDL_Rect clip;
+    if (!IntersectRects(&scissor_rect, &origin, &clip)) {
+        clip = (SDL_Rect){origin.x, origin.y, 0, 0};
+    }
+    const int n = (int)internal_res;
+    SDL_Rect scaled_scissor = {
+        (clip.x - origin.x) * n, (clip.y - origin.y) * n, clip.w * n,
+        clip.h * n};
+    SDL_SetGPUScissor(pass, &scaled_scissor);
+    const SDL_GPUBufferBinding vb = {.buffer = stream[stream_slot].vbuf};
+    SDL_BindGPUVertexBuffers(pass, 0, &vb, 1);
+    const SDL_GPUBufferBinding ib = {.buffer = stream[stream_slot].ibuf};
+    SDL_BindGPUIndexBuffer(pass, &ib, SDL_GPU_INDEXELEMENTSIZE_16BIT);
+    const SDL_GPUTextureSamplerBinding sampler_binding = {
+        .texture = vram_sample, .sampler = vram_sampler};
+    SDL_BindGPUFragmentSamplers(pass, 0, &sampler_binding, 1);
+}
+
+static SDL_GPURenderPass* UseRenderPass(BatchPasses* bp) {
+    if (bp->render) {
+        return bp->render;
+    }
+    EndCopyPass(bp);
+    const SDL_GPUColorTargetInfo target = {
+        .texture = GetRenderTarget(),
+        .load_op = SDL_GPU_LOADOP_LOAD,
+        .store_op = SDL_GPU_STOREOP_STORE,
+    };
+    bp->render = SDL_BeginGPURenderPass(bp->cmd, &target, 1, NULL);
+    SetBatchPassState(bp->render);
+    bp->cur_pipe = NULL;
+    return bp->render;
+}
+
+static void BindBatchPipeline(
+    BatchPasses* bp, SDL_GPURenderPass* pass, bool subtract, bool sprites) {
+    if (subtract != bp->cur_subtract) {
+        pipe_stats.blend_switches++;
+    }
+    SDL_GPUGraphicsPipeline* pipe;
+    if (sprites) {
+        pipe = subtract ? pipe_sprite_sub : pipe_sprite_add;
+    } else {
+        pipe = subtract ? pipe_tri_sub : pipe_tri_add;
+    }
+    if (pipe != bp->cur_pipe) {
+        SDL_BindGPUGraphicsPipeline(pass, pipe);
+        bp->cur_pipe = pipe;
+    }
+    bp->cur_subtract = subtract;
+}
+
+// copies to vram_sample what is about to be sampled, the rest stays dirty
+static void RefreshSampledTiles(BatchPasses* bp, const VramTiles* sampled) {
+    VramTiles stale;
+    for (int row = 0; row < VRAM_TILE_ROWS; row++) {
+        stale.rows[row] = vram_dirty.rows[row] & sampled->rows[row];
+        vram_dirty.rows[row] &= ~stale.rows[row];
+    }
+    SDL_Rect rects[VRAM_TILE_MAX_RECTS];
+    const int n = TilesToRects(&stale, rects);
+    for (int i = 0; i < n; i++) {
+        const SDL_GPUTextureLocation vram_src = {
+            .texture = vram_render,
+            .x = (Uint32)rects[i].x,
+            .y = (Uint32)rects[i].y};
+        const SDL_GPUTextureLocation vram_dst = {
+            .texture = vram_sample,
+            .x = (Uint32)rects[i].x,
+            .y = (Uint32)rects[i].y};
+        SDL_CopyGPUTextureToTexture(
+            UseCopyPass(bp), &vram_src, &vram_dst, (Uint32)rects[i].w,
+            (Uint32)rects[i].h, 1, false);
+        pipe_stats.vram_copy_bytes += (Uint64)rects[i].w * rects[i].h * 4;
+    }
+}
+
+// a transfer may come next, and the primitives after it may sample these
+static void MergeDrawnTiles(const VramTiles* drawn, VramTiles* written) {
+    Shadow_MarkRendered(drawn);
+    for (int row = 0; row < VRAM_TILE_ROWS; row++) {
+        written->rows[row] |= drawn->rows[row];
+        if (internal_res <= 1) {
+            vram_dirty.rows[row] |= drawn->rows[row];
+        }
+    }
+}
+
+static void DrawBatchRange(
+    BatchPasses* bp, int start, int end, VramTiles* written) {
+    VramTiles sampled = {0};
+    VramTiles drawn = {0};
+    ScanBatchTiles(start, end, &sampled, &drawn);
+    if (batch_has_texture) {
+        RefreshSampledTiles(bp, &sampled);
+    }
+
+    // every primitive (including lines, expanded to quads) is a triangle list
+    SDL_GPURenderPass* pass = UseRenderPass(bp);
+    if (bp->cur_pipe == pipe_sprite_add || bp->cur_pipe == pipe_sprite_sub) {
+        const SDL_GPUBufferBinding vb = {.buffer = stream[stream_slot].vbuf};
+        SDL_BindGPUVertexBuffers(pass, 0, &vb, 1);
+        bp->cur_pipe = NULL;
+    }
+    const int prim_size = 3;
+    while (start < end) {
+        Vertex* v = &vertex_buf[index_buf[start]];
+        bool need_subtract = is_subtract_abr(v);
+        int next = start + prim_size;
+        while (next < end) {
+            v = &vertex_buf[index_buf[next]];
+            bool next_subtract = is_subtract_abr(v);
+            if (next_subtract != need_subtract) {
+                break;
+            }
+            next += prim_size;
+        }
+        BindBatchPipeline(bp, pass, need_subtract, false);
+        SDL_DrawGPUIndexedPrimitives(
+            pass, (Uint32)(next - start), 1, bp->first_index + (Uint32)start,
+            (Sint32)bp->base_vertex, 0);
+        start = next;
+    }
+    MergeDrawnTiles(&drawn, written);
+}
+
+static inline bool SpriteSubtracts(const SpriteInstance* s) {
+    return s->a == 0x80 && (s->t & 0x60) == 0x40;
+}
+
+// Draws a run of sprites as instances of a four vertices strip, each span
+// sharing a blend mode in a single call. Like for triangles, the drawn
+// tiles are the bounds of each sprite unless the grid stretches them.
+static void DrawSprites(
+    BatchPasses* bp, const BatchCmd* run, VramTiles* written) {
+    const SpriteInstance* sprites = &sprite_buf[run->first];
+    const bool bounded = draw_grid_source_width == draw_grid_target_width;
+    const int clip_x1 = scissor_rect.x + scissor_rect.w;
+    const int clip_y1 = scissor_rect.y + scissor_rect.h;
+    VramTiles sampled = {0};
+    VramTiles drawn = {0};
+    if (!bounded) {
+        MarkTiles(&drawn, scissor_rect.x, scissor_rect.y, scissor_rect.w,
+                  scissor_rect.h);
+    }
+    u32 last_tex = 0xFFFFFFFF;
+    for (int i = 0; i < run->count; i++) {
+        const SpriteInstance* s = &sprites[i];
+        if (!(s->t & TPAGE_NOTEXTURE)) {
+            const u32 tex = (s->t & 0x1FF) | ((u32)s->c << 16);
+            if (tex != last_tex) {
+                MarkSampledTiles(&sampled, s->t, s->c);
+                last_tex = tex;
+            }
+        }
+        if (!bounded) {
+            continue;
+        }
+        const int x0 = SDL_max(
+            SDL_min(s->x, s->x + s->w) + draw_offset.x, scissor_rect.x);
+        const int y0 = SDL_max(
+            SDL_min(s->y, s->y + s->h) + draw_offset.y, scissor_rect.y);
+        const int x1 =
+            SDL_min(SDL_max(s->x, s->x + s->w) + draw_offset.x, clip_x1);
+        const int y1 =
+            SDL_min(SDL_max(s->y, s->y + s->h) + draw_offset.y, clip_y1);
+        MarkTiles(&drawn, x0, y0, x1 - x0, y1 - y0);
+    }
+    if (batch_has_texture) {
+        RefreshSampledTiles(bp, &sampled);
+    }
+
+    SDL_GPURenderPass* pass = UseRenderPass(bp);
+    int start = 0;
+    while (start < run->count) {
+        const bool need_subtract = SpriteSubtracts(&sprites[start]);
+        int next = start + 1;
+        while (next < run->count &&
+               SpriteSubtracts(&sprites[next]) == need_subtract) {
+            next++;
+        }
+        BindBatchPipeline(bp, pass, need_subtract, true);
+        const SDL_GPUBufferBinding sb = {
+            .buffer = stream[stream_slot].sbuf,
+            .offset = (bp->first_sprite + (Uint32)(run->first + start)) *
+                      sizeof(SpriteInstance)};
+        SDL_BindGPUVertexBuffers(pass, 0, &sb, 1);
+        SDL_DrawGPUPrimitives(pass, 4, (Uint32)(next - start), 0, 0);
+        start = next;
+    }
+    MergeDrawnTiles(&drawn, written);
+}
+
+static void ClearVram(BatchPasses* bp, const BatchCmd* xfer) {
+    SDL_GPURenderPass* pass;
+    if (internal_res <= 1) {
+        pass = UseRenderPass(bp);
+    } else {
+        EndPasses(bp);
+        const SDL_GPUColorTargetInfo target = {
+            .texture = vram_render,
+            .load_op = SDL_GPU_LOADOP_LOAD,
+            .store_op = SDL_GPU_STOREOP_STORE,
+        };
+        pass = bp->render = SDL_BeginGPURenderPass(bp->cmd, &target, 1, NULL);
+    }
+    // fills ignore the drawing area and offset
+    const SDL_GPUViewport viewport = {
+        .w = (float)VRAM_W, .h = (float)VRAM_H, .max_depth = 1.0f};
+    const SDL_Rect whole_vram = {0, 0, VRAM_W, VRAM_H};
+    SDL_SetGPUViewport(pass, &viewport);
+    SDL_SetGPUScissor(pass, &whole_vram);
+    SDL_BindGPUGraphicsPipeline(pass, pipe_clear);
+    const SDL_GPUBufferBinding vb = {.buffer = stream[stream_slot].vbuf};
+    SDL_BindGPUVertexBuffers(pass, 0, &vb, 1);
+    SDL_DrawGPUPrimitives(
+        pass, 4, 1, bp->base_vertex + (Uint32)xfer->vertex, 0);
+    if (internal_res <= 1) {
+        SetBatchPassState(pass);
+        bp->cur_pipe = NULL;
+    }
+}
+
+static void UploadVram(BatchPasses* bp, const BatchCmd* xfer) {
+    const SDL_GPUTextureTransferInfo src = {
+        .transfer_buffer = tex_upload_transfer,
+        .offset = xfer->offset,
+        .pixels_per_row = (Uint32)xfer->rect.w,
+        .rows_per_layer = (Uint32)xfer->rect.h,
+    };
+    const SDL_GPUTextureRegion dst = {
+        .texture = vram_render,
+        .x = (Uint32)xfer->rect.x,
+        .y = (Uint32)xfer->rect.y,
+        .w = (Uint32)xfer->rect.w,
+        .h = (Uint32)xfer->rect.h,
+        .d = 1,
+    };
+    SDL_UploadToGPUTexture(UseCopyPass(bp), &src, &dst, false);
+}
+
+static void MoveVram(BatchPasses* bp, const BatchCmd* xfer) {
+    SDL_GPUCopyPass* copy = UseCopyPass(bp);
+    const int src_x = xfer->src_x;
+    const int src_y = xfer->src_y;
+    const int dst_x = xfer->rect.x;
+    const int dst_y = xfer->rect.y;
+    const int copy_w = xfer->rect.w;
+    const int copy_h = xfer->rect.h;
     if (!RectsOverlap(src_x, src_y, dst_x, dst_y, copy_w, copy_h)) {
         const SDL_GPUTextureLocation src = {
             .texture = vram_render, .x = (Uint32)src_x, .y = (Uint32)src_y};
@@ -1469,130 +2795,80 @@ void Draw_MoveImage(PS1_RECT* rect, unsigned int x, unsigned int y) {
                 copy, &src, &dst, (Uint32)copy_w, 1, 1, false);
         }
     }
-    SDL_EndGPUCopyPass(copy);
-    MarkVramDirty((SDL_Rect){dst_x, dst_y, copy_w, copy_h});
     MarkVramDirty((SDL_Rect){src_x, src_y, copy_w, copy_h});
-    SyncNativeVramToScaled(dst_x, dst_y, copy_w, copy_h);
 }
 
-void Draw_ResetBuffer(void) {
-    n_vertices = 0;
-    n_indices = 0;
-    vertex_cur = vertex_buf;
-    index_cur = index_buf;
-    batch_has_texture = false;
+static void RunXfer(BatchPasses* bp, const BatchCmd* xfer) {
+    switch (xfer->kind) {
+    case CMD_CLEAR:
+        ClearVram(bp, xfer);
+        break;
+    case CMD_LOAD:
+        UploadVram(bp, xfer);
+        break;
+    case CMD_MOVE:
+        MoveVram(bp, xfer);
+        break;
+    case CMD_SPRITES:
+        return; // drawn along with the triangles, see DrawSprites
+    }
+    MarkVramDirty(xfer->rect);
+    if (internal_res > 1) {
+        EndPasses(bp);
+        SyncNativeVramToScaled(
+            xfer->rect.x, xfer->rect.y, xfer->rect.w, xfer->rect.h);
+    }
 }
 
 void Draw_FlushBuffer(void) {
-    if (n_vertices == 0) {
+    PsyzFlushReason reason = TakeFlushReason();
+    if (n_indices == 0 && n_batch_cmds == 0) {
         return;
     }
+    if (reason == PSYZ_FLUSH_EXEQUE) {
+        reason = xfer_reason;
+    }
+    // a batch of nothing but transfers does not count as a flush
+    if (n_indices || n_sprites) {
+        pipe_stats.flushes[reason]++;
+    }
+    if (internal_res > 1 && (n_indices || n_sprites) && !SelectScaledRegion()) {
+        // out of video memory, keep rendering at native resolution
+        ReleaseScaledRegions();
+        internal_res = set_internal_res = 1;
+    }
     SDL_GPUCommandBuffer* cmd = AcquireCmd();
     if (!cmd) {
+        Draw_ResetBuffer();
         return;
     }
 
-    u8* map = SDL_MapGPUTransferBuffer(device, vtx_transfer, true);
-    if (!map) {
-        ERRORF("SDL_MapGPUTransferBuffer: %s", SDL_GetError());
+    BatchPasses bp = {.cmd = cmd};
+    if ((n_vertices || n_sprites) && !StreamBatch(&bp)) {
+        Draw_ResetBuffer();
         return;
     }
-    const Uint32 vtx_size = (Uint32)(sizeof(Vertex) * n_vertices);
-    const Uint32 idx_size = (Uint32)(sizeof(*index_buf) * n_indices);
-    const Uint32 idx_offset = MAX_VERTEX_COUNT * sizeof(Vertex);
-    memcpy(map, vertex_buf, vtx_size);
-    memcpy(map + idx_offset, index_buf, idx_size);
-    SDL_UnmapGPUTransferBuffer(device, vtx_transfer);
-
-    SDL_GPUCopyPass* copy = SDL_BeginGPUCopyPass(cmd);
-    const SDL_GPUTransferBufferLocation vtx_src = {
-        .transfer_buffer = vtx_transfer};
-    const SDL_GPUBufferRegion vtx_dst = {.buffer = vbuf, .size = vtx_size};
-    SDL_UploadToGPUBuffer(copy, &vtx_src, &vtx_dst, true);
-    const SDL_GPUTransferBufferLocation idx_src = {
-        .transfer_buffer = vtx_transfer, .offset = idx_offset};
-    const SDL_GPUBufferRegion idx_dst = {.buffer = ibuf, .size = idx_size};
-    SDL_UploadToGPUBuffer(copy, &idx_src, &idx_dst, true);
-    if (batch_has_texture && vram_dirty.w > 0 && vram_dirty.h > 0) {
-        const SDL_GPUTextureLocation vram_src = {.texture = vram_render,
-                                                 .x = (Uint32)vram_dirty.x,
-                                                 .y = (Uint32)vram_dirty.y};
-        const SDL_GPUTextureLocation vram_dst = {.texture = vram_sample,
-                                                 .x = (Uint32)vram_dirty.x,
-                                                 .y = (Uint32)vram_dirty.y};
-        SDL_CopyGPUTextureToTexture(
-            copy, &vram_src, &vram_dst, (Uint32)vram_dirty.w,
-            (Uint32)vram_dirty.h, 1, false);
-        ResetVramDirty();
-    }
-    SDL_EndGPUCopyPass(copy);
-
-    const SDL_GPUColorTargetInfo target = {
-        .texture = GetRenderTarget(),
-        .load_op = SDL_GPU_LOADOP_LOAD,
-        .store_op = SDL_GPU_STOREOP_STORE,
-    };
-    SDL_GPURenderPass* pass = SDL_BeginGPURenderPass(cmd, &target, 1, NULL);
-    {
-        const float grid_scale_x = GetDrawGridXScale();
-        const float render_scale = (float)internal_res;
-        const SDL_GPUViewport grid_viewport = {
-            .x = (float)draw_offset.x * render_scale * (1.0f - grid_scale_x),
-            .y = 0.0f,
-            .w = (float)VRAM_W * render_scale * grid_scale_x,
-            .h = (float)VRAM_H * render_scale,
-            .min_depth = 0.0f,
-            .max_depth = 1.0f,
-        };
-        SDL_SetGPUViewport(pass, &grid_viewport);
-    }
-    SDL_Rect scaled_scissor = {
-        scissor_rect.x * (int)internal_res, scissor_rect.y * (int)internal_res,
-        scissor_rect.w * (int)internal_res, scissor_rect.h * (int)internal_res};
-    SDL_SetGPUScissor(pass, &scaled_scissor);
-    const SDL_GPUBufferBinding vb = {.buffer = vbuf};
-    SDL_BindGPUVertexBuffers(pass, 0, &vb, 1);
-    const SDL_GPUBufferBinding ib = {.buffer = ibuf};
-    SDL_BindGPUIndexBuffer(pass, &ib, SDL_GPU_INDEXELEMENTSIZE_16BIT);
-    const SDL_GPUTextureSamplerBinding sampler_binding = {
-        .texture = vram_sample, .sampler = vram_sampler};
-    SDL_BindGPUFragmentSamplers(pass, 0, &sampler_binding, 1);
     const float offset_ubo[4] = {
         (float)draw_offset.x, (float)draw_offset.y, 0, 0};
     SDL_PushGPUVertexUniformData(cmd, 0, offset_ubo, sizeof(offset_ubo));
 
-    // every primitive (including lines, expanded to quads) is a triangle list
-    const int prim_size = 3;
+    // the primitives recorded between two transfers share a render pass,
+    // interrupted only to refresh what they sample
+    VramTiles written = {0};
     int start = 0;
-    bool cur_subtract = false;
-    bool pipeline_bound = false;
-    while (start < n_indices) {
-        Vertex* v = &vertex_buf[index_buf[start]];
-        bool need_subtract = is_subtract_abr(v);
-        int end = start + prim_size;
-        while (end < n_indices) {
-            v = &vertex_buf[index_buf[end]];
-            bool next_subtract = is_subtract_abr(v);
-            if (next_subtract != need_subtract) {
-                break;
-            }
-            end += prim_size;
+    for (int i = 0; i <= n_batch_cmds; i++) {
+        const int end = i < n_batch_cmds ? batch_cmds[i].at : n_indices;
+        if (end > start) {
+            DrawBatchRange(&bp, start, end, &written);
+            start = end;
         }
-        if (!pipeline_bound || need_subtract != cur_subtract) {
-            SDL_GPUGraphicsPipeline* pipe =
-                need_subtract ? pipe_tri_sub : pipe_tri_add;
-            SDL_BindGPUGraphicsPipeline(pass, pipe);
-            cur_subtract = need_subtract;
-            pipeline_bound = true;
+        if (i < n_batch_cmds && batch_cmds[i].kind == CMD_SPRITES) {
+            DrawSprites(&bp, &batch_cmds[i], &written);
+        } else if (i < n_batch_cmds) {
+            RunXfer(&bp, &batch_cmds[i]);
         }
-        SDL_DrawGPUIndexedPrimitives(
-            pass, (Uint32)(end - start), 1, (Uint32)start, 0, 0);
-        start = end;
-    }
-    SDL_EndGPURenderPass(pass);
-    if (internal_res <= 1) {
-        MarkVramDirty(scissor_rect);
     }
-    SyncScaledVramToNative();
+    EndPasses(&bp);
+    SyncScaledVramToNative(&written);
     Draw_ResetBuffer();
 }
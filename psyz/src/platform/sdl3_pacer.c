@@ -0,0 +1,111 @@
+// Frame pacer of the SDL3 frame limiter, see sdl3_pacer.h. Sleeping until
+// the deadline would wake up late by whatever the scheduler takes, spinning
+// all the way would burn a core; the pacer sleeps on an absolute deadline
+// and only spins through the wake-up jitter it measured.
+#if defined(__linux__)
+#define _DEFAULT_SOURCE // clock_nanosleep
+#include <errno.h>
+#include <time.h>
+#define PACER_ABSOLUTE_SLEEP
+#endif
+#include <psyz.h>
+#include <SDL3/SDL.h>
+#include "sdl3_pacer.h"
+
+// the margin is the mean wake-up lateness plus four times its deviation,
+// starting from the fixed millisecond the limiter used to spin
+#define PACER_MIN_MARGIN_NS 20000
+#define PACER_MAX_MARGIN_NS 2000000
+#define PACER_INITIAL_MEAN_NS 500000.0
+#define PACER_INITIAL_DEV_NS 125000.0
+
+static Uint64 period_ns = 16683333;
+static Uint64 deadline_ns = 0;
+static double late_mean_ns = PACER_INITIAL_MEAN_NS;
+static double late_dev_ns = PACER_INITIAL_DEV_NS;
+
+static Uint64 Now(void) {
+#ifdef PACER_ABSOLUTE_SLEEP
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (Uint64)ts.tv_sec * SDL_NS_PER_SECOND + (Uint64)ts.tv_nsec;
+#else
+    return SDL_GetTicksNS();
+#endif
+}
+
+static void SleepUntil(Uint64 when, Uint64 now) {
+#ifdef PACER_ABSOLUTE_SLEEP
+    (void)now;
+    const struct timespec ts = {
+        .tv_sec = (time_t)(when / SDL_NS_PER_SECOND),
+        .tv_nsec = (long)(when % SDL_NS_PER_SECOND),
+    };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) ==
+           EINTR) {
+    }
+#else
+    SDL_DelayNS(when - now);
+#endif
+}
+
+static double ThreadCpuNs(void) {
+#if defined(PACER_ABSOLUTE_SLEEP) && defined(CLOCK_THREAD_CPUTIME_ID)
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+#else
+    return -1.0;
+#endif
+}
+
+static Uint64 SpinMargin(void) {
+    const double margin = late_mean_ns + 4.0 * late_dev_ns;
+    return (Uint64)SDL_clamp(margin, PACER_MIN_MARGIN_NS, PACER_MAX_MARGIN_NS);
+}
+
+static void LearnLateness(double late_ns) {
+    const double error = late_ns - late_mean_ns;
+    late_mean_ns += error / 8.0;
+    late_dev_ns += (SDL_fabs(error) - late_dev_ns) / 4.0;
+}
+
+void Pacer_SetPeriod(double period_us) {
+    period_ns = (Uint64)(period_us * 1000.0);
+    Pacer_Reset();
+}
+
+void Pacer_Reset(void) { deadline_ns = Now() + period_ns; }
+
+void Pacer_Wait(PacerStats* stats) {
+    const double cpu_start = ThreadCpuNs();
+    Uint64 now = Now();
+    const Uint64 margin = SpinMargin();
+    Uint64 spin_start = now;
+    if (now + margin < deadline_ns) {
+        const Uint64 wake = deadline_ns - margin;
+        SleepUntil(wake, now);
+        now = Now();
+        LearnLateness(now > wake ? (double)(now - wake) : 0.0);
+        spin_start = now;
+    }
+    while (now < deadline_ns) {
+        SDL_CPUPauseInstruction();
+        now = Now();
+    }
+    const double cpu_end = ThreadCpuNs();
+
+    stats->error_us = ((double)now - (double)deadline_ns) / 1000.0;
+    if (cpu_start >= 0.0) {
+        stats->wait_cpu_us = (cpu_end - cpu_start) / 1000.0;
+    } else {
+        stats->wait_cpu_us = (double)(now - spin_start) / 1000.0;
+    }
+
+    // late by more than a frame, the schedule starts over rather than
+    // rushing the frames that follow to catch up
+    deadline_ns += period_ns;
+    if (deadline_ns <= now) {
+        deadline_ns = now + period_ns;
+    }
+}
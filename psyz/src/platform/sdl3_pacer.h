@@ -0,0 +1,29 @@
+// Private header for the frame pacer of the SDL3 frame limiter
+// Not part of the public API - do not include from external code
+
+#ifndef SDL3_PACER_H
+#define SDL3_PACER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    double error_us;    // woke up past the deadline
+    double wait_cpu_us; // CPU time the wait took
+} PacerStats;
+
+// Frames are paced on absolute deadlines, one period apart, so that a late
+// wake-up shortens the next wait instead of drifting. The wait sleeps until
+// shortly before the deadline and spins the rest; how early to wake up is
+// learnt from how late the sleeps of the previous frames woke up.
+void Pacer_SetPeriod(double period_us);
+// the next deadline is one period from now
+void Pacer_Reset(void);
+void Pacer_Wait(PacerStats* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,367 @@
+// Pixel format conversions between the PS1 VRAM layout and the RGBA8888
+// textures of the hardware backends. They run on every LoadImage,
+// StoreImage, screenshot and VRAM dump, so each has a SIMD kernel next to the
+// scalar reference; the widest one the CPU runs is picked the first time a
+// conversion is requested.
+#include <psyz.h>
+#include <string.h>
+#include <SDL3/SDL.h>
+#include "sdl3_pixel.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define PIXEL_SIMD_SSE2
+#if defined(__GNUC__) || defined(__clang__)
+#include <immintrin.h>
+#define PIXEL_SIMD_AVX2
+#define PIXEL_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(_MSC_VER)
+#include <immintrin.h>
+#define PIXEL_SIMD_AVX2
+#define PIXEL_TARGET_AVX2
+#endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define PIXEL_SIMD_NEON
+#endif
+
+// (c * 255 + 15) / 31 and (c * 31 + 127) / 255 without a division, exact
+// over 0-31 and 0-255 and without overflowing 16-bit lanes
+#define WIDEN_MUL 527
+#define WIDEN_ADD 23
+#define WIDEN_SHIFT 6
+#define NARROW_MUL 249
+#define NARROW_ADD 1014
+#define NARROW_SHIFT 11
+
+static void Rgb5551ToRgba8888_Scalar(const u16* src, u8* dst, size_t pixels) {
+    for (size_t i = 0; i < pixels; i++) {
+        u16 v = src[i];
+        dst[0] = (u8)(((v & 0x1F) * 255 + 15) / 31);
+        dst[1] = (u8)((((v >> 5) & 0x1F) * 255 + 15) / 31);
+        dst[2] = (u8)((((v >> 10) & 0x1F) * 255 + 15) / 31);
+        dst[3] = (v & 0x8000) ? 0xFF : 0x00;
+        dst += 4;
+    }
+}
+
+static void Rgba8888ToRgb5551_Scalar(const u8* src, u16* dst, size_t pixels) {
+    for (size_t i = 0; i < pixels; i++) {
+        u16 v = (u16)((src[0] * 31 + 127) / 255);
+        v |= (u16)(((src[1] * 31 + 127) / 255) << 5);
+        v |= (u16)(((src[2] * 31 + 127) / 255) << 10);
+        v |= (src[3] >= 0x80) ? 0x8000 : 0;
+        dst[i] = v;
+        src += 4;
+    }
+}
+
+static void Rgba8888ToRgb888_Scalar(const u8* src, u8* dst, size_t pixels) {
+    for (size_t i = 0; i < pixels; i++) {
+        dst[0] = src[0];
+        dst[1] = src[1];
+        dst[2] = src[2];
+        dst += 3;
+        src += 4;
+    }
+}
+
+#if defined(PIXEL_SIMD_SSE2)
+static inline __m128i Widen_SSE2(__m128i c) {
+    const __m128i mul = _mm_set1_epi16(WIDEN_MUL);
+    const __m128i add = _mm_set1_epi16(WIDEN_ADD);
+    return _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(c, mul), add),
+                          WIDEN_SHIFT);
+}
+
+static inline __m128i Narrow_SSE2(__m128i c) {
+    const __m128i mul = _mm_set1_epi16(NARROW_MUL);
+    const __m128i add = _mm_set1_epi16(NARROW_ADD);
+    return _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(c, mul), add),
+                          NARROW_SHIFT);
+}
+
+static void Rgb5551ToRgba8888_SSE2(const u16* src, u8* dst, size_t pixels) {
+    const __m128i c1f = _mm_set1_epi16(0x1F);
+    size_t i = 0;
+    for (; i + 8 <= pixels; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i r = Widen_SSE2(_mm_and_si128(v, c1f));
+        __m128i g = Widen_SSE2(_mm_and_si128(_mm_srli_epi16(v, 5), c1f));
+        __m128i b = Widen_SSE2(_mm_and_si128(_mm_srli_epi16(v, 10), c1f));
+        __m128i a = _mm_srli_epi16(_mm_srai_epi16(v, 15), 8);
+        // {r, g} and {b, a} byte pairs, interleaved into whole pixels
+        __m128i rg = _mm_or_si128(r, _mm_slli_epi16(g, 8));
+        __m128i ba = _mm_or_si128(b, _mm_slli_epi16(a, 8));
+        _mm_storeu_si128((__m128i*)(dst + i * 4), _mm_unpacklo_epi16(rg, ba));
+        _mm_storeu_si128(
+            (__m128i*)(dst + i * 4 + 16), _mm_unpackhi_epi16(rg, ba));
+    }
+    Rgb5551ToRgba8888_Scalar(src + i, dst + i * 4, pixels - i);
+}
+
+static void Rgba8888ToRgb5551_SSE2(const u8* src, u16* dst, size_t pixels) {
+    const __m128i cff = _mm_set1_epi32(0xFF);
+    const __m128i stp = _mm_set1_epi16((short)0x8000);
+    size_t i = 0;
+    for (; i + 8 <= pixels; i += 8) {
+        __m128i p0 = _mm_loadu_si128((const __m128i*)(src + i * 4));
+        __m128i p1 = _mm_loadu_si128((const __m128i*)(src + i * 4 + 16));
+        __m128i r =
+            _mm_packs_epi32(_mm_and_si128(p0, cff), _mm_and_si128(p1, cff));
+        __m128i g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), cff),
+                                    _mm_and_si128(_mm_srli_epi32(p1, 8), cff));
+        __m128i b = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 16), cff),
+                                    _mm_and_si128(_mm_srli_epi32(p1, 16), cff));
+        __m128i a =
+            _mm_packs_epi32(_mm_srli_epi32(p0, 24), _mm_srli_epi32(p1, 24));
+        __m128i v =
+            _mm_or_si128(Narrow_SSE2(r), _mm_slli_epi16(Narrow_SSE2(g), 5));
+        v = _mm_or_si128(v, _mm_slli_epi16(Narrow_SSE2(b), 10));
+        v = _mm_or_si128(v, _mm_and_si128(_mm_slli_epi16(a, 8), stp));
+        _mm_storeu_si128((__m128i*)(dst + i), v);
+    }
+    Rgba8888ToRgb5551_Scalar(src + i * 4, dst + i, pixels - i);
+}
+
+static void Rgba8888ToRgb888_SSE2(const u8* src, u8* dst, size_t pixels) {
+    const __m128i lo24 = _mm_set1_epi64x(0xFFFFFF);
+    const __m128i hi24 = _mm_set1_epi64x(0xFFFFFF000000);
+    const __m128i lane0 = _mm_set_epi64x(0, -1);
+    size_t i = 0;
+    for (; i + 4 <= pixels; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i * 4));
+        // two pixels packed in the low 6 bytes of each 64-bit lane
+        __m128i t = _mm_or_si128(_mm_and_si128(v, lo24),
+                                 _mm_and_si128(_mm_srli_epi64(v, 8), hi24));
+        __m128i out = _mm_or_si128(_mm_and_si128(t, lane0),
+                                   _mm_slli_si128(_mm_srli_si128(t, 8), 6));
+        _mm_storel_epi64((__m128i*)(dst + i * 3), out);
+        int tail = _mm_cvtsi128_si32(_mm_srli_si128(out, 8));
+        memcpy(dst + i * 3 + 8, &tail, 4);
+    }
+    Rgba8888ToRgb888_Scalar(src + i * 4, dst + i * 3, pixels - i);
+}
+#endif
+
+#if defined(PIXEL_SIMD_AVX2)
+PIXEL_TARGET_AVX2 static inline __m256i Widen_AVX2(__m256i c) {
+    const __m256i mul = _mm256_set1_epi16(WIDEN_MUL);
+    const __m256i add = _mm256_set1_epi16(WIDEN_ADD);
+    return _mm256_srli_epi16(
+        _mm256_add_epi16(_mm256_mullo_epi16(c, mul), add), WIDEN_SHIFT);
+}
+
+PIXEL_TARGET_AVX2 static inline __m256i Narrow_AVX2(__m256i c) {
+    const __m256i mul = _mm256_set1_epi16(NARROW_MUL);
+    const __m256i add = _mm256_set1_epi16(NARROW_ADD);
+    return _mm256_srli_epi16(
+        _mm256_add_epi16(_mm256_mullo_epi16(c, mul), add), NARROW_SHIFT);
+}
+
+PIXEL_TARGET_AVX2 static void Rgb5551ToRgba8888_AVX2(
+    const u16* src, u8* dst, size_t pixels) {
+    const __m256i c1f = _mm256_set1_epi16(0x1F);
+    size_t i = 0;
+    for (; i + 16 <= pixels; i += 16) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i r = Widen_AVX2(_mm256_and_si256(v, c1f));
+        __m256i g = Widen_AVX2(_mm256_and_si256(_mm256_srli_epi16(v, 5), c1f));
+        __m256i b =
+            Widen_AVX2(_mm256_and_si256(_mm256_srli_epi16(v, 10), c1f));
+        __m256i a = _mm256_srli_epi16(_mm256_srai_epi16(v, 15), 8);
+        __m256i rg = _mm256_or_si256(r, _mm256_slli_epi16(g, 8));
+        __m256i ba = _mm256_or_si256(b, _mm256_slli_epi16(a, 8));
+        // unpacking stays within 128-bit lanes: pixels 0-3 and 8-11 in lo,
+        // 4-7 and 12-15 in hi
+        __m256i lo = _mm256_unpacklo_epi16(rg, ba);
+        __m256i hi = _mm256_unpackhi_epi16(rg, ba);
+        _mm256_storeu_si256((__m256i*)(dst + i * 4),
+                            _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i*)(dst + i * 4 + 32),
+                            _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    Rgb5551ToRgba8888_Scalar(src + i, dst + i * 4, pixels - i);
+}
+
+PIXEL_TARGET_AVX2 static void Rgba8888ToRgb5551_AVX2(
+    const u8* src, u16* dst, size_t pixels) {
+    const __m256i cff = _mm256_set1_epi32(0xFF);
+    const __m256i stp = _mm256_set1_epi16((short)0x8000);
+    size_t i = 0;
+    for (; i + 16 <= pixels; i += 16) {
+        __m256i p0 = _mm256_loadu_si256((const __m256i*)(src + i * 4));
+        __m256i p1 = _mm256_loadu_si256((const __m256i*)(src + i * 4 + 32));
+        __m256i r = _mm256_packs_epi32(
+            _mm256_and_si256(p0, cff), _mm256_and_si256(p1, cff));
+        __m256i g = _mm256_packs_epi32(
+            _mm256_and_si256(_mm256_srli_epi32(p0, 8), cff),
+            _mm256_and_si256(_mm256_srli_epi32(p1, 8), cff));
+        __m256i b = _mm256_packs_epi32(
+            _mm256_and_si256(_mm256_srli_epi32(p0, 16), cff),
+            _mm256_and_si256(_mm256_srli_epi32(p1, 16), cff));
+        __m256i a = _mm256_packs_epi32(
+            _mm256_srli_epi32(p0, 24), _mm256_srli_epi32(p1, 24));
+        __m256i v = _mm256_or_si256(
+            Narrow_AVX2(r), _mm256_slli_epi16(Narrow_AVX2(g), 5));
+        v = _mm256_or_si256(v, _mm256_slli_epi16(Narrow_AVX2(b), 10));
+        v = _mm256_or_si256(
+            v, _mm256_and_si256(_mm256_slli_epi16(a, 8), stp));
+        // packing interleaved the 128-bit lanes as pixels 0-3, 8-11, 4-7
+        // and 12-15
+        v = _mm256_permute4x64_epi64(v, 0xD8);
+        _mm256_storeu_si256((__m256i*)(dst + i), v);
+    }
+    Rgba8888ToRgb5551_Scalar(src + i * 4, dst + i, pixels - i);
+}
+
+PIXEL_TARGET_AVX2 static void Rgba8888ToRgb888_AVX2(
+    const u8* src, u8* dst, size_t pixels) {
+    const __m256i pack = _mm256_setr_epi8(
+        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1, //
+        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    const __m256i join = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+    size_t i = 0;
+    for (; i + 8 <= pixels; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + i * 4));
+        v = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, pack), join);
+        _mm_storeu_si128((__m128i*)(dst + i * 3), _mm256_castsi256_si128(v));
+        _mm_storel_epi64((__m128i*)(dst + i * 3 + 16),
+                         _mm256_extracti128_si256(v, 1));
+    }
+    Rgba8888ToRgb888_Scalar(src + i * 4, dst + i * 3, pixels - i);
+}
+#endif
+
+#if defined(PIXEL_SIMD_NEON)
+static inline uint16x8_t Widen_NEON(uint16x8_t c) {
+    return vshrq_n_u16(
+        vmlaq_n_u16(vdupq_n_u16(WIDEN_ADD), c, WIDEN_MUL), WIDEN_SHIFT);
+}
+
+static inline uint16x8_t Narrow_NEON(uint16x8_t c) {
+    return vshrq_n_u16(
+        vmlaq_n_u16(vdupq_n_u16(NARROW_ADD), c, NARROW_MUL), NARROW_SHIFT);
+}
+
+static void Rgb5551ToRgba8888_NEON(const u16* src, u8* dst, size_t pixels) {
+    const uint16x8_t c1f = vdupq_n_u16(0x1F);
+    size_t i = 0;
+    for (; i + 8 <= pixels; i += 8) {
+        uint16x8_t v = vld1q_u16(src + i);
+        uint8x8x4_t px;
+        px.val[0] = vmovn_u16(Widen_NEON(vandq_u16(v, c1f)));
+        px.val[1] = vmovn_u16(Widen_NEON(vandq_u16(vshrq_n_u16(v, 5), c1f)));
+        px.val[2] = vmovn_u16(Widen_NEON(vandq_u16(vshrq_n_u16(v, 10), c1f)));
+        px.val[3] = vmovn_u16(
+            vreinterpretq_u16_s16(vshrq_n_s16(vreinterpretq_s16_u16(v), 15)));
+        vst4_u8(dst + i * 4, px);
+    }
+    Rgb5551ToRgba8888_Scalar(src + i, dst + i * 4, pixels - i);
+}
+
+static void Rgba8888ToRgb5551_NEON(const u8* src, u16* dst, size_t pixels) {
+    size_t i = 0;
+    for (; i + 8 <= pixels; i += 8) {
+        uint8x8x4_t px = vld4_u8(src + i * 4);
+        uint16x8_t v = Narrow_NEON(vmovl_u8(px.val[0]));
+        v = vorrq_u16(v, vshlq_n_u16(Narrow_NEON(vmovl_u8(px.val[1])), 5));
+        v = vorrq_u16(v, vshlq_n_u16(Narrow_NEON(vmovl_u8(px.val[2])), 10));
+        v = vorrq_u16(v, vshlq_n_u16(vmovl_u8(vshr_n_u8(px.val[3], 7)), 15));
+        vst1q_u16(dst + i, v);
+    }
+    Rgba8888ToRgb5551_Scalar(src + i * 4, dst + i, pixels - i);
+}
+
+static void Rgba8888ToRgb888_NEON(const u8* src, u8* dst, size_t pixels) {
+    size_t i = 0;
+    for (; i + 16 <= pixels; i += 16) {
+        uint8x16x4_t px = vld4q_u8(src + i * 4);
+        uint8x16x3_t rgb = {{px.val[0], px.val[1], px.val[2]}};
+        vst3q_u8(dst + i * 3, rgb);
+    }
+    Rgba8888ToRgb888_Scalar(src + i * 4, dst + i * 3, pixels - i);
+}
+#endif
+
+typedef struct {
+    void (*to_rgba8888)(const u16* src, u8* dst, size_t pixels);
+    void (*to_rgb5551)(const u8* src, u16* dst, size_t pixels);
+    void (*to_rgb888)(const u8* src, u8* dst, size_t pixels);
+} PixelKernels;
+
+// left zeroed for the instruction sets this build does not have
+static const PixelKernels kernels[PIXEL_ISA_COUNT] = {
+    [PIXEL_ISA_SCALAR] = {Rgb5551ToRgba8888_Scalar, Rgba8888ToRgb5551_Scalar,
+                          Rgba8888ToRgb888_Scalar},
+#if defined(PIXEL_SIMD_SSE2)
+    [PIXEL_ISA_SSE2] = {Rgb5551ToRgba8888_SSE2, Rgba8888ToRgb5551_SSE2,
+                        Rgba8888ToRgb888_SSE2},
+#endif
+#if defined(PIXEL_SIMD_AVX2)
+    [PIXEL_ISA_AVX2] = {Rgb5551ToRgba8888_AVX2, Rgba8888ToRgb5551_AVX2,
+                        Rgba8888ToRgb888_AVX2},
+#endif
+#if defined(PIXEL_SIMD_NEON)
+    [PIXEL_ISA_NEON] = {Rgb5551ToRgba8888_NEON, Rgba8888ToRgb5551_NEON,
+                        Rgba8888ToRgb888_NEON},
+#endif
+};
+
+static void* cur_kernels = NULL;
+
+bool Pixel_IsaSupported(PixelIsa isa) {
+    if ((int)isa < 0 || isa >= PIXEL_ISA_COUNT || !kernels[isa].to_rgba8888) {
+        return false;
+    }
+    if (isa == PIXEL_ISA_AVX2) {
+        return SDL_HasAVX2();
+    }
+    return true;
+}
+
+bool Pixel_SelectIsa(PixelIsa isa) {
+    if (!Pixel_IsaSupported(isa)) {
+        return false;
+    }
+    SDL_SetAtomicPointer(&cur_kernels, (void*)&kernels[isa]);
+    return true;
+}
+
+static const PixelKernels* GetKernels(void) {
+    const PixelKernels* k = SDL_GetAtomicPointer(&cur_kernels);
+    if (!k) {
+        // the enum is sorted from the narrowest to the widest
+        PixelIsa best = PIXEL_ISA_SCALAR;
+        for (int isa = PIXEL_ISA_SCALAR; isa < PIXEL_ISA_COUNT; isa++) {
+            if (Pixel_IsaSupported((PixelIsa)isa)) {
+                best = (PixelIsa)isa;
+            }
+        }
+        k = &kernels[best];
+        SDL_SetAtomicPointer(&cur_kernels, (void*)k);
+    }
+    return k;
+}
+
+PixelIsa Pixel_CurrentIsa(void) { return (PixelIsa)(GetKernels() - kernels); }
+
+const char* Pixel_IsaName(PixelIsa isa) {
+    static const char* names[] = {"scalar", "sse2", "avx2", "neon"};
+    if ((int)isa < 0 || isa >= PIXEL_ISA_COUNT) {
+        return "unknown";
+    }
+    return names[isa];
+}
+
+void Pixel_Rgb5551ToRgba8888(const u16* src, u8* dst, size_t pixels) {
+    GetKernels()->to_rgba8888(src, dst, pixels);
+}
+
+void Pixel_Rgba8888ToRgb5551(const u8* src, u16* dst, size_t pixels) {
+    GetKernels()->to_rgb5551(src, dst, pixels);
+}
+
+void Pixel_Rgba8888ToRgb888(const u8* src, u8* dst, size_t pixels) {
+    GetKernels()->to_rgb888(src, dst, pixels);
+}
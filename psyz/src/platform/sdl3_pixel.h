@@ -0,0 +1,42 @@
+// Private header for the pixel format conversions of the SDL3 backends
+// Not part of the public API - do not include from external code
+
+#ifndef SDL3_PIXEL_H
+#define SDL3_PIXEL_H
+
+#include <psyz/types.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// kernels picked at run time: the best the CPU supports is used unless one
+// is forced with Pixel_SelectIsa
+typedef enum {
+    PIXEL_ISA_SCALAR,
+    PIXEL_ISA_SSE2,
+    PIXEL_ISA_AVX2,
+    PIXEL_ISA_NEON,
+    PIXEL_ISA_COUNT,
+} PixelIsa;
+
+// false when the kernels were not built in or the CPU cannot run them
+bool Pixel_IsaSupported(PixelIsa isa);
+bool Pixel_SelectIsa(PixelIsa isa);
+PixelIsa Pixel_CurrentIsa(void);
+const char* Pixel_IsaName(PixelIsa isa);
+
+// 5-bit channels are widened with color_5to8 and narrowed with color_8to5,
+// the mask bit maps to an alpha of 0 or 255 and back from alpha >= 128
+void Pixel_Rgb5551ToRgba8888(const u16* src, u8* dst, size_t pixels);
+void Pixel_Rgba8888ToRgb5551(const u8* src, u16* dst, size_t pixels);
+// drops the alpha channel, for screenshots and VRAM dumps
+void Pixel_Rgba8888ToRgb888(const u8* src, u8* dst, size_t pixels);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,365 @@
+// Recorder of the SDL3 backends, see Psyz_VideoRecordStart. It is a client
+// of the frame capture: the frames are converted and written from its
+// callback, on the capture thread, along with the SPU output the audio
+// callback handed over since the previous frame. The audio is cut to the
+// length of a frame each VSync, so that both streams stay in sync however
+// the game is paced.
+#include <psyz.h>
+#include <psyz/log.h>
+#include <libetc.h>
+#include <SDL3/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../internal.h"
+#include "sdl3_record.h"
+
+// stereo frames handed over by the audio callback and not written yet
+#define RECORD_AUDIO_RING 65536
+// the audio callback pulls in chunks, the first ones are held back by this
+// much so that the chunks to come arrive before the frames need them
+#define RECORD_AUDIO_DELAY 2048
+// a longer gap between two frames is not filled in
+#define RECORD_MAX_GAP 600
+#define RECORD_FILE_BUFFER (1 << 20)
+
+static bool recording = false;
+static PsyzRecordFormat record_format;
+static FILE* video_file = NULL;
+static FILE* audio_file = NULL;
+static SDL_Mutex* stats_lock = NULL;
+static PsyzRecordStats record_stats;
+// owned by the capture thread while recording
+static PsyzRecordStats written;
+static bool write_failed = false;
+static int fps_num, fps_den;
+static double audio_per_frame;
+static double audio_due;
+static bool audio_started;
+static u8* frame_buf = NULL; // the last frame, written again to fill gaps
+static size_t frame_buf_size;
+static u8* canvas = NULL; // RGB888 frames of another size than the first
+static unsigned long long last_frame;
+static short audio_out[(PSYZ_SPU_SAMPLE_RATE / 50 + 1) * 2];
+// guarded by the audio lock
+static bool audio_on = false;
+static short audio_ring[RECORD_AUDIO_RING * 2];
+static unsigned audio_read, audio_write;
+static unsigned long long audio_overflow;
+
+void Record_PushAudio(const short* samples, int num_frames) {
+    if (!audio_on) {
+        return;
+    }
+    const unsigned room = RECORD_AUDIO_RING - (audio_write - audio_read);
+    unsigned n = (unsigned)num_frames;
+    if (n > room) {
+        audio_overflow += n - room;
+        n = room;
+    }
+    for (unsigned i = 0; i < n; i++) {
+        const unsigned j = (audio_write + i) % RECORD_AUDIO_RING;
+        audio_ring[j * 2] = samples[i * 2];
+        audio_ring[j * 2 + 1] = samples[i * 2 + 1];
+    }
+    audio_write += n;
+}
+
+static void Write(const void* data, size_t size, FILE* f) {
+    if (write_failed) {
+        return;
+    }
+    if (fwrite(data, 1, size, f) != size) {
+        ERRORF("recording write failed, the rest is dropped");
+        write_failed = true;
+    }
+}
+
+// takes the audio of one frame from the ring, silence while there is none
+static void WriteAudio(void) {
+    audio_due += audio_per_frame;
+    const unsigned n = (unsigned)audio_due;
+    audio_due -= n;
+    unsigned got = 0;
+    Psyz_AudioLock();
+    unsigned avail = audio_write - audio_read;
+    if (!audio_started && avail >= RECORD_AUDIO_DELAY) {
+        audio_started = true;
+    }
+    if (audio_started) {
+        got = SDL_min(avail, n);
+        for (unsigned i = 0; i < got; i++) {
+            const unsigned j = (audio_read + i) % RECORD_AUDIO_RING;
+            audio_out[i * 2] = audio_ring[j * 2];
+            audio_out[i * 2 + 1] = audio_ring[j * 2 + 1];
+        }
+        audio_read += got;
+        avail -= got;
+        // the audio runs ahead of the frames, as when the game is too slow
+        if (avail > RECORD_AUDIO_DELAY * 2) {
+            written.audio_dropped += avail - RECORD_AUDIO_DELAY;
+            audio_read += avail - RECORD_AUDIO_DELAY;
+        }
+    }
+    written.audio_dropped += audio_overflow;
+    audio_overflow = 0;
+    Psyz_AudioUnlock();
+    if (audio_started) {
+        written.audio_padded += n - got;
+    }
+    memset(&audio_out[got * 2], 0, (n - got) * 2 * sizeof(short));
+    Write(audio_out, n * 2 * sizeof(short), audio_file);
+    written.audio_frames += n;
+}
+
+// BT.601 with the studio range, as players expect from Y4M
+static void Rgb888ToI420(const u8* rgb, int w, int h, u8* out) {
+    u8* y_plane = out;
+    u8* u_plane = y_plane + w * h;
+    u8* v_plane = u_plane + ((w + 1) / 2) * ((h + 1) / 2);
+    for (int i = 0; i < w * h; i++) {
+        const int r = rgb[i * 3], g = rgb[i * 3 + 1], b = rgb[i * 3 + 2];
+        y_plane[i] = (u8)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+    }
+    for (int y = 0; y < h; y += 2) {
+        for (int x = 0; x < w; x += 2) {
+            int r = 0, g = 0, b = 0;
+            for (int j = 0; j < 4; j++) {
+                const int sx = SDL_min(x + (j & 1), w - 1);
+                const int sy = SDL_min(y + (j >> 1), h - 1);
+                const u8* p = &rgb[(sy * w + sx) * 3];
+                r += p[0];
+                g += p[1];
+                b += p[2];
+            }
+            r /= 4;
+            g /= 4;
+            b /= 4;
+            const int i = (y / 2) * ((w + 1) / 2) + x / 2;
+            u_plane[i] = (u8)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+            v_plane[i] = (u8)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+    }
+}
+
+static bool BeginVideo(int w, int h) {
+    written.width = w;
+    written.height = h;
+    if (record_format == PSYZ_RECORD_Y4M_WAV) {
+        frame_buf_size = (size_t)w * h + 2 * ((w + 1) / 2) * ((h + 1) / 2);
+    } else {
+        frame_buf_size = (size_t)w * h * 3;
+    }
+    frame_buf = malloc(frame_buf_size);
+    canvas = malloc((size_t)w * h * 3);
+    if (!frame_buf || !canvas) {
+        ERRORF("out of memory recording %dx%d frames", w, h);
+        free(frame_buf);
+        frame_buf = NULL;
+        free(canvas);
+        canvas = NULL;
+        return false;
+    }
+    if (record_format == PSYZ_RECORD_Y4M_WAV) {
+        char header[96];
+        const int len =
+            snprintf(header, sizeof(header),
+                     "YUV4MPEG2 W%d H%d F%d:%d Ip A1:1 C420jpeg\n", w, h,
+                     fps_num, fps_den);
+        Write(header, (size_t)len, video_file);
+    }
+    return true;
+}
+
+static void WriteFrame(void) {
+    if (record_format == PSYZ_RECORD_Y4M_WAV) {
+        Write("FRAME\n", 6, video_file);
+    }
+    Write(frame_buf, frame_buf_size, video_file);
+    written.frames++;
+    WriteAudio();
+}
+
+// every frame has the size of the first one, cropped or padded with black
+static const u8* FitFrame(const PsyzCapturedFrame* frame) {
+    const int w = written.width;
+    const int h = written.height;
+    if (frame->width == w && frame->height == h) {
+        return frame->pixels;
+    }
+    const u8* src = frame->pixels;
+    const int copy_w = SDL_min(frame->width, w);
+    memset(canvas, 0, (size_t)w * h * 3);
+    for (int y = 0; y < SDL_min(frame->height, h); y++) {
+        memcpy(&canvas[(size_t)y * w * 3], &src[(size_t)y * frame->width * 3],
+               (size_t)copy_w * 3);
+    }
+    return canvas;
+}
+
+static void OnCapturedFrame(const PsyzCapturedFrame* frame, void* userdata) {
+    (void)userdata;
+    if (!frame_buf) {
+        if (!BeginVideo(frame->width, frame->height)) {
+            write_failed = true;
+            return;
+        }
+    } else if (frame->frame > last_frame + 1) {
+        // frames the capture dropped or the game skipped keep their time
+        const unsigned long long gap = frame->frame - last_frame - 1;
+        for (unsigned long long i = 0; i < SDL_min(gap, RECORD_MAX_GAP); i++) {
+            WriteFrame();
+            written.repeated_frames++;
+        }
+    }
+    last_frame = frame->frame;
+
+    const u8* rgb = FitFrame(frame);
+    if (record_format == PSYZ_RECORD_Y4M_WAV) {
+        Rgb888ToI420(rgb, written.width, written.height, frame_buf);
+    } else {
+        memcpy(frame_buf, rgb, frame_buf_size);
+    }
+    WriteFrame();
+
+    SDL_LockMutex(stats_lock);
+    record_stats = written;
+    SDL_UnlockMutex(stats_lock);
+}
+
+static void WriteWavHeader(unsigned long long frames) {
+    const Uint32 data_size = (Uint32)SDL_min(frames * 4, 0xFFFFFFDBULL);
+    const Uint32 rate = PSYZ_SPU_SAMPLE_RATE;
+    u8 header[44] = {'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E',
+                     'f', 'm', 't', ' ', 16, 0, 0, 0, 1, 0, 2, 0};
+    const Uint32 fields[] = {36 + data_size, rate, rate * 4};
+    memcpy(&header[4], &fields[0], 4);
+    memcpy(&header[24], &fields[1], 4);
+    memcpy(&header[28], &fields[2], 4);
+    header[32] = 4;  // bytes per frame
+    header[34] = 16; // bits per sample
+    memcpy(&header[36], "data", 4);
+    memcpy(&header[40], &data_size, 4);
+    fwrite(header, 1, sizeof(header), audio_file);
+}
+
+static FILE* OpenOutput(const char* path, const char* ext) {
+    char name[1024];
+    if (snprintf(name, sizeof(name), "%s%s", path, ext) >= (int)sizeof(name)) {
+        ERRORF("recording path too long");
+        return NULL;
+    }
+    FILE* f = fopen(name, "wb");
+    if (!f) {
+        ERRORF("failed to open %s for recording", name);
+        return NULL;
+    }
+    setvbuf(f, NULL, _IOFBF, RECORD_FILE_BUFFER);
+    return f;
+}
+
+static void CloseOutputs(void) {
+    if (video_file) {
+        fclose(video_file);
+        video_file = NULL;
+    }
+    if (audio_file) {
+        fclose(audio_file);
+        audio_file = NULL;
+    }
+    if (stats_lock) {
+        SDL_DestroyMutex(stats_lock);
+        stats_lock = NULL;
+    }
+    free(frame_buf);
+    frame_buf = NULL;
+    free(canvas);
+    canvas = NULL;
+}
+
+int Psyz_VideoRecordStart(const char* path, PsyzRecordFormat format) {
+    if (!path || format < PSYZ_RECORD_Y4M_WAV || format > PSYZ_RECORD_RAW) {
+        return -1;
+    }
+    if (recording) {
+        return -1;
+    }
+    const bool y4m = format == PSYZ_RECORD_Y4M_WAV;
+    video_file = OpenOutput(path, y4m ? ".y4m" : ".rgb");
+    audio_file = OpenOutput(path, y4m ? ".wav" : ".pcm");
+    stats_lock = SDL_CreateMutex();
+    if (!video_file || !audio_file || !stats_lock) {
+        CloseOutputs();
+        return -1;
+    }
+    record_format = format;
+    if (y4m) {
+        WriteWavHeader(0); // the sizes are known once stopped
+    }
+    if (GetVideoMode() == MODE_PAL) {
+        fps_num = 50;
+        fps_den = 1;
+    } else {
+        fps_num = 60000;
+        fps_den = 1001;
+    }
+    audio_per_frame = (double)PSYZ_SPU_SAMPLE_RATE * fps_den / fps_num;
+    audio_due = 0.0;
+    audio_started = false;
+    memset(&written, 0, sizeof(written));
+    record_stats = written;
+    write_failed = false;
+    last_frame = 0;
+
+    Psyz_AudioLock();
+    audio_read = audio_write = 0;
+    audio_overflow = 0;
+    audio_on = true;
+    Psyz_AudioUnlock();
+    if (Psyz_VideoCaptureStart(
+            OnCapturedFrame, NULL, PSYZ_CAPTURE_RGB888) != 0) {
+        Psyz_AudioLock();
+        audio_on = false;
+        Psyz_AudioUnlock();
+        CloseOutputs();
+        return -1;
+    }
+    recording = true;
+    INFOF("recording to %s%s", path, y4m ? ".y4m and .wav" : ".rgb and .pcm");
+    return 0;
+}
+
+void Psyz_VideoRecordStop(void) {
+    if (!recording) {
+        return;
+    }
+    // delivers the frames still queued, the callback is done afterwards
+    Psyz_VideoCaptureStop();
+    Psyz_AudioLock();
+    audio_on = false;
+    Psyz_AudioUnlock();
+    recording = false;
+
+    if (record_format == PSYZ_RECORD_Y4M_WAV && !write_failed &&
+        fseek(audio_file, 0, SEEK_SET) == 0) {
+        WriteWavHeader(written.audio_frames);
+    }
+    record_stats = written;
+    CloseOutputs();
+    INFOF("recorded %llu frames, %llu repeated", written.frames,
+          written.repeated_frames);
+}
+
+int Psyz_VideoRecordStats(PsyzRecordStats* stats) {
+    if (!stats) {
+        return -1;
+    }
+    if (stats_lock) {
+        SDL_LockMutex(stats_lock);
+        *stats = record_stats;
+        SDL_UnlockMutex(stats_lock);
+    } else {
+        *stats = record_stats;
+    }
+    return 0;
+}
@@ -0,0 +1,19 @@
+// Private header for the recorder of the SDL3 backends
+// Not part of the public API - do not include from external code
+
+#ifndef SDL3_RECORD_H
+#define SDL3_RECORD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Called by the audio callback with the SPU output it just pulled, under the
+// audio lock. Does nothing unless Psyz_VideoRecordStart is recording.
+void Record_PushAudio(const short* samples, int num_frames);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
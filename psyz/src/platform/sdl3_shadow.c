@@ -0,0 +1,107 @@
+// CPU copy of VRAM for the hardware backends, see sdl3_shadow.h
+#include <psyz.h>
+#include <string.h>
+#include "sdl3_shadow.h"
+
+static u16 shadow[VRAM_W * VRAM_H];
+static VramTiles rendered;
+
+void Shadow_Reset(void) { memset(&rendered, 0xFF, sizeof(rendered)); }
+
+// tiles the region covers entirely now hold what the CPU wrote
+static void ClearCoveredTiles(int x, int y, int w, int h) {
+    const int col0 = (x + VRAM_TILE_SIZE - 1) >> VRAM_TILE_SHIFT;
+    const int col1 = (x + w) >> VRAM_TILE_SHIFT;
+    const int row0 = (y + VRAM_TILE_SIZE - 1) >> VRAM_TILE_SHIFT;
+    const int row1 = (y + h) >> VRAM_TILE_SHIFT;
+    if (col1 <= col0) {
+        return;
+    }
+    const u32 mask = (u32)(((Uint64)1 << col1) - ((Uint64)1 << col0));
+    for (int row = row0; row < row1; row++) {
+        rendered.rows[row] &= ~mask;
+    }
+}
+
+// what the CPU cannot mirror is left to the GPU
+static bool Mirrored(int x, int y, int w, int h) {
+    if (InsideVram(x, y, w, h)) {
+        return true;
+    }
+    MarkTiles(&rendered, x, y, w, h);
+    return false;
+}
+
+void Shadow_Load(int x, int y, int w, int h, const u16* src) {
+    if (!Mirrored(x, y, w, h)) {
+        return;
+    }
+    Shadow_Write(x, y, w, h, src);
+    ClearCoveredTiles(x, y, w, h);
+}
+
+void Shadow_Fill(int x, int y, int w, int h, u16 color) {
+    if (!Mirrored(x, y, w, h)) {
+        return;
+    }
+    for (int row = 0; row < h; row++) {
+        u16* dst = &shadow[(y + row) * VRAM_W + x];
+        for (int col = 0; col < w; col++) {
+            dst[col] = color;
+        }
+    }
+    ClearCoveredTiles(x, y, w, h);
+}
+
+void Shadow_Move(int src_x, int src_y, int dst_x, int dst_y, int w, int h) {
+    if (!InsideVram(src_x, src_y, w, h) || !Mirrored(dst_x, dst_y, w, h)) {
+        MarkTiles(&rendered, dst_x, dst_y, w, h);
+        return;
+    }
+    for (int row = 0; row < h; row++) {
+        memmove(&shadow[(dst_y + row) * VRAM_W + dst_x],
+                &shadow[(src_y + row) * VRAM_W + src_x], w * sizeof(u16));
+    }
+    VramTiles src = {0};
+    MarkTiles(&src, src_x, src_y, w, h);
+    for (int row = 0; row < VRAM_TILE_ROWS; row++) {
+        if (src.rows[row] & rendered.rows[row]) {
+            // some of the source only exists on the GPU
+            MarkTiles(&rendered, dst_x, dst_y, w, h);
+            return;
+        }
+    }
+    ClearCoveredTiles(dst_x, dst_y, w, h);
+}
+
+void Shadow_MarkRendered(const VramTiles* tiles) {
+    for (int row = 0; row < VRAM_TILE_ROWS; row++) {
+        rendered.rows[row] |= tiles->rows[row];
+    }
+}
+
+bool Shadow_TakeRendered(int x, int y, int w, int h, VramTiles* out) {
+    VramTiles region = {0};
+    MarkTiles(&region, x, y, w, h);
+    u32 any = 0;
+    for (int row = 0; row < VRAM_TILE_ROWS; row++) {
+        out->rows[row] = region.rows[row] & rendered.rows[row];
+        rendered.rows[row] &= ~out->rows[row];
+        any |= out->rows[row];
+    }
+    return any != 0;
+}
+
+void Shadow_Write(int x, int y, int w, int h, const u16* src) {
+    for (int row = 0; row < h; row++) {
+        memcpy(&shadow[(y + row) * VRAM_W + x], src + (size_t)row * w,
+               w * sizeof(u16));
+    }
+}
+
+void Shadow_Store(int x, int y, int w, int h, u16* dst) {
+    for (int row = 0; row < h; row++) {
+        memcpy(dst + (size_t)row * w, &shadow[(y + row) * VRAM_W + x],
+               w * sizeof(u16));
+    }
+}
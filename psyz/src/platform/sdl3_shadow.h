@@ -0,0 +1,103 @@
+// Private header for the CPU copy of VRAM kept by the hardware backends
+// Not part of the public API - do not include from external code
+
+#ifndef SDL3_SHADOW_H
+#define SDL3_SHADOW_H
+
+#include <psyz/types.h>
+#include <stdbool.h>
+#include <SDL3/SDL.h>
+#include "../internal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// VRAM is tracked in 32x32 tiles, so a row of tiles fits a 32-bit mask.
+// Writes scattered across VRAM then only cost the tiles they touch, instead
+// of the bounding box of all of them.
+#define VRAM_TILE_SHIFT 5
+#define VRAM_TILE_SIZE (1 << VRAM_TILE_SHIFT)
+#define VRAM_TILE_ROWS (VRAM_H >> VRAM_TILE_SHIFT)
+// worst case is every other tile of every row
+#define VRAM_TILE_MAX_RECTS (VRAM_TILE_ROWS * (VRAM_W >> VRAM_TILE_SHIFT) / 2)
+typedef struct {
+    u32 rows[VRAM_TILE_ROWS];
+} VramTiles;
+
+static inline void MarkTiles(VramTiles* tiles, int x, int y, int w, int h) {
+    int x0 = CLAMP(x, 0, VRAM_W);
+    int y0 = CLAMP(y, 0, VRAM_H);
+    int x1 = CLAMP(x + w, 0, VRAM_W);
+    int y1 = CLAMP(y + h, 0, VRAM_H);
+    if (x1 <= x0 || y1 <= y0) {
+        return;
+    }
+    int col0 = x0 >> VRAM_TILE_SHIFT;
+    int col1 = (x1 - 1) >> VRAM_TILE_SHIFT;
+    u32 mask = (u32)(((Uint64)2 << col1) - ((Uint64)1 << col0));
+    for (int row = y0 >> VRAM_TILE_SHIFT; row <= (y1 - 1) >> VRAM_TILE_SHIFT;
+         row++) {
+        tiles->rows[row] |= mask;
+    }
+}
+
+// Merges the marked tiles into rectangles: runs of tiles of a row, extended
+// down to the following rows with the very same mask.
+static inline int TilesToRects(const VramTiles* tiles, SDL_Rect* out) {
+    int n = 0;
+    for (int row = 0; row < VRAM_TILE_ROWS;) {
+        const u32 mask = tiles->rows[row];
+        int rows = 1;
+        while (row + rows < VRAM_TILE_ROWS && tiles->rows[row + rows] == mask) {
+            rows++;
+        }
+        for (int col = 0; col < 32; col++) {
+            if (!(mask & (1u << col))) {
+                continue;
+            }
+            int cols = 1;
+            while (col + cols < 32 && (mask & (1u << (col + cols)))) {
+                cols++;
+            }
+            out[n++] = (SDL_Rect){
+                col << VRAM_TILE_SHIFT, row << VRAM_TILE_SHIFT,
+                cols << VRAM_TILE_SHIFT, rows << VRAM_TILE_SHIFT};
+            col += cols;
+        }
+        row += rows;
+    }
+    return n;
+}
+
+static inline bool InsideVram(int x, int y, int w, int h) {
+    return x >= 0 && y >= 0 && w > 0 && h > 0 && x + w <= VRAM_W &&
+           y + h <= VRAM_H;
+}
+
+// The hardware backends keep a 16-bit copy of VRAM next to their textures,
+// updated by the CPU side of LoadImage, ClearImage and MoveImage, so that
+// StoreImage is served from memory. What the GPU renders is only tracked,
+// per tile: those are the only tiles a StoreImage has to download. Regions
+// reaching outside of VRAM are left to the GPU and count as rendered.
+
+// forgets the copy, every tile counts as rendered until read back
+void Shadow_Reset(void);
+void Shadow_Load(int x, int y, int w, int h, const u16* src);
+void Shadow_Fill(int x, int y, int w, int h, u16 color);
+// row by row, like the console does when the regions overlap
+void Shadow_Move(int src_x, int src_y, int dst_x, int dst_y, int w, int h);
+void Shadow_MarkRendered(const VramTiles* tiles);
+// Moves the rendered tiles overlapping the region to `out`, returns false
+// when there are none. Their pixels are expected back through Shadow_Write
+// once downloaded; rendering them again in the meantime marks them again.
+bool Shadow_TakeRendered(int x, int y, int w, int h, VramTiles* out);
+// writes downloaded pixels, leaving the tracking alone
+void Shadow_Write(int x, int y, int w, int h, const u16* src);
+void Shadow_Store(int x, int y, int w, int h, u16* dst);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,1450 @@
+// Headless software renderer. The VRAM lives in system memory as 16-bit
+// RGB5551 pixels and primitives are rasterized on the CPU. Primitives are
+// binned into fixed-size screen tiles and every tile is rasterized by one
+// thread at a time, so the pool of workers never needs to synchronize on
+// pixels and the draw order within a tile is preserved.
+// SDL is only used for the timing, input and threading primitives shared with
+// the other SDL3 backends: no window or GPU device is ever created.
+#include <psyz.h>
+#include <psyz/overlay.h>
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include "../internal.h"
+#include <SDL3/SDL.h>
+
+// the mask bit is honoured here, sdl3_common.h must not stub it out
+#define SDL3_BACKEND_HAS_MASK
+// rasterizing never touches a graphics context, any thread can drive it
+#define SDL3_BACKEND_THREADED_DRAW
+#include "sdl3_common.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define SOFT_SIMD_SSE2
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define SOFT_SIMD_NEON
+#endif
+
+typedef struct {
+    int x, y;
+} Posi;
+
+// 64x64 tiles: 16x8 of them cover the whole VRAM
+#define SOFT_TILE_SHIFT 6
+#define SOFT_TILE_SIZE (1 << SOFT_TILE_SHIFT)
+#define SOFT_TILES_X (VRAM_W >> SOFT_TILE_SHIFT)
+#define SOFT_TILES_Y (VRAM_H >> SOFT_TILE_SHIFT)
+#define SOFT_TILE_COUNT (SOFT_TILES_X * SOFT_TILES_Y)
+
+#define SOFT_MAX_WORKERS 16
+#define SOFT_MAX_PRIMS 0x4000 // flush the batch once this many are queued
+#define SOFT_SPAN_CHUNK 64    // pixels shaded before being blended at once
+
+// vertex positions are kept with 4 bits of sub-pixel precision, required to
+// honour the fractional horizontal grid scale
+#define SOFT_SUBPIXEL_BITS 4
+#define SOFT_SUBPIXEL (1 << SOFT_SUBPIXEL_BITS)
+#define SOFT_FRAC_BITS 16
+
+enum { SOFT_PRIM_TRI, SOFT_PRIM_RECT };
+
+// per-primitive render flags
+#define SOFT_TEXTURED 0x01
+#define SOFT_SEMITRANSP 0x02
+#define SOFT_GOURAUD 0x04
+#define SOFT_DITHER 0x08
+#define SOFT_MASK_CHECK 0x10
+
+// interpolated attribute in 16.16 fixed point: value(x, y) = c + a*x + b*y
+typedef struct {
+    Sint64 a, b, c;
+} SoftPlane;
+
+typedef struct {
+    u8 kind;
+    u8 flags;
+    u8 abr;
+    u8 tex_mode; // 0: 4bpp, 1: 8bpp, 2: 15bpp
+    u16 mask_or; // 0x8000 when GP0(E6h) forces the mask bit
+    u16 page_x, page_y;
+    u16 clut_x, clut_y;
+    u32 twin;
+    int x0, y0, x1, y1; // clipped bounding box, end exclusive
+    union {
+        struct {
+            // edge functions evaluated at pixel centres, E(x, y) >= 0 inside
+            Sint64 ea[3], eb[3], ec[3];
+            SoftPlane r, g, b, u, v;
+        } tri;
+        struct {
+            int x, y;
+            u8 u, v;
+            u8 r, g, b;
+        } rect;
+    };
+} SoftPrim;
+
+typedef struct {
+    u32* idx;
+    int len, cap;
+} SoftBin;
+
+static u16 vram[VRAM_W * VRAM_H];
+static unsigned internal_res = 1;
+
+static Posi display_area = {0, 0};
+static Posi display_size = {256, 240};
+static Posi cur_display_size = {-1, -1};
+static Posi draw_offset = {0, 0};
+static Posi draw_area_start = {0, 0};
+static Posi draw_area_end = {0x10000, 0x10000};
+static SDL_Rect scissor_rect = {0, 0, VRAM_W, VRAM_H};
+static bool mask_set = false;
+static bool mask_check = false;
+
+static SoftPrim* prims = NULL;
+static int n_prims = 0;
+static int cap_prims = 0;
+static SoftBin bins[SOFT_TILE_COUNT];
+static u16 active_tiles[SOFT_TILE_COUNT];
+static int n_active_tiles = 0;
+static SDL_Rect batch_written = {0, 0, 0, 0};
+
+static SDL_Thread* workers[SOFT_MAX_WORKERS];
+static int n_workers = 0;
+static SDL_Mutex* pool_lock = NULL;
+static SDL_Condition* pool_start = NULL;
+static SDL_Condition* pool_finish = NULL;
+static unsigned pool_job = 0;
+static int pool_pending = 0;
+static bool pool_quit = false;
+static SDL_AtomicInt next_tile = {0};
+
+static const s8 dither_table[4][4] = {
+    {-4, +0, -3, +1},
+    {+2, -2, +3, -1},
+    {-3, +1, -4, +0},
+    {+3, -1, +2, -2},
+};
+
+static inline Sint64 FloorDiv(Sint64 a, Sint64 b) {
+    Sint64 q = a / b;
+    if ((a % b) != 0 && a < 0) {
+        q--;
+    }
+    return q;
+}
+
+static inline u16 FetchTexel(const SoftPrim* p, unsigned u, unsigned v) {
+    const unsigned y = (p->page_y + v) & (VRAM_H - 1);
+    const u16* row = &vram[y * VRAM_W];
+    const u16* clut = &vram[p->clut_y * VRAM_W];
+    u16 word;
+    switch (p->tex_mode) {
+    case 0:
+        word = row[(p->page_x + (u >> 2)) & (VRAM_W - 1)];
+        return clut[(p->clut_x + ((word >> ((u & 3) * 4)) & 0xF)) &
+                    (VRAM_W - 1)];
+    case 1:
+        word = row[(p->page_x + (u >> 1)) & (VRAM_W - 1)];
+        return clut[(p->clut_x + ((word >> ((u & 1) * 8)) & 0xFF)) &
+                    (VRAM_W - 1)];
+    default:
+        return row[(p->page_x + u) & (VRAM_W - 1)];
+    }
+}
+
+static inline unsigned Dither5(int c8, int off) {
+    return (unsigned)CLAMP((c8 + off) >> 3, 0, 31);
+}
+
+// PS1 texture modulation, (tex5 * col8) >> 7 saturated to 31
+static inline unsigned Modulate5(unsigned t5, unsigned c8, int off, bool d) {
+    unsigned prod = t5 * c8;
+    if (!d) {
+        prod >>= 7;
+        return prod > 31 ? 31 : prod;
+    }
+    if (prod > 255 * 16) {
+        prod = 255 * 16;
+    }
+    return (unsigned)CLAMP(((int)prod + off * 16) >> 7, 0, 31);
+}
+
+static inline u16 BlendPixel(u16 b, u16 f, int abr) {
+    int br = b & 0x1F, bg = (b >> 5) & 0x1F, bb = (b >> 10) & 0x1F;
+    int fr = f & 0x1F, fg = (f >> 5) & 0x1F, fb = (f >> 10) & 0x1F;
+    switch (abr) {
+    case 0:
+        br = (br + fr) >> 1;
+        bg = (bg + fg) >> 1;
+        bb = (bb + fb) >> 1;
+        break;
+    case 1:
+        br = SDL_min(br + fr, 31);
+        bg = SDL_min(bg + fg, 31);
+        bb = SDL_min(bb + fb, 31);
+        break;
+    case 2:
+        br = SDL_max(br - fr, 0);
+        bg = SDL_max(bg - fg, 0);
+        bb = SDL_max(bb - fb, 0);
+        break;
+    default:
+        br = SDL_min(br + (fr >> 2), 31);
+        bg = SDL_min(bg + (fg >> 2), 31);
+        bb = SDL_min(bb + (fb >> 2), 31);
+        break;
+    }
+    return (u16)(br | (bg << 5) | (bb << 10));
+}
+
+// Writes n shaded pixels to the VRAM. Lanes with draw[i] == 0 are left
+// untouched, lanes with semi[i] != 0 are blended with the destination using
+// the primitive ABR mode, the others are opaque.
+static void WriteSpanScalar(u16* dst, const u16* src, const u16* semi,
+                            const u16* draw, int n, int abr, u16 mask_or,
+                            bool check) {
+    for (int i = 0; i < n; i++) {
+        u16 d = dst[i];
+        if (!draw[i] || (check && (d & 0x8000))) {
+            continue;
+        }
+        u16 s = src[i];
+        if (semi[i]) {
+            s = BlendPixel(d, s, abr) | (s & 0x8000);
+        }
+        dst[i] = s | mask_or;
+    }
+}
+
+#if defined(SOFT_SIMD_SSE2)
+static inline __m128i BlendChannel8(__m128i b, __m128i f, int abr) {
+    const __m128i c1f = _mm_set1_epi16(0x1F);
+    switch (abr) {
+    case 0:
+        return _mm_srli_epi16(_mm_add_epi16(b, f), 1);
+    case 1:
+        return _mm_min_epi16(_mm_add_epi16(b, f), c1f);
+    case 2:
+        return _mm_subs_epu16(b, f);
+    default:
+        return _mm_min_epi16(_mm_add_epi16(b, _mm_srli_epi16(f, 2)), c1f);
+    }
+}
+
+static void WriteSpan(u16* dst, const u16* src, const u16* semi,
+                      const u16* draw, int n, int abr, u16 mask_or,
+                      bool check) {
+    const __m128i c1f = _mm_set1_epi16(0x1F);
+    const __m128i stp = _mm_set1_epi16((short)0x8000);
+    const __m128i mor = _mm_set1_epi16((short)mask_or);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i sm = _mm_loadu_si128((const __m128i*)(semi + i));
+        __m128i dw = _mm_loadu_si128((const __m128i*)(draw + i));
+        if (check) {
+            dw = _mm_andnot_si128(_mm_srai_epi16(d, 15), dw);
+        }
+        __m128i r = BlendChannel8(
+            _mm_and_si128(d, c1f), _mm_and_si128(s, c1f), abr);
+        __m128i g = BlendChannel8(
+            _mm_and_si128(_mm_srli_epi16(d, 5), c1f),
+            _mm_and_si128(_mm_srli_epi16(s, 5), c1f), abr);
+        __m128i b = BlendChannel8(
+            _mm_and_si128(_mm_srli_epi16(d, 10), c1f),
+            _mm_and_si128(_mm_srli_epi16(s, 10), c1f), abr);
+        __m128i bl = _mm_or_si128(
+            _mm_or_si128(r, _mm_slli_epi16(g, 5)), _mm_slli_epi16(b, 10));
+        bl = _mm_or_si128(bl, _mm_and_si128(s, stp));
+        __m128i res = _mm_or_si128(
+            _mm_and_si128(sm, bl), _mm_andnot_si128(sm, s));
+        res = _mm_or_si128(res, mor);
+        res = _mm_or_si128(_mm_and_si128(dw, res), _mm_andnot_si128(dw, d));
+        _mm_storeu_si128((__m128i*)(dst + i), res);
+    }
+    WriteSpanScalar(dst + i, src + i, semi + i, draw + i, n - i, abr, mask_or,
+                    check);
+}
+#elif defined(SOFT_SIMD_NEON)
+static inline uint16x8_t BlendChannel8(uint16x8_t b, uint16x8_t f, int abr) {
+    const uint16x8_t c1f = vdupq_n_u16(0x1F);
+    switch (abr) {
+    case 0:
+        return vhaddq_u16(b, f);
+    case 1:
+        return vminq_u16(vaddq_u16(b, f), c1f);
+    case 2:
+        return vqsubq_u16(b, f);
+    default:
+        return vminq_u16(vaddq_u16(b, vshrq_n_u16(f, 2)), c1f);
+    }
+}
+
+static void WriteSpan(u16* dst, const u16* src, const u16* semi,
+                      const u16* draw, int n, int abr, u16 mask_or,
+                      bool check) {
+    const uint16x8_t c1f = vdupq_n_u16(0x1F);
+    const uint16x8_t stp = vdupq_n_u16(0x8000);
+    const uint16x8_t mor = vdupq_n_u16(mask_or);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint16x8_t d = vld1q_u16(dst + i);
+        uint16x8_t s = vld1q_u16(src + i);
+        uint16x8_t sm = vld1q_u16(semi + i);
+        uint16x8_t dw = vld1q_u16(draw + i);
+        if (check) {
+            dw = vbicq_u16(dw, vtstq_u16(d, stp));
+        }
+        uint16x8_t r = BlendChannel8(vandq_u16(d, c1f), vandq_u16(s, c1f), abr);
+        uint16x8_t g = BlendChannel8(vandq_u16(vshrq_n_u16(d, 5), c1f),
+                                     vandq_u16(vshrq_n_u16(s, 5), c1f), abr);
+        uint16x8_t b = BlendChannel8(vandq_u16(vshrq_n_u16(d, 10), c1f),
+                                     vandq_u16(vshrq_n_u16(s, 10), c1f), abr);
+        uint16x8_t bl =
+            vorrq_u16(vorrq_u16(r, vshlq_n_u16(g, 5)), vshlq_n_u16(b, 10));
+        bl = vorrq_u16(bl, vandq_u16(s, stp));
+        uint16x8_t res = vorrq_u16(vbslq_u16(sm, bl, s), mor);
+        vst1q_u16(dst + i, vbslq_u16(dw, res, d));
+    }
+    WriteSpanScalar(dst + i, src + i, semi + i, draw + i, n - i, abr, mask_or,
+                    check);
+}
+#else
+#define WriteSpan WriteSpanScalar
+#endif
+
+// Shades the pixels [x0, x1) of row y. Texels and colours are resolved one
+// pixel at a time, then blended and written SOFT_SPAN_CHUNK pixels at a time.
+static void DrawSpan(const SoftPrim* p, int y, int x0, int x1) {
+    u16 src[SOFT_SPAN_CHUNK];
+    u16 semi[SOFT_SPAN_CHUNK];
+    u16 draw[SOFT_SPAN_CHUNK];
+    const bool textured = (p->flags & SOFT_TEXTURED) != 0;
+    const bool semitransp = (p->flags & SOFT_SEMITRANSP) != 0;
+    const bool dither = (p->flags & SOFT_DITHER) != 0;
+    const bool is_tri = p->kind == SOFT_PRIM_TRI;
+    const unsigned and_x = p->twin & 0xFF;
+    const unsigned and_y = (p->twin >> 8) & 0xFF;
+    const unsigned or_x = (p->twin >> 16) & 0xFF;
+    const unsigned or_y = p->twin >> 24;
+    const s8* dither_row = dither_table[y & 3];
+    u16* dst = &vram[y * VRAM_W];
+
+    // attributes at (x0, y) and their per-pixel step
+    Sint64 r, g, b, dr = 0, dg = 0, db = 0;
+    Sint64 u, v, du = 0, dv = 0;
+    if (is_tri) {
+        const SoftPlane* pl = &p->tri.r;
+        r = pl[0].c + pl[0].a * x0 + pl[0].b * y;
+        g = pl[1].c + pl[1].a * x0 + pl[1].b * y;
+        b = pl[2].c + pl[2].a * x0 + pl[2].b * y;
+        u = pl[3].c + pl[3].a * x0 + pl[3].b * y;
+        v = pl[4].c + pl[4].a * x0 + pl[4].b * y;
+        dr = pl[0].a;
+        dg = pl[1].a;
+        db = pl[2].a;
+        du = pl[3].a;
+        dv = pl[4].a;
+    } else {
+        r = (Sint64)p->rect.r << SOFT_FRAC_BITS;
+        g = (Sint64)p->rect.g << SOFT_FRAC_BITS;
+        b = (Sint64)p->rect.b << SOFT_FRAC_BITS;
+        u = (Sint64)(p->rect.u + x0 - p->rect.x) << SOFT_FRAC_BITS;
+        v = (Sint64)(p->rect.v + y - p->rect.y) << SOFT_FRAC_BITS;
+        du = (Sint64)1 << SOFT_FRAC_BITS;
+    }
+
+    while (x0 < x1) {
+        const int n = SDL_min(x1 - x0, SOFT_SPAN_CHUNK);
+        for (int i = 0; i < n; i++) {
+            const int x = x0 + i;
+            const int off = dither ? dither_row[x & 3] : 0;
+            // round to nearest, like the UNORM conversion of the GPU backends
+            int r8 = (int)((r + (1 << (SOFT_FRAC_BITS - 1))) >> SOFT_FRAC_BITS);
+            int g8 = (int)((g + (1 << (SOFT_FRAC_BITS - 1))) >> SOFT_FRAC_BITS);
+            int b8 = (int)((b + (1 << (SOFT_FRAC_BITS - 1))) >> SOFT_FRAC_BITS);
+            r8 = CLAMP(r8, 0, 255);
+            g8 = CLAMP(g8, 0, 255);
+            b8 = CLAMP(b8, 0, 255);
+            if (textured) {
+                int tu = (int)(u >> SOFT_FRAC_BITS);
+                int tv = (int)(v >> SOFT_FRAC_BITS);
+                tu = CLAMP(tu, 0, 255);
+                tv = CLAMP(tv, 0, 255);
+                u16 t = FetchTexel(p, ((unsigned)tu & and_x) | or_x,
+                                   ((unsigned)tv & and_y) | or_y);
+                if (!t) {
+                    draw[i] = 0;
+                    semi[i] = 0;
+                    src[i] = 0;
+                } else {
+                    unsigned cr = Modulate5(t & 0x1F, r8, off, dither);
+                    unsigned cg = Modulate5((t >> 5) & 0x1F, g8, off, dither);
+                    unsigned cb = Modulate5((t >> 10) & 0x1F, b8, off, dither);
+                    src[i] = (u16)(cr | (cg << 5) | (cb << 10) | (t & 0x8000));
+                    semi[i] = semitransp && (t & 0x8000) ? 0xFFFF : 0;
+                    draw[i] = 0xFFFF;
+                }
+            } else {
+                unsigned cr, cg, cb;
+                if (dither) {
+                    // dithering works on the unrounded colour
+                    cr = Dither5((int)(r >> SOFT_FRAC_BITS), off);
+                    cg = Dither5((int)(g >> SOFT_FRAC_BITS), off);
+                    cb = Dither5((int)(b >> SOFT_FRAC_BITS), off);
+                } else {
+                    cr = (unsigned)r8 >> 3;
+                    cg = (unsigned)g8 >> 3;
+                    cb = (unsigned)b8 >> 3;
+                }
+                src[i] = (u16)(cr | (cg << 5) | (cb << 10));
+                semi[i] = semitransp ? 0xFFFF : 0;
+                draw[i] = 0xFFFF;
+            }
+            r += dr;
+            g += dg;
+            b += db;
+            u += du;
+            v += dv;
+        }
+        WriteSpan(dst + x0, src, semi, draw, n, p->abr, p->mask_or,
+                  (p->flags & SOFT_MASK_CHECK) != 0);
+        x0 += n;
+    }
+}
+
+// fast path for opaque untextured flat rectangles, the bulk of most 2D scenes
+static bool FillRectFast(const SoftPrim* p, int x0, int y0, int x1, int y1) {
+    if (p->kind != SOFT_PRIM_RECT ||
+        (p->flags & (SOFT_TEXTURED | SOFT_SEMITRANSP | SOFT_MASK_CHECK))) {
+        return false;
+    }
+    const u16 c = (u16)((p->rect.r >> 3) | ((p->rect.g >> 3) << 5) |
+                        ((p->rect.b >> 3) << 10) | p->mask_or);
+    for (int y = y0; y < y1; y++) {
+        u16* dst = &vram[y * VRAM_W];
+        for (int x = x0; x < x1; x++) {
+            dst[x] = c;
+        }
+    }
+    return true;
+}
+
+static void RasterizePrim(
+    const SoftPrim* p, int tx0, int ty0, int tx1, int ty1) {
+    const int x0 = SDL_max(p->x0, tx0);
+    const int y0 = SDL_max(p->y0, ty0);
+    const int x1 = SDL_min(p->x1, tx1);
+    const int y1 = SDL_min(p->y1, ty1);
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+    if (p->kind == SOFT_PRIM_RECT) {
+        if (!FillRectFast(p, x0, y0, x1, y1)) {
+            for (int y = y0; y < y1; y++) {
+                DrawSpan(p, y, x0, x1);
+            }
+        }
+        return;
+    }
+    for (int y = y0; y < y1; y++) {
+        Sint64 left = x0;
+        Sint64 right = x1 - 1;
+        for (int i = 0; i < 3; i++) {
+            const Sint64 ea = p->tri.ea[i];
+            const Sint64 e = p->tri.ec[i] + p->tri.eb[i] * y;
+            if (ea > 0) {
+                // e + ea * x >= 0  ->  x >= ceil(-e / ea)
+                left = SDL_max(left, -FloorDiv(e, ea));
+            } else if (ea < 0) {
+                // x <= floor(e / -ea)
+                right = SDL_min(right, FloorDiv(e, -ea));
+            } else if (e < 0) {
+                left = right + 1;
+            }
+        }
+        if (left <= right) {
+            DrawSpan(p, y, (int)left, (int)right + 1);
+        }
+    }
+}
+
+static void RasterizeTiles(void) {
+    int i;
+    while ((i = SDL_AddAtomicInt(&next_tile, 1)) < n_active_tiles) {
+        const int tile = active_tiles[i];
+        const int tx0 = (tile % SOFT_TILES_X) << SOFT_TILE_SHIFT;
+        const int ty0 = (tile / SOFT_TILES_X) << SOFT_TILE_SHIFT;
+        const SoftBin* bin = &bins[tile];
+        for (int j = 0; j < bin->len; j++) {
+            RasterizePrim(&prims[bin->idx[j]], tx0, ty0, tx0 + SOFT_TILE_SIZE,
+                     ty0 + SOFT_TILE_SIZE);
+        }
+    }
+}
+
+static int SDLCALL SoftWorker(void* userdata) {
+    unsigned seen = 0;
+    (void)userdata;
+    SDL_LockMutex(pool_lock);
+    for (;;) {
+        while (!pool_quit && pool_job == seen) {
+            SDL_WaitCondition(pool_start, pool_lock);
+        }
+        if (pool_quit) {
+            break;
+        }
+        seen = pool_job;
+        SDL_UnlockMutex(pool_lock);
+        RasterizeTiles();
+        SDL_LockMutex(pool_lock);
+        if (--pool_pending == 0) {
+            SDL_SignalCondition(pool_finish);
+        }
+    }
+    SDL_UnlockMutex(pool_lock);
+    return 0;
+}
+
+static void StartWorkers(void) {
+    int count = SDL_GetNumLogicalCPUCores() - 1;
+    count = CLAMP(count, 0, SOFT_MAX_WORKERS);
+    if (!count) {
+        return;
+    }
+    pool_lock = SDL_CreateMutex();
+    pool_start = SDL_CreateCondition();
+    pool_finish = SDL_CreateCondition();
+    if (!pool_lock || !pool_start || !pool_finish) {
+        WARNF("failed to create the worker pool: %s", SDL_GetError());
+        return;
+    }
+    pool_quit = false;
+    for (n_workers = 0; n_workers < count; n_workers++) {
+        SDL_Thread* t = SDL_CreateThread(SoftWorker, "psyz-soft", NULL);
+        if (!t) {
+            WARNF("SDL_CreateThread: %s", SDL_GetError());
+            break;
+        }
+        workers[n_workers] = t;
+    }
+    INFOF("software renderer with %d worker threads", n_workers);
+}
+
+static void StopWorkers(void) {
+    if (pool_lock) {
+        SDL_LockMutex(pool_lock);
+        pool_quit = true;
+        SDL_BroadcastCondition(pool_start);
+        SDL_UnlockMutex(pool_lock);
+    }
+    for (int i = 0; i < n_workers; i++) {
+        SDL_WaitThread(workers[i], NULL);
+        workers[i] = NULL;
+    }
+    n_workers = 0;
+    if (pool_finish) {
+        SDL_DestroyCondition(pool_finish);
+        pool_finish = NULL;
+    }
+    if (pool_start) {
+        SDL_DestroyCondition(pool_start);
+        pool_start = NULL;
+    }
+    if (pool_lock) {
+        SDL_DestroyMutex(pool_lock);
+        pool_lock = NULL;
+    }
+}
+
+static void RunTiles(void) {
+    SDL_SetAtomicInt(&next_tile, 0);
+    if (!n_workers || n_active_tiles < 2) {
+        RasterizeTiles();
+        return;
+    }
+    SDL_LockMutex(pool_lock);
+    pool_job++;
+    pool_pending = n_workers;
+    SDL_BroadcastCondition(pool_start);
+    SDL_UnlockMutex(pool_lock);
+    RasterizeTiles();
+    SDL_LockMutex(pool_lock);
+    while (pool_pending) {
+        SDL_WaitCondition(pool_finish, pool_lock);
+    }
+    SDL_UnlockMutex(pool_lock);
+}
+
+bool InitPlatform() {
+    if (is_platform_initialized) {
+        return is_platform_init_successful;
+    }
+    is_platform_initialized = true; // don't re-initialize on failures
+
+    if (!SDL_Init(SDL_INIT_EVENTS)) {
+        ERRORF("SDL_Init: %s", SDL_GetError());
+        return false;
+    }
+    StartWorkers();
+
+    cur_tpage = 0;
+    Sdl3Common_TimingInit();
+
+    is_platform_init_successful = true;
+    return true;
+}
+
+static void PlatformBackend_SetDriverVsync(bool enable) {
+    // there is no display to synchronize to: when the common code picks the
+    // driver VSync, frames are simply produced as fast as possible
+    (void)enable;
+}
+
+// VRAM is in system memory already, the copy goes straight to the capture
+static void CaptureFrame(void) {
+    const int w = display_size.x;
+    const int h = display_size.y;
+    u16* dst = Capture_Begin(
+        w, h, CAPTURE_SOURCE_RGB5551, gpu_stats.total_frames);
+    if (!dst) {
+        return;
+    }
+    for (int j = 0; j < h; j++) {
+        const u16* row = &vram[((display_area.y + j) & (VRAM_H - 1)) * VRAM_W];
+        for (int i = 0; i < w; i++) {
+            *dst++ = row[(display_area.x + i) & (VRAM_W - 1)];
+        }
+    }
+    Capture_Commit(dst - w * h);
+}
+
+static void PlatformBackend_Present(void) {
+    if (!is_platform_init_successful && !InitPlatform()) {
+        return;
+    }
+    Draw_FlushBuffer();
+    if (Capture_IsActive()) {
+        CaptureFrame();
+    }
+    if (overlay_frame_cb) {
+        overlay_frame_cb();
+    }
+    finish_time = SDL_GetPerformanceCounter();
+}
+
+static void PlatformBackend_SkipPresent(void) {
+    if (!is_platform_init_successful && !InitPlatform()) {
+        return;
+    }
+    Draw_FlushBuffer();
+    finish_time = SDL_GetPerformanceCounter();
+}
+
+static void QuitPlatform(void) {
+    Sdl3Common_Shutdown();
+    if (overlay_destroy_cb) {
+        overlay_destroy_cb();
+    }
+    StopWorkers();
+    free(prims);
+    prims = NULL;
+    n_prims = cap_prims = 0;
+    for (int i = 0; i < SOFT_TILE_COUNT; i++) {
+        free(bins[i].idx);
+        bins[i] = (SoftBin){0};
+    }
+    n_active_tiles = 0;
+    SDL_Quit();
+    is_platform_initialized = false;
+    is_platform_init_successful = false;
+}
+
+void ResetPlatform(void) {
+    cur_tpage = 0;
+    internal_res = 1;
+    QuitPlatform();
+}
+
+static unsigned char* AllocRgb888Region(int x, int y, int w, int h) {
+    Psyz_GpuDrawDeferred(x, y, w, h);
+    unsigned char* pixels = malloc((size_t)w * h * 3);
+    if (!pixels) {
+        return NULL;
+    }
+    Draw_ThreadSync();
+    Draw_FlushBuffer();
+    unsigned char* dst = pixels;
+    for (int j = 0; j < h; j++) {
+        const u16* row = &vram[((y + j) & (VRAM_H - 1)) * VRAM_W];
+        for (int i = 0; i < w; i++) {
+            u16 c = row[(x + i) & (VRAM_W - 1)];
+            dst[0] = color_5to8(c & 0x1F);
+            dst[1] = color_5to8((c >> 5) & 0x1F);
+            dst[2] = color_5to8((c >> 10) & 0x1F);
+            dst += 3;
+        }
+    }
+    return pixels;
+}
+
+unsigned char* Psyz_VideoAllocCapturedFrame(int* w, int* h) {
+    *w = display_size.x;
+    *h = display_size.y;
+    return AllocRgb888Region(display_area.x, display_area.y, *w, *h);
+}
+
+unsigned char* Psyz_VideoAllocVramDump(int* w, int* h) {
+    *w = VRAM_W;
+    *h = VRAM_H;
+    return AllocRgb888Region(0, 0, VRAM_W, VRAM_H);
+}
+
+static void UpdateScissor() {
+    int width = draw_area_end.x - draw_area_start.x + 1;
+    int height = draw_area_end.y - draw_area_start.y + 1;
+    if (width <= 0 || height <= 0) {
+        // Draw_SetAreaStart gets called before Draw_SetAreaEnd, it happens
+        // that either width or height are zero. Just ignore the call.
+        return;
+    }
+    scissor_rect.x = draw_area_start.x;
+    scissor_rect.y = draw_area_start.y;
+    scissor_rect.w = width;
+    scissor_rect.h = height;
+}
+
+// the software renderer always rasterizes at the native resolution; the
+// multiplier is only recorded so the API behaves like the other backends
+unsigned Psyz_VideoGetInternalResolution(void) { return internal_res; }
+
+int Psyz_VideoSetInternalResolution(unsigned multiplier) {
+    if (multiplier < 1) {
+        return -1;
+    }
+    if (multiplier > PSYZ_INTERNAL_RES_MAX) {
+        WARNF("internal resolution %dx exceeds maximum value of %dx",
+              multiplier, PSYZ_INTERNAL_RES_MAX);
+        return -1;
+    }
+    internal_res = multiplier;
+    auto_res_max = 0;
+    return 0;
+}
+
+static void ApplyDisplayPendingChanges() {
+    if (!is_platform_init_successful && !InitPlatform()) {
+        return;
+    }
+    cur_display_size = display_size;
+    cur_disp_horiz = set_disp_horiz;
+    cur_disp_vert = set_disp_vert;
+}
+
+void Draw_Reset() { NOT_IMPLEMENTED; }
+
+void Draw_DisplayEnable(unsigned int on) {
+    disp_on = on;
+    if (!on) {
+        Draw_FlushBuffer();
+        memset(vram, 0, sizeof(vram));
+    } else {
+        ApplyDisplayPendingChanges();
+    }
+}
+
+void Draw_DisplayArea(unsigned int x, unsigned int y) {
+    display_area.x = (int)x;
+    display_area.y = (int)y;
+    ApplyDisplayPendingChanges();
+}
+
+void Draw_DisplayHorizontalRange(unsigned int start, unsigned int end) {
+    set_disp_horiz = (int)(end - start) / 10;
+    ApplyDisplayPendingChanges();
+}
+
+void Draw_DisplayVerticalRange(unsigned int start, int unsigned end) {
+    set_disp_vert = (int)(end - start);
+    ApplyDisplayPendingChanges();
+}
+
+void Draw_SetDisplayMode(DisplayMode* mode) {
+    // TODO the interlace flag is ignored
+    // TODO rgb24 is ignored, the color output will always max the color space
+    if (mode->reversed) {
+        WARNF("reverse mode not supported");
+    }
+    is_pal = mode->pal;
+    if (mode->horizontal_resolution_368) {
+        display_size.x = 368;
+    } else {
+        switch (mode->horizontal_resolution) {
+        case 0:
+            display_size.x = 256;
+            break;
+        case 1:
+            display_size.x = 320;
+            break;
+        case 2:
+            display_size.x = 512;
+            break;
+        case 3:
+            display_size.x = 640;
+            break;
+        default:
+            break;
+        }
+    }
+    display_size.y = mode->vertical_resolution ? 480 : 240;
+    ApplyDisplayPendingChanges();
+
+    double new_target_fps = mode->pal ? VSYNC_PAL : VSYNC_NTSC;
+    if (new_target_fps != target_frame_rate) {
+        UpdateTargetFramerate(new_target_fps);
+    }
+}
+
+int Draw_ExequeSync() { return 0; }
+
+static void GrowBin(SoftBin* bin) {
+    int cap = bin->cap ? bin->cap * 2 : 64;
+    u32* idx = realloc(bin->idx, sizeof(*idx) * cap);
+    if (!idx) {
+        ERRORF("failed to allocate %zu bytes", sizeof(*idx) * cap);
+        return;
+    }
+    bin->idx = idx;
+    bin->cap = cap;
+}
+
+static SoftPrim* AllocPrim(void) {
+    if (n_prims >= SOFT_MAX_PRIMS) {
+        Draw_FlushBufferFor(PSYZ_FLUSH_BUFFER_FULL);
+    }
+    if (n_prims >= cap_prims) {
+        int cap = cap_prims ? cap_prims * 2 : 256;
+        SoftPrim* p = realloc(prims, sizeof(*p) * cap);
+        if (!p) {
+            ERRORF("failed to allocate %zu bytes", sizeof(*p) * cap);
+            return NULL;
+        }
+        prims = p;
+        cap_prims = cap;
+    }
+    return &prims[n_prims];
+}
+
+static inline bool RectHit(const SDL_Rect* a, int x, int y, int w, int h) {
+    return a->w > 0 && a->h > 0 && x < a->x + a->w && a->x < x + w &&
+           y < a->y + a->h && a->y < y + h;
+}
+
+// Primitives that sample from a VRAM area written earlier in the same batch
+// must observe the result of those writes: draw what is queued first.
+// Returns where the pending primitive lives after the eventual flush.
+static SoftPrim* ResolveTextureHazard(SoftPrim* p, int umin, int umax,
+                                      int vmin, int vmax) {
+    static const int shift[] = {2, 1, 0};
+    if (!(p->flags & SOFT_TEXTURED) || !n_prims) {
+        return p;
+    }
+    if ((p->twin & 0xFFFF) != 0xFFFF) {
+        umin = vmin = 0;
+        umax = vmax = 255;
+    }
+    const int s = shift[p->tex_mode];
+    const int clut_w = p->tex_mode == 0 ? 16 : p->tex_mode == 1 ? 256 : 0;
+    const int x = p->page_x + (umin >> s);
+    const int w = (umax >> s) - (umin >> s) + 1;
+    const int y = p->page_y + vmin;
+    const int h = vmax - vmin + 1;
+    bool hit = RectHit(&batch_written, x, y, w, h);
+    // sampling across the VRAM edges wraps around
+    hit |= x + w > VRAM_W || y + h > VRAM_H;
+    if (clut_w) {
+        hit |= RectHit(&batch_written, p->clut_x, p->clut_y, clut_w, 1);
+    }
+    if (hit) {
+        Draw_FlushBufferFor(PSYZ_FLUSH_STATE);
+        prims[0] = *p;
+        p = &prims[0];
+    }
+    return p;
+}
+
+static void CommitPrim(SoftPrim* p) {
+    const int idx = n_prims++;
+    const int tx0 = p->x0 >> SOFT_TILE_SHIFT;
+    const int ty0 = p->y0 >> SOFT_TILE_SHIFT;
+    const int tx1 = (p->x1 - 1) >> SOFT_TILE_SHIFT;
+    const int ty1 = (p->y1 - 1) >> SOFT_TILE_SHIFT;
+    for (int ty = ty0; ty <= ty1; ty++) {
+        for (int tx = tx0; tx <= tx1; tx++) {
+            const int tile = ty * SOFT_TILES_X + tx;
+            SoftBin* bin = &bins[tile];
+            if (bin->len >= bin->cap) {
+                GrowBin(bin);
+                if (bin->len >= bin->cap) {
+                    continue;
+                }
+            }
+            if (!bin->len) {
+                active_tiles[n_active_tiles++] = (u16)tile;
+            }
+            bin->idx[bin->len++] = (u32)idx;
+        }
+    }
+
+    SDL_Rect r = {p->x0, p->y0, p->x1 - p->x0, p->y1 - p->y0};
+    if (batch_written.w <= 0 || batch_written.h <= 0) {
+        batch_written = r;
+    } else {
+        int x0 = SDL_min(batch_written.x, r.x);
+        int y0 = SDL_min(batch_written.y, r.y);
+        int x1 = SDL_max(batch_written.x + batch_written.w, r.x + r.w);
+        int y1 = SDL_max(batch_written.y + batch_written.h, r.y + r.h);
+        batch_written = (SDL_Rect){x0, y0, x1 - x0, y1 - y0};
+    }
+}
+
+// fills the state shared by every primitive kind, then clips the bounding
+// box against the drawing area; returns false when nothing is visible
+static bool SetupPrim(SoftPrim* p, u16 tpage, u16 clut, bool semitransp,
+                      int x0, int y0, int x1, int y1) {
+    p->flags = 0;
+    if (!(tpage & TPAGE_NOTEXTURE)) {
+        p->flags |= SOFT_TEXTURED;
+    }
+    if (semitransp) {
+        p->flags |= SOFT_SEMITRANSP;
+    }
+    if (tpage & TPAGE_DITHER) {
+        p->flags |= SOFT_DITHER;
+    }
+    if (mask_check) {
+        p->flags |= SOFT_MASK_CHECK;
+    }
+    p->mask_or = mask_set ? 0x8000 : 0;
+    p->abr = (tpage >> 5) & 3;
+    p->tex_mode = SDL_min((tpage >> 7) & 3, 2);
+    p->page_x = (tpage & 0xF) * 64;
+    p->page_y = ((tpage >> 4) & 1) * 256;
+    p->clut_x = (clut & 0x3F) * 16;
+    p->clut_y = (clut >> 6) & (VRAM_H - 1);
+    p->twin = cur_twin;
+    p->x0 = SDL_max(SDL_max(x0, scissor_rect.x), 0);
+    p->y0 = SDL_max(SDL_max(y0, scissor_rect.y), 0);
+    p->x1 = SDL_min(SDL_min(x1, scissor_rect.x + scissor_rect.w), VRAM_W);
+    p->y1 = SDL_min(SDL_min(y1, scissor_rect.y + scissor_rect.h), VRAM_H);
+    return p->x0 < p->x1 && p->y0 < p->y1;
+}
+
+static void SetupPlane(SoftPlane* pl, const Sint64* vx, const Sint64* vy,
+                       double f0, double f1, double f2, double area) {
+    // gradients per sub-pixel unit, scaled to one pixel
+    const double dx10 = (double)(vx[1] - vx[0]), dy10 = (double)(vy[1] - vy[0]);
+    const double dx20 = (double)(vx[2] - vx[0]), dy20 = (double)(vy[2] - vy[0]);
+    const double dfdx = ((f1 - f0) * dy20 - (f2 - f0) * dy10) / area;
+    const double dfdy = ((f2 - f0) * dx10 - (f1 - f0) * dx20) / area;
+    const double a = dfdx * SOFT_SUBPIXEL;
+    const double b = dfdy * SOFT_SUBPIXEL;
+    // value at the centre of pixel (0, 0)
+    const double c = f0 + dfdx * (SOFT_SUBPIXEL / 2 - (double)vx[0]) +
+                     dfdy * (SOFT_SUBPIXEL / 2 - (double)vy[0]);
+    pl->a = llround(a * (1 << SOFT_FRAC_BITS));
+    pl->b = llround(b * (1 << SOFT_FRAC_BITS));
+    pl->c = llround(c * (1 << SOFT_FRAC_BITS));
+}
+
+static Sint64 ToSubpixelX(int x) {
+    const float s = GetDrawGridXScale();
+    if (s == 1.0f) {
+        return (Sint64)(x + draw_offset.x) * SOFT_SUBPIXEL;
+    }
+    return llround(((double)draw_offset.x + (double)x * s) * SOFT_SUBPIXEL);
+}
+
+static Sint64 ToSubpixelY(int y) {
+    return (Sint64)(y + draw_offset.y) * SOFT_SUBPIXEL;
+}
+
+static void PushTriangle(const Vertex* v0, const Vertex* v1, const Vertex* v2,
+                         u16 tpage, u16 clut, bool semitransp) {
+    const Vertex* v[3] = {v0, v1, v2};
+    Sint64 vx[3], vy[3];
+    for (int i = 0; i < 3; i++) {
+        vx[i] = ToSubpixelX(v[i]->x);
+        vy[i] = ToSubpixelY(v[i]->y);
+    }
+    Sint64 area = (vx[1] - vx[0]) * (vy[2] - vy[0]) -
+               (vy[1] - vy[0]) * (vx[2] - vx[0]);
+    if (area == 0) {
+        return;
+    }
+    if (area < 0) {
+        const Vertex* t = v[1];
+        v[1] = v[2];
+        v[2] = t;
+        Sint64 tx = vx[1], ty = vy[1];
+        vx[1] = vx[2];
+        vy[1] = vy[2];
+        vx[2] = tx;
+        vy[2] = ty;
+        area = -area;
+    }
+
+    const Sint64 min_x = SDL_min(SDL_min(vx[0], vx[1]), vx[2]);
+    const Sint64 min_y = SDL_min(SDL_min(vy[0], vy[1]), vy[2]);
+    const Sint64 max_x = SDL_max(SDL_max(vx[0], vx[1]), vx[2]);
+    const Sint64 max_y = SDL_max(SDL_max(vy[0], vy[1]), vy[2]);
+    SoftPrim* p = AllocPrim();
+    if (!p) {
+        return;
+    }
+    p->kind = SOFT_PRIM_TRI;
+    const int x0 = (int)CLAMP(FloorDiv(min_x, SOFT_SUBPIXEL), -1, VRAM_W);
+    const int y0 = (int)CLAMP(FloorDiv(min_y, SOFT_SUBPIXEL), -1, VRAM_H);
+    const int x1 = (int)CLAMP(FloorDiv(max_x, SOFT_SUBPIXEL) + 1, -1, VRAM_W);
+    const int y1 = (int)CLAMP(FloorDiv(max_y, SOFT_SUBPIXEL) + 1, -1, VRAM_H);
+    if (!SetupPrim(p, tpage, clut, semitransp, x0, y0, x1, y1)) {
+        return;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        const int j = (i + 1) % 3;
+        const Sint64 dx = vx[j] - vx[i];
+        const Sint64 dy = vy[j] - vy[i];
+        // E(px, py) on the pixel centre (px + 0.5, py + 0.5)
+        const Sint64 a = -dy;
+        const Sint64 b = dx;
+        const Sint64 c = dy * vx[i] - dx * vy[i];
+        p->tri.ea[i] = a * SOFT_SUBPIXEL;
+        p->tri.eb[i] = b * SOFT_SUBPIXEL;
+        p->tri.ec[i] = c + (a + b) * (SOFT_SUBPIXEL / 2);
+        // top-left fill rule: centres lying exactly on a bottom or right
+        // edge belong to the neighbouring primitive
+        bool top_left = dy < 0 || (dy == 0 && dx > 0);
+        if (!top_left) {
+            p->tri.ec[i]--;
+        }
+    }
+
+    const double fa = (double)area;
+    SetupPlane(&p->tri.r, vx, vy, v[0]->r, v[1]->r, v[2]->r, fa);
+    SetupPlane(&p->tri.g, vx, vy, v[0]->g, v[1]->g, v[2]->g, fa);
+    SetupPlane(&p->tri.b, vx, vy, v[0]->b, v[1]->b, v[2]->b, fa);
+    if (p->flags & SOFT_TEXTURED) {
+        SetupPlane(&p->tri.u, vx, vy, v[0]->u, v[1]->u, v[2]->u, fa);
+        SetupPlane(&p->tri.v, vx, vy, v[0]->v, v[1]->v, v[2]->v, fa);
+        // sample the texel at the left/top edge of the pixel, matching the
+        // texel resolution of the GPU backends
+        const double half = 0.5 * (1 << SOFT_FRAC_BITS);
+        const double bias = (double)(1 << SOFT_FRAC_BITS) / 512.0;
+        p->tri.u.c -= llround(half * fabs((double)p->tri.u.a /
+                                          (1 << SOFT_FRAC_BITS)) -
+                              bias);
+        p->tri.v.c -= llround(half * fabs((double)p->tri.v.b /
+                                          (1 << SOFT_FRAC_BITS)) -
+                              bias);
+        int umin = SDL_min(SDL_min(v[0]->u, v[1]->u), v[2]->u);
+        int umax = SDL_max(SDL_max(v[0]->u, v[1]->u), v[2]->u);
+        int vmin = SDL_min(SDL_min(v[0]->v, v[1]->v), v[2]->v);
+        int vmax = SDL_max(SDL_max(v[0]->v, v[1]->v), v[2]->v);
+        p = ResolveTextureHazard(p, CLAMP(umin, 0, 255), CLAMP(umax, 0, 255),
+                                 CLAMP(vmin, 0, 255), CLAMP(vmax, 0, 255));
+    } else {
+        p->tri.u = p->tri.v = (SoftPlane){0};
+    }
+    CommitPrim(p);
+}
+
+static void PushRect(int x, int y, int w, int h, const Vertex* v, u16 tpage,
+                     u16 clut, bool semitransp) {
+    SoftPrim* p = AllocPrim();
+    if (!p) {
+        return;
+    }
+    x += draw_offset.x;
+    y += draw_offset.y;
+    p->kind = SOFT_PRIM_RECT;
+    if (!SetupPrim(p, tpage, clut, semitransp, x, y, x + w, y + h)) {
+        return;
+    }
+    p->rect.x = x;
+    p->rect.y = y;
+    p->rect.u = (u8)v->u;
+    p->rect.v = (u8)v->v;
+    p->rect.r = v->r;
+    p->rect.g = v->g;
+    p->rect.b = v->b;
+    if (p->flags & SOFT_TEXTURED) {
+        p = ResolveTextureHazard(p, v->u, SDL_min(v->u + w - 1, 255), v->v,
+                                 SDL_min(v->v + h - 1, 255));
+    }
+    CommitPrim(p);
+}
+
+int Draw_PushPrim(u32* packets, int max_len) {
+    CountPrim(*packets);
+    int len = max_len;
+    int code = (int)(*packets >> 24) & 0xFF;
+    u8 kind = gp0_desc[code].kind;
+    bool isPoly = kind == GP0_KIND_POLY;
+    bool isLine = kind == GP0_KIND_LINE;
+    bool isTile = kind == GP0_KIND_RECT;
+    bool isTextured = (code & TEXTURED) != 0;
+    bool isGouraud = (code & GOURAUD) != 0;
+    bool isShadeTex = !((code & 1) && isTextured && !isLine);
+    bool isSemiTrans = (code & SEMITRANSP) != 0;
+    u16 tpage = -1, clut = -1, pad2, pad3;
+    // one extra slot: gouraud polygons peek the color of the next vertex
+    Vertex q[5] = {0};
+    Vertex* v = q;
+
+    if (isShadeTex) {
+        v->r = (unsigned char)(*packets >> 0);
+        v->g = (unsigned char)(*packets >> 8);
+        v->b = (unsigned char)(*packets >> 16);
+    } else {
+        v->r = v->g = v->b = 0x80;
+    }
+    packets++;
+    len--;
+    if (isPoly) {
+        if (code & TRIANGLE) {
+            int wr;
+            wr = writePacket(v++, code, len, packets, &clut);
+            packets += wr;
+            len -= wr;
+            wr = writePacket(v++, code, len, packets, &tpage);
+            packets += wr;
+            len -= wr;
+            wr = writePacket(v++, code, len, packets, &pad2);
+            packets += wr;
+            len -= wr;
+            if (code & EXTRA_VERTEX) {
+                wr = writePacket(v, code, len, packets, &pad3);
+                packets += wr;
+                len -= wr;
+            }
+            // HACK last rgb are not read by writePacket, so we patch the amount
+            if (isGouraud) {
+                packets--;
+                len++;
+            }
+
+            if (isTextured) {
+                FixupFlipUV(q, code & EXTRA_VERTEX);
+            } else {
+                clut = -1;
+                tpage = cur_tpage | TPAGE_NOTEXTURE;
+            }
+            if (CanPolyDither(isGouraud, isTextured, isShadeTex)) {
+                tpage |= TPAGE_DITHER;
+            }
+            if (!isGouraud || !isShadeTex) {
+                VRGBA(q[1]) = VRGBA(q[2]) = VRGBA(q[3]) = VRGBA(q[0]);
+            }
+            PushTriangle(&q[0], &q[1], &q[2], tpage, clut, isSemiTrans);
+            if (code & EXTRA_VERTEX) {
+                PushTriangle(&q[1], &q[3], &q[2], tpage, clut, isSemiTrans);
+            }
+        } else {
+            // shouldn't happen on a normal PSX application
+            WARNF("code %02X not supported", code);
+        }
+    } else if (isLine) {
+        bool padding = true;
+        int nPoints = ((code >> 2) & 3) + 1;
+        if (nPoints == 1) {
+            padding = false;
+            nPoints++; // don't ask, have faith
+        }
+
+        // accumulate line points first, then convert them to triangles
+        short px[4], py[4];
+        unsigned char cr[4], cg[4], cb[4];
+        int parsed = 0;
+        cr[0] = v->r;
+        cg[0] = v->g;
+        cb[0] = v->b;
+        for (int i = 0; len > 0 && i < nPoints; i++) {
+            px[i] = s11(((short*)packets)[0]);
+            py[i] = s11(((short*)packets)[1]);
+            packets++;
+            len--;
+            parsed = i + 1;
+            if (len > 0 && i + 1 < nPoints && isGouraud) {
+                cr[i + 1] = ((u8*)packets)[0];
+                cg[i + 1] = ((u8*)packets)[1];
+                cb[i + 1] = ((u8*)packets)[2];
+                packets++;
+                len--;
+            }
+        }
+        if (!isGouraud) {
+            for (int i = 1; i < parsed; i++) {
+                cr[i] = cr[0];
+                cg[i] = cg[0];
+                cb[i] = cb[0];
+            }
+        }
+        if (padding) {
+            len--;
+        }
+
+        u16 lt = cur_tpage | TPAGE_NOTEXTURE;
+        if (CanLineDither()) {
+            lt |= TPAGE_DITHER;
+        }
+        for (int s = 0; s + 1 < parsed; s++) {
+            short x0 = px[s];
+            short y0 = py[s];
+            short x1 = px[s + 1];
+            short y1 = py[s + 1];
+            int dx = x1 - x0;
+            int dy = y1 - y0;
+
+            // same thickening as the GPU backends, so every backend agrees
+            short ox, oy, ex, ey;
+            if ((dx < 0 ? -dx : dx) >= (dy < 0 ? -dy : dy)) {
+                ox = 0;
+                oy = 1;
+                ex = dx >= 0 ? 1 : -1;
+                ey = 0;
+            } else {
+                ox = 1;
+                oy = 0;
+                ex = 0;
+                ey = dy >= 0 ? 1 : -1;
+            }
+
+            Vertex l[4] = {0};
+            l[0].x = x0;
+            l[0].y = y0;
+            l[1].x = (short)(x1 + ex);
+            l[1].y = (short)(y1 + ey);
+            l[2].x = (short)(x1 + ex + ox);
+            l[2].y = (short)(y1 + ey + oy);
+            l[3].x = (short)(x0 + ox);
+            l[3].y = (short)(y0 + oy);
+            l[0].r = l[3].r = cr[s];
+            l[0].g = l[3].g = cg[s];
+            l[0].b = l[3].b = cb[s];
+            l[1].r = l[2].r = cr[s + 1];
+            l[1].g = l[2].g = cg[s + 1];
+            l[1].b = l[2].b = cb[s + 1];
+            PushTriangle(&l[0], &l[1], &l[2], lt, -1, isSemiTrans);
+            PushTriangle(&l[0], &l[2], &l[3], lt, -1, isSemiTrans);
+        }
+    } else if (isTile) {
+        int x, y, w = 0, h = 0;
+        x = s11(((short*)packets)[0]);
+        y = s11(((short*)packets)[1]);
+        packets++;
+        len--;
+        if (isTextured) {
+            v->u = ((u8*)packets)[0];
+            v->v = ((u8*)packets)[1];
+            clut = ((s16*)packets)[1];
+            tpage = cur_tpage;
+            packets++;
+            len--;
+        } else {
+            clut = -1;
+            tpage = cur_tpage | TPAGE_NOTEXTURE;
+        }
+        switch (code & ~3) {
+        case 0x60: // TILE
+        case 0x64: // SPRT
+            w = ((s16*)packets)[0];
+            h = ((s16*)packets)[1];
+            packets++;
+            len--;
+            break;
+        case 0x68: // TILE_1
+        case 0x6C:
+            w = 1;
+            h = 1;
+            break;
+        case 0x70: // TILE_8
+        case 0x74: // SPRT_8
+            w = 8;
+            h = 8;
+            break;
+        case 0x78: // TILE_16
+        case 0x7C: // SPRT_16
+            w = 16;
+            h = 16;
+            break;
+        default:
+            // TODO warn about unrecognized code
+            break;
+        }
+        if (w > 0 && h > 0 && GetDrawGridXScale() == 1.0f) {
+            PushRect(x, y, w, h, v, tpage, clut, isSemiTrans);
+        } else {
+            // the scaled grid and the mirrored sizes go through the same
+            // two triangles the GPU backends draw
+            q[1] = q[2] = q[3] = q[0];
+            q[0].x = (short)x;
+            q[0].y = (short)y;
+            q[1].x = (short)(x + w);
+            q[1].y = (short)y;
+            q[2].x = (short)x;
+            q[2].y = (short)(y + h);
+            q[3].x = (short)(x + w);
+            q[3].y = (short)(y + h);
+            q[1].u = q[3].u = q[0].u + w;
+            q[2].v = q[3].v = q[0].v + h;
+            PushTriangle(&q[0], &q[1], &q[2], tpage, clut, isSemiTrans);
+            PushTriangle(&q[1], &q[3], &q[2], tpage, clut, isSemiTrans);
+        }
+    }
+    return max_len - len;
+}
+
+void Draw_SetAreaStart(int x, int y) {
+    draw_area_start.x = x;
+    draw_area_start.y = y;
+}
+void Draw_SetAreaEnd(int x, int y) {
+    draw_area_end.x = x;
+    draw_area_end.y = y;
+    UpdateScissor();
+}
+void Draw_SetOffset(int x, int y) {
+    x = x % VRAM_W;
+    y = y % VRAM_H;
+    if (x < 0) {
+        x += VRAM_W;
+    }
+    if (y < 0) {
+        y += VRAM_H;
+    }
+    draw_offset.x = x;
+    draw_offset.y = y;
+}
+
+void Draw_ClearImage(PS1_RECT* rect, u_char r, u_char g, u_char b) {
+    if (rect->w == 0 || rect->h == 0) {
+        return;
+    }
+    if (!is_platform_init_successful && !InitPlatform()) {
+        return;
+    }
+    Draw_FlushBuffer();
+    const int x0 = CLAMP(rect->x, 0, VRAM_W);
+    const int y0 = CLAMP(rect->y, 0, VRAM_H);
+    const int x1 = CLAMP(rect->x + rect->w, 0, VRAM_W);
+    const int y1 = CLAMP(rect->y + rect->h, 0, VRAM_H);
+    const u16 c = (u16)((r >> 3) | ((g >> 3) << 5) | ((b >> 3) << 10));
+    for (int y = y0; y < y1; y++) {
+        u16* dst = &vram[y * VRAM_W];
+        for (int x = x0; x < x1; x++) {
+            dst[x] = c;
+        }
+    }
+}
+
+void Draw_LoadImage(PS1_RECT* rect, u_long* p) {
+    if (rect->w == 0 || rect->h == 0) {
+        return;
+    }
+    if (!is_platform_init_successful && !InitPlatform()) {
+        return;
+    }
+    Draw_FlushBufferFor(PSYZ_FLUSH_LOAD_IMAGE);
+    const u16* src = (const u16*)p;
+    for (int j = 0; j < rect->h; j++) {
+        u16* dst = &vram[((rect->y + j) & (VRAM_H - 1)) * VRAM_W];
+        for (int i = 0; i < rect->w; i++) {
+            dst[(rect->x + i) & (VRAM_W - 1)] = *src++;
+        }
+    }
+}
+
+void Draw_StoreImage(PS1_RECT* rect, u_long* p) {
+    if (rect->w == 0 || rect->h == 0) {
+        return;
+    }
+    Draw_FlushBufferFor(PSYZ_FLUSH_STORE_IMAGE);
+    u16* dst = (u16*)p;
+    for (int j = 0; j < rect->h; j++) {
+        const u16* src = &vram[((rect->y + j) & (VRAM_H - 1)) * VRAM_W];
+        for (int i = 0; i < rect->w; i++) {
+            *dst++ = src[(rect->x + i) & (VRAM_W - 1)];
+        }
+    }
+}
+
+void Draw_MoveImage(PS1_RECT* rect, unsigned int x, unsigned int y) {
+    if (rect->x == x && rect->y == y) {
+        return;
+    }
+    Draw_FlushBufferFor(PSYZ_FLUSH_MOVE_IMAGE);
+
+    int src_x = CLAMP(rect->x, 0, VRAM_W - 1);
+    int src_y = CLAMP(rect->y, 0, VRAM_H - 1);
+    int src_w = CLAMP(rect->w, 0, VRAM_W - src_x);
+    int src_h = CLAMP(rect->h, 0, VRAM_H - src_y);
+    int dst_x = CLAMP((int)x, 0, VRAM_W - 1);
+    int dst_y = CLAMP((int)y, 0, VRAM_H - 1);
+    int copy_w = CLAMP(src_w, 0, VRAM_W - dst_x);
+    int copy_h = CLAMP(src_h, 0, VRAM_H - dst_y);
+
+    if (src_x != rect->x || src_y != rect->y || src_w != rect->w ||
+        src_h != rect->h || dst_x != (int)x || dst_y != (int)y ||
+        copy_w != src_w || copy_h != src_h) {
+        WARNF("params out of bounds: src=(%d,%d,%d,%d)->(%d,%d,%d,%d) "
+              "dst=(%d,%d)->(%d,%d)",
+              rect->x, rect->y, rect->w, rect->h, src_x, src_y, src_w, src_h,
+              (int)x, (int)y, dst_x, dst_y);
+    }
+
+    if (copy_w <= 0 || copy_h <= 0) {
+        WARNF("nothing to copy");
+        return;
+    }
+
+    // rows are copied top to bottom like the real hardware does, which is
+    // what move_image_overlap expects when the two areas overlap
+    for (int row = 0; row < copy_h; row++) {
+        memmove(&vram[(dst_y + row) * VRAM_W + dst_x],
+                &vram[(src_y + row) * VRAM_W + src_x],
+                sizeof(*vram) * copy_w);
+    }
+}
+
+void Draw_ResetBuffer(void) {
+    for (int i = 0; i < n_active_tiles; i++) {
+        bins[active_tiles[i]].len = 0;
+    }
+    n_active_tiles = 0;
+    n_prims = 0;
+    batch_written = (SDL_Rect){0, 0, 0, 0};
+}
+
+void Draw_FlushBuffer(void) {
+    PsyzFlushReason reason = TakeFlushReason();
+    if (n_prims == 0) {
+        return;
+    }
+    pipe_stats.flushes[reason]++;
+    RunTiles();
+    Draw_ResetBuffer();
+}
+
+void Draw_SetMask(int bit0, int bit1) {
+    mask_set = bit0 != 0;
+    mask_check = bit1 != 0;
+}
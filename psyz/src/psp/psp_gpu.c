@@ -61,6 +61,7 @@ static int dlist_idx;
 // ===== video presentation options =====
 static PsyzDitherMode dither_mode = PSYZ_DITHER_AUTO;
 static PsyzAspectMode aspect_mode = PSYZ_ASPECT_DISPLAY;
+static PsyzReadbackMode readback_mode = PSYZ_READBACK_DRAWSYNC;
 static PsyzVsyncMode vsync_mode = PSYZ_VSYNC_AUTO;
 static unsigned internal_res = 1;
 
@@ -959,6 +960,20 @@ int Psyz_VideoSetAspectMode(PsyzAspectMode mode) {
 
 PsyzAspectMode Psyz_VideoGetAspectMode(void) { return aspect_mode; }
 
+int Psyz_VideoSetReadbackMode(PsyzReadbackMode mode) {
+    switch (mode) {
+    case PSYZ_READBACK_SYNC:
+    case PSYZ_READBACK_DRAWSYNC:
+    case PSYZ_READBACK_NEXT_FRAME:
+        readback_mode = mode;
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+PsyzReadbackMode Psyz_VideoGetReadbackMode(void) { return readback_mode; }
+
 PsyzSize Psyz_VideoGetDisplaySize(void) {
     PsyzSize s = {PSP_SCREEN_W, PSP_SCREEN_H};
     if (aspect_mode == PSYZ_ASPECT_DISPLAY) {
@@ -983,6 +998,16 @@ int Psyz_VideoStats(PsyzVideoStats* stats) {
     stats->target_frame_time_us = 1000000.0 / 60.0;
     stats->total_frames = sceDisplayGetVcount();
     stats->using_driver_vsync = vsync_mode != PSYZ_VSYNC_LIMITLESS;
+    stats->internal_res = 1;
+    return 0;
+}
+
+int Psyz_VideoPipelineStats(PsyzVideoPipelineStats* stats) {
+    if (!stats || !is_init) {
+        return -1;
+    }
+    // primitives go straight to the GE, there are no batches to account for
+    memset(stats, 0, sizeof(*stats));
     return 0;
 }
 
@@ -1316,6 +1341,8 @@ void Draw_LoadImage(RECT* rect, u_long* p) {
     if (!is_init && !InitPlatform()) {
         return;
     }
+    // the source may be the destination of a StoreImage still in flight
+    Draw_ExequeSync();
     ClampRect(rect, &x, &y, &w, &h);
     const u16* src = (const u16*)p;
     int pad_stride = (rect->w + 7) & ~7;
@@ -1360,6 +1387,9 @@ void Draw_StoreImage(RECT* rect, u_long* p) {
         StoreImageGe(x, y, w, h, dst, rect->w);
         KickGe();
         store_readback_pending = true;
+        if (readback_mode == PSYZ_READBACK_SYNC) {
+            GeSyncCaughtUp();
+        }
     } else if (((uintptr_t)dst & 0xF) == 0 && h <= XFER_ROWS &&
                pad_stride <= XFER_STRIDE) {
         // width is unaligned, do a mix between CPU copy and DMA copy
@@ -2086,7 +2116,7 @@ static void EmitClearQuad(int x, int y, int w, int h, u8 r, u8 g, u8 b) {
 // real hardware uses XY coords as signed 11-bit
 static short s11(short v) { return (short)(((v & 0x7FF) ^ 1024) - 1024); }
 
-static int writePacket(PVert* v, int code, int n, u_long* packet, u16* pOut) {
+static int writePacket(PVert* v, int code, int n, u32* packet, u16* pOut) {
     int w;
     if (!n) {
         return 0;
@@ -2148,7 +2178,7 @@ static void FixupFlipUV(PVert* v, int hasFourVertices) {
 }
 
 static inline int PushTileWithFixedSize(
-    u_long* packets, int max_len, int code, int size, bool textured) {
+    u32* packets, int max_len, int code, int size, bool textured) {
     int len = max_len;
     bool isSemiTrans = (code & SEMITRANSP) != 0;
     bool isShadeTex = !((code & 1) && textured);
@@ -2185,27 +2215,27 @@ static inline int PushTileWithFixedSize(
 }
 
 // creates six variants of PushTileWithFixedSize without using ugly macros
-__attribute__((noinline)) static int PushTile1(u_long* p, int len, int code) {
+__attribute__((noinline)) static int PushTile1(u32* p, int len, int code) {
     return PushTileWithFixedSize(p, len, code, 1, false);
 }
-__attribute__((noinline)) static int PushSprt1(u_long* p, int len, int code) {
+__attribute__((noinline)) static int PushSprt1(u32* p, int len, int code) {
     return PushTileWithFixedSize(p, len, code, 1, true);
 }
-__attribute__((noinline)) static int PushTile8(u_long* p, int len, int code) {
+__attribute__((noinline)) static int PushTile8(u32* p, int len, int code) {
     return PushTileWithFixedSize(p, len, code, 8, false);
 }
-__attribute__((noinline)) static int PushSprt8(u_long* p, int len, int code) {
+__attribute__((noinline)) static int PushSprt8(u32* p, int len, int code) {
     return PushTileWithFixedSize(p, len, code, 8, true);
 }
-__attribute__((noinline)) static int PushTile16(u_long* p, int len, int code) {
+__attribute__((noinline)) static int PushTile16(u32* p, int len, int code) {
     return PushTileWithFixedSize(p, len, code, 16, false);
 }
-__attribute__((noinline)) static int PushSprt16(u_long* p, int len, int code) {
+__attribute__((noinline)) static int PushSprt16(u32* p, int len, int code) {
     return PushTileWithFixedSize(p, len, code, 16, true);
 }
 
 __attribute__((noinline)) static int PushTile(
-    u_long* packets, int max_len, int code) {
+    u32* packets, int max_len, int code) {
     int len = max_len;
     bool isTextured = (code & TEXTURED) != 0;
     bool isSemiTrans = (code & SEMITRANSP) != 0;
@@ -2249,7 +2279,7 @@ __attribute__((noinline)) static int PushTile(
 
 // LINE_* emits one native GE line per segment
 __attribute__((noinline)) static int PushLine(
-    u_long* packets, int max_len, int code) {
+    u32* packets, int max_len, int code) {
     int len = max_len;
     bool isGouraud = (code & GOURAUD) != 0;
     bool isSemiTrans = (code & SEMITRANSP) != 0;
@@ -2302,7 +2332,7 @@ __attribute__((noinline)) static int PushLine(
 }
 
 __attribute__((noinline)) static int PushPolyGeneric(
-    u_long* packets, int max_len, int code) {
+    u32* packets, int max_len, int code) {
     int len = max_len;
     bool isTextured = (code & TEXTURED) != 0;
     bool isGouraud = (code & GOURAUD) != 0;
@@ -2376,8 +2406,8 @@ typedef struct {
 } PolyVerts;
 
 // parse one vertex of a well-formed POLY_* packet; returns the next word
-static inline u_long* ReadPolyVert(
-    PolyVerts* p, int i, u_long* w, bool textured, bool gouraud) {
+static inline u32* ReadPolyVert(
+    PolyVerts* p, int i, u32* w, bool textured, bool gouraud) {
     if (gouraud && i > 0) {
         p->c[i] = (unsigned int)*w++;
     }
@@ -2426,7 +2456,7 @@ static inline void WritePolyVert(
 }
 
 static inline int PushPolyFast(
-    u_long* packets, int max_len, int code, bool textured, bool gouraud) {
+    u32* packets, int max_len, int code, bool textured, bool gouraud) {
     bool quad = (code & EXTRA_VERTEX) != 0;
     int need = (quad ? 4 : 3) * (1 + textured + gouraud) + 1 - gouraud;
     if (max_len < need) {
@@ -2442,7 +2472,7 @@ static inline int PushPolyFast(
 
     PolyVerts pv;
     pv.c[0] = (unsigned int)packets[0];
-    u_long* w = packets + 1;
+    u32* w = packets + 1;
     w = ReadPolyVert(&pv, 0, w, textured, gouraud);
     w = ReadPolyVert(&pv, 1, w, textured, gouraud);
     w = ReadPolyVert(&pv, 2, w, textured, gouraud);
@@ -2506,20 +2536,20 @@ static inline int PushPolyFast(
 }
 
 // don't inline these four functions, but hint to inline PushPolyFast in them
-__attribute__((noinline)) static int PushPolyF(u_long* p, int len, int code) {
+__attribute__((noinline)) static int PushPolyF(u32* p, int len, int code) {
     return PushPolyFast(p, len, code, false, false);
 }
-__attribute__((noinline)) static int PushPolyFT(u_long* p, int len, int code) {
+__attribute__((noinline)) static int PushPolyFT(u32* p, int len, int code) {
     return PushPolyFast(p, len, code, true, false);
 }
-__attribute__((noinline)) static int PushPolyG(u_long* p, int len, int code) {
+__attribute__((noinline)) static int PushPolyG(u32* p, int len, int code) {
     return PushPolyFast(p, len, code, false, true);
 }
-__attribute__((noinline)) static int PushPolyGT(u_long* p, int len, int code) {
+__attribute__((noinline)) static int PushPolyGT(u32* p, int len, int code) {
     return PushPolyFast(p, len, code, true, true);
 }
 
-int Draw_PushPrim(u_long* packets, int max_len) {
+int Draw_PushPrim(u32* packets, int max_len) {
     int code = (int)(*packets >> 24) & 0xFF;
     if (!is_init && !InitPlatform()) {
         return max_len;
@@ -2574,6 +2604,8 @@ void Draw_FlushBuffer(void) {
     // geometry commands are emitted to the engine immediately
 }
 
+void Draw_SetFlushReason(int reason) { (void)reason; }
+
 int Draw_ExequeSync(void) {
     // wait for StoreImage/LoadImage DMA to finish
     if (store_readback_pending) {
@@ -2582,3 +2614,11 @@ int Draw_ExequeSync(void) {
     }
     return 0;
 }
+
+// the GE is already asynchronous, packets are always decoded by the caller
+int Draw_ThreadStart(void (*dispatch)(u32* words, int len)) { return -1; }
+void Draw_ThreadStop(void) {}
+void Draw_ThreadSubmit(const u32* words, int len) {}
+void Draw_ThreadFlush(void) {}
+void Draw_ThreadSync(void) {}
+int Draw_ThreadPending(void) { return 0; }
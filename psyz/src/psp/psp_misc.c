@@ -2,6 +2,7 @@
 #include <psyz.h>
 #include <psyz/log.h>
 #include <libgpu.h>
+#include <string.h>
 #include "../draw.h"
 
 void Psyz_SetTitle(const char* str) { (void)str; }
@@ -14,6 +15,48 @@ int Psyz_VideoSetInternalResolution(unsigned multiplier) {
 
 unsigned Psyz_VideoGetInternalResolution(void) { return 1; }
 
+int Psyz_VideoSetAutoInternalResolution(unsigned max_multiplier) {
+    return max_multiplier <= 1 ? 0 : -1;
+}
+
+unsigned Psyz_VideoGetAutoInternalResolution(void) { return 0; }
+
+int Psyz_VideoSetPresentQueue(unsigned depth) { return depth == 0 ? 0 : -1; }
+
+unsigned Psyz_VideoGetPresentQueue(void) { return 0; }
+
+int Psyz_VideoSetFrameSkip(PsyzFrameSkipMode mode) {
+    return mode == PSYZ_FRAMESKIP_OFF ? 0 : -1;
+}
+
+PsyzFrameSkipMode Psyz_VideoGetFrameSkip(void) { return PSYZ_FRAMESKIP_OFF; }
+
+int Psyz_VideoCaptureStart(
+    PsyzCaptureCallback callback, void* userdata, PsyzCaptureFormat format) {
+    (void)callback;
+    (void)userdata;
+    (void)format;
+    return -1;
+}
+
+void Psyz_VideoCaptureStop(void) {}
+
+int Psyz_VideoRecordStart(const char* path, PsyzRecordFormat format) {
+    (void)path;
+    (void)format;
+    return -1;
+}
+
+void Psyz_VideoRecordStop(void) {}
+
+int Psyz_VideoRecordStats(PsyzRecordStats* stats) {
+    if (!stats) {
+        return -1;
+    }
+    memset(stats, 0, sizeof(*stats));
+    return 0;
+}
+
 int Draw_SetHorizontalGrid(
     unsigned int source_width, unsigned int target_width) {
     if (source_width == 0 || target_width == 0) {
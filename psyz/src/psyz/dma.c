@@ -1,4 +1,5 @@
 #include <psyz.h>
+#include "../internal.h"
 
 static void DmaSpu(unsigned offset, u_long value) {
     static u_long _addr = 0;
@@ -35,6 +36,76 @@ static void DmaSpu(unsigned offset, u_long value) {
     }
 }
 
+// GP0 packets and VRAM transfers go straight to libgpu.c, so poking the DMA
+// registers is as fast as DrawOTag, LoadImage and StoreImage
+static void DmaGpu(unsigned offset, u_long value) {
+    static u_long _addr = 0;
+    static u_long _bcr = 0;
+    unsigned len;
+
+    switch (offset) {
+    case 0:
+        _addr = value;
+        break;
+    case 1:
+        _bcr = value;
+        break;
+    case 2: // chcr
+        if (!(value & 0x01000000)) {
+            break;
+        }
+        switch ((value >> 9) & 3) {
+        case 0: // VRAM transfers are either a single or multiple blocks
+        case 1:
+            // mode 0 only has a word count, where 0 means 0x10000
+            if ((value >> 9) & 3) {
+                len = (unsigned)((_bcr >> 0x10) * (_bcr & 0xFFFF));
+            } else {
+                len = (unsigned)(_bcr & 0xFFFF);
+                if (!len) {
+                    len = 0x10000;
+                }
+            }
+            if (!len) {
+                WARNF("GPU DMA block transfer of 0 words");
+                break;
+            }
+            Psyz_GpuDmaBlock((void*)_addr, (int)(value & 1));
+            break;
+        case 2:
+            Psyz_GpuDmaLinkedList((void*)_addr);
+            break;
+        default:
+            WARNF("SyncMode %d is invalid for GPU", (int)((value >> 9) & 3));
+            break;
+        }
+        break;
+    }
+}
+
+// _addr points to the last entry of the ordering table, as on real hardware
+static void DmaOtc(unsigned offset, u_long value) {
+    static u_long _addr = 0;
+    static unsigned _len = 0;
+
+    switch (offset) {
+    case 0:
+        _addr = value;
+        break;
+    case 1:
+        _len = (unsigned)(value & 0xFFFF);
+        if (!_len) {
+            _len = 0x10000;
+        }
+        break;
+    case 2: // chcr
+        if (value & 0x01000000) {
+            Psyz_GpuDmaClearOTag((void*)_addr, (int)_len);
+        }
+        break;
+    }
+}
+
 void Psyz_DmaWrite(PsyzDmaChannel ch, unsigned offset, u_long value) {
     if (offset > 2) {
         WARNF("offset %d invalid for DMA channel %d", offset, ch);
@@ -48,7 +119,7 @@ void Psyz_DmaWrite(PsyzDmaChannel ch, unsigned offset, u_long value) {
         LOG_ONCE("DMA_CHANNEL_MDEC_OUT not supported");
         break;
     case DMA_CHANNEL_GPU:
-        LOG_ONCE("DMA_CHANNEL_GPU not supported");
+        DmaGpu(offset, value);
         break;
     case DMA_CHANNEL_CD:
         LOG_ONCE("DMA_CHANNEL_CD not supported");
@@ -60,7 +131,7 @@ void Psyz_DmaWrite(PsyzDmaChannel ch, unsigned offset, u_long value) {
         LOG_ONCE("DMA_CHANNEL_PIO not supported");
         break;
     case DMA_CHANNEL_OTC:
-        LOG_ONCE("DMA_CHANNEL_OTC not supported");
+        DmaOtc(offset, value);
         break;
     default:
         WARNF("DMA channel %d is invalid", ch);
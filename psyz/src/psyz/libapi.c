@@ -62,6 +62,9 @@ int VSync(int mode) {
     if (mode == 1) {
         return elapsed;
     }
+    if (mode == 0) {
+        Psyz_GpuVSync();
+    }
     ReadPadsOnVsync(); // this is done on vsync by the BIOS
     if (g_PsyzVsyncCb) {
         g_PsyzVsyncCb();
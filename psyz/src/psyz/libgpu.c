@@ -1,17 +1,36 @@
 #include <psyz.h>
 #include <libgpu.h>
 #include <psyz/log.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include "../draw.h"
+#include "../gp0.h"
 #include "../internal.h"
+#include "../test_hooks.h"
 
 // The GPU is a FIFO: the register reflects what it has consumed by the GPU the
-// moment it's queried. The problem with the current PsyZ implementation is
-// the GPU emulation is synchronous. GPU packets are accumulated in GPU_Enqueue
-// then consumed by Psyz_GpuExeque on demand by the same thread. This means the
-// values of GPU_STATUS will be stale, especially when 0xE1xxxxxx gets enqueued
-// and then GPU_STATUS gets queried before Psyz_GpuExeque is called. But then
-// calling Psyz_GpuExeque implies synchronization, which slows down performance.
+// moment it's queried. By default the PsyZ GPU emulation is synchronous: GPU
+// packets are decoded in GPU_Enqueue then drawn by Psyz_GpuExeque on demand by
+// the same thread. With Psyz_GpuSetThreaded, packets are copied to a render
+// thread instead, so decoding overlaps with the game logic. Either way
+// GPU_STATUS is a shadow updated when packets are queued, never when they are
+// decoded, so it is never stale and querying it does not need a sync.
+// https://psx-spx.consoledev.net/graphicsprocessingunitgpu/#1f801814h-gpustat-gpu-status-register-r
 static u32 GPU_STATUS = 0;
+#define STATUS_TEXPAGE 0x7FF
+#define STATUS_POLY_TEXPAGE 0x1FF
+#define STATUS_MASK_BITS (3 << 11)
+#define STATUS_REVERSE (1 << 14)
+#define STATUS_DISPLAY_MODE (0x7F << 16)
+#define STATUS_DISPLAY_OFF (1 << 23)
+#define STATUS_READY_CMD (1 << 26)
+#define STATUS_READY_VRAM (1 << 27)
+#define STATUS_READY_DMA (1 << 28)
 
 typedef enum {
     // https://psx-spx.consoledev.net/graphicsprocessingunitgpu/#gpu-versions
@@ -45,12 +64,29 @@ u32 get_vram_wh(void);
 
 static void GPU_clear_cache() { NOT_IMPLEMENTED; }
 
-static void GPU_write_image() { NOT_IMPLEMENTED; }
+// VRAM area set by the last GP0 A0/C0, its pixels are then transferred by
+// the GPU DMA channel
+static RECT dma_rect;
+static bool dma_rect_set = false;
 
-static void GPU_read_image() { NOT_IMPLEMENTED; }
+// Raw words written through Psyz_GpuWriteGP0, ordering tables are walked in
+// place and never go through this queue. The queue is a chain of fixed-size
+// segments recycled through a pool, so it grows without ever moving words.
+// A packet never straddles two segments, so each one can be decoded in place.
+#define QUEUE_SEGMENT_LEN 0x1000
+typedef struct QueueSegment {
+    struct QueueSegment* next;
+    int len;
+    u32 words[QUEUE_SEGMENT_LEN];
+} QueueSegment;
 
-static int queue_len = 0;
-static u_long queue_buf[0x4000];
+static QueueSegment* queue_head = NULL;
+static QueueSegment* queue_tail = NULL;
+static QueueSegment* queue_pool = NULL;
+static int queue_len = 0;        // words queued across all segments
+static int queue_high_water = 0; // most words ever queued between two flushes
+static int queue_pkt_start = 0;  // where the last packet starts in queue_tail
+static int queue_pkt_left = 0;   // words still missing to the last packet
 
 typedef struct {
     PsyzGpuCommandHandler handler;
@@ -59,6 +95,72 @@ typedef struct {
 
 static UserGpuCommand user_gpu_commands[256];
 
+static bool gpu_threaded = false;
+static bool gpu_unflushed = false;
+
+// Trace written by Psyz_GpuCaptureStart: a header followed by records, each
+// one a word with the type in the top 8 bits and the payload length in words
+// in the low 24 bits. Everything is 32-bit aligned so traces can be replayed
+// straight from a memory mapped file.
+#define TRACE_MAGIC 0x475A5350 // "PSZG"
+#define TRACE_VERSION 1
+enum {
+    TRACE_GP0 = 1,     // packet words as submitted to the backend
+    TRACE_GP1,         // one display command
+    TRACE_LOAD_IMAGE,  // x|y<<16, w|h<<16, then the pixels
+    TRACE_STORE_IMAGE, // x|y<<16, w|h<<16
+    TRACE_FLUSH,       // Psyz_GpuExeque after new packets
+    TRACE_VSYNC,       // end of frame
+    TRACE_GRID,        // Psyz_GpuSetHorizontalGrid source and target widths
+};
+static FILE* capture_file = NULL;
+static bool capture_unflushed = false;
+
+static void CaptureRecord(
+    int type, const u32* head, int head_len, const void* data, size_t size) {
+    static const u8 pad[4] = {0};
+    size_t words = (size_t)head_len + (size + 3) / 4;
+    u32 header = ((u32)type << 24) | (u32)words;
+    if (words > 0xFFFFFF) {
+        ERRORF("record %d too large for the trace, 0x%X words", type,
+               (int)words);
+        return;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, capture_file) == 1;
+    if (head_len) {
+        ok &= fwrite(head, sizeof(*head), head_len, capture_file) ==
+              (size_t)head_len;
+    }
+    if (size) {
+        ok &= fwrite(data, 1, size, capture_file) == size;
+        ok &= fwrite(pad, 1, words * 4 - head_len * 4 - size, capture_file) ==
+              words * 4 - head_len * 4 - size;
+    }
+    if (!ok) {
+        ERRORF("failed to write the GPU trace, capture stopped");
+        Psyz_GpuCaptureStop();
+        return;
+    }
+    if (type == TRACE_GP0) {
+        capture_unflushed = true;
+    }
+}
+
+static void CaptureImage(int type, RECT* rect, const void* pixels) {
+    u32 head[2];
+    head[0] = (u16)rect->x | ((u32)(u16)rect->y << 16);
+    head[1] = (u16)rect->w | ((u32)(u16)rect->h << 16);
+    size_t size = type == TRACE_LOAD_IMAGE ? (size_t)rect->w * rect->h * 2 : 0;
+    CaptureRecord(type, head, LEN(head), pixels, size);
+}
+
+// waits for the render thread before touching the backend from the game thread
+static void GpuSync(void) {
+    if (gpu_threaded) {
+        Draw_ThreadSync();
+    }
+}
+
 int Psyz_GpuRegisterCommandHandler(
     unsigned int opcode, PsyzGpuCommandHandler handler, void* userdata) {
     if (opcode > 0xFF) {
@@ -71,15 +173,339 @@ int Psyz_GpuRegisterCommandHandler(
 
 int Psyz_GpuSetHorizontalGrid(
     unsigned int source_width, unsigned int target_width) {
+    GpuSync();
+    if (capture_file) {
+        u32 head[] = {source_width, target_width};
+        CaptureRecord(TRACE_GRID, head, LEN(head), NULL, 0);
+    }
     return Draw_SetHorizontalGrid(source_width, target_width);
 }
 
-static void DispatchPackets(u_long* buf, int len) {
+// handlers are part of the public API and receive u_long words, which on
+// 64-bit hosts means the words have to be widened first
+static int CallUserCommand(int code, u32* buf, int len) {
+    UserGpuCommand* cmd = &user_gpu_commands[code];
+    if (sizeof(u_long) == 4) {
+        return cmd->handler((const u_long*)buf, len, cmd->userdata);
+    }
+    u_long stack_words[0x100];
+    u_long* words = stack_words;
+    if (len > LEN(stack_words)) {
+        words = malloc(len * sizeof(u_long));
+        if (!words) {
+            ERRORF("out of memory widening %d words for command %02X", len,
+                   code);
+            return 0;
+        }
+    }
+    for (int i = 0; i < len; i++) {
+        words[i] = buf[i];
+    }
+    int consumed = cmd->handler(words, len, cmd->userdata);
+    if (words != stack_words) {
+        free(words);
+    }
+    return consumed;
+}
+
+// ===== deferred drawing =====
+// With PSYZ_FRAMESKIP_DRAW, a late frame records the primitives it draws
+// instead of rasterizing them, so that the VSync showing them can be
+// skipped. Fills and transfers still run right away. A recording holds what
+// was drawn into one drawing area, starting with the drawing state it was
+// made in. It is replayed in order before anything else reads or writes
+// VRAM under it, and dropped by a fill covering it.
+#define DEFER_AREAS 2 // double buffering
+#define DEFER_MAX_WORDS 0x40000
+#define DEFER_ENV_LEN 6 // E1h to E6h
+#define DEFER_AREA_KNOWN ((1 << (0xE3 - 0xE1)) | (1 << (0xE4 - 0xE1)))
+
+typedef struct {
+    RECT area;
+    u32* words; // drawing state, then the recorded packets
+    int len;
+    int cap;
+} DeferredArea;
+
+static DeferredArea defer_areas[DEFER_AREAS];
+static bool defer_draw = false;    // set by the platform on late frames
+static bool defer_pending = false; // any drawing area has a recording
+static int defer_depth = 0;        // replays in progress
+static int defer_target = -1; // records the primitives drawn, -1 for none
+static int defer_last = 0;    // recorded into last, the other one goes first
+static u32 defer_env[DEFER_ENV_LEN];
+static u8 defer_env_seen = 0;
+static bool defer_env_dirty = false; // not in the recording of the target
+static short disp_x = 0, disp_y = 0; // GP1 05h
+static u32 disp_mode = 0;            // GP1 08h
+static int disp_lines = 240;         // GP1 07h
+
+static void DispatchPackets(u32* buf, int len);
+
+static bool RectsOverlap(const RECT* a, const RECT* b) {
+    return a->x < b->x + b->w && b->x < a->x + a->w && a->y < b->y + b->h &&
+           b->y < a->y + a->h;
+}
+
+static bool RectInside(const RECT* outer, const RECT* inner) {
+    return inner->x >= outer->x && inner->y >= outer->y &&
+           inner->x + inner->w <= outer->x + outer->w &&
+           inner->y + inner->h <= outer->y + outer->h;
+}
+
+static void UpdateDeferPending(void) {
+    defer_pending = false;
+    for (int i = 0; i < DEFER_AREAS; i++) {
+        defer_pending |= defer_areas[i].len > 0;
+    }
+}
+
+// Rasterizes the recording, then restores the drawing state it left behind
+static void ReplayDeferred(DeferredArea* rec) {
+    if (!rec->len) {
+        return;
+    }
+    u32 env[DEFER_ENV_LEN];
+    int n_env = 0;
+    for (int i = 0; i < DEFER_ENV_LEN; i++) {
+        if (defer_env_seen & (1 << i)) {
+            env[n_env++] = defer_env[i];
+        }
+    }
+    const int len = rec->len;
+    const int target = defer_target;
+    rec->len = 0;
+    UpdateDeferPending();
+    defer_target = -1;
+    defer_depth++;
+    DispatchPackets(rec->words, len);
+    DispatchPackets(env, n_env);
+    defer_depth--;
+    defer_target = target;
+}
+
+// `except` keeps its recording, -1 for none
+static void ReplayOverlapping(const RECT* rect, int except) {
+    for (int i = 0; i < DEFER_AREAS; i++) {
+        if (i != except && defer_areas[i].len &&
+            RectsOverlap(rect, &defer_areas[i].area)) {
+            ReplayDeferred(&defer_areas[i]);
+        }
+    }
+}
+
+static void ReplayAll(void) {
+    for (int i = 0; i < DEFER_AREAS; i++) {
+        ReplayDeferred(&defer_areas[i]);
+    }
+}
+
+// Picks the recording the primitives go to when the drawing area or
+// defer_draw change, rather than on every primitive. The recordings the
+// drawing area reaches into are replayed first.
+static void UpdateDeferTarget(void) {
+    defer_target = -1;
+    if ((defer_env_seen & DEFER_AREA_KNOWN) != DEFER_AREA_KNOWN) {
+        ReplayAll(); // drawing may land anywhere
+        return;
+    }
+    const u32 start = defer_env[0xE3 - 0xE1];
+    const u32 end = defer_env[0xE4 - 0xE1];
+    RECT area = {(short)(start & 0x3FF), (short)((start >> 10) & 0x3FF)};
+    area.w = (short)((int)(end & 0x3FF) - area.x + 1);
+    area.h = (short)((int)((end >> 10) & 0x3FF) - area.y + 1);
+    if (area.w <= 0 || area.h <= 0) {
+        return; // nothing gets drawn
+    }
+    if (defer_draw) {
+        int i = 0;
+        while (i < DEFER_AREAS &&
+               memcmp(&defer_areas[i].area, &area, sizeof(area))) {
+            i++;
+        }
+        if (i == DEFER_AREAS) {
+            i = (defer_last + 1) % DEFER_AREAS;
+            ReplayDeferred(&defer_areas[i]);
+            defer_areas[i].area = area;
+        }
+        defer_target = defer_last = i;
+        defer_env_dirty = true;
+    }
+    ReplayOverlapping(&area, defer_target);
+}
+
+static bool RecordDeferred(DeferredArea* rec, const u32* words, int n) {
+    const int need = rec->len + DEFER_ENV_LEN + n;
+    if (need > rec->cap) {
+        int cap = rec->cap ? rec->cap : 0x1000;
+        while (cap < need) {
+            cap *= 2;
+        }
+        u32* grown = NULL;
+        if (cap <= DEFER_MAX_WORDS) {
+            grown = realloc(rec->words, cap * sizeof(u32));
+        }
+        if (!grown) {
+            // too much to hold back, the recording is drawn after all
+            ReplayDeferred(rec);
+            return false;
+        }
+        rec->words = grown;
+        rec->cap = cap;
+    }
+    if (!rec->len || defer_env_dirty) {
+        for (int i = 0; i < DEFER_ENV_LEN; i++) {
+            if (defer_env_seen & (1 << i)) {
+                rec->words[rec->len++] = defer_env[i];
+            }
+        }
+        defer_env_dirty = false;
+    }
+    memcpy(&rec->words[rec->len], words, n * sizeof(u32));
+    rec->len += n;
+    defer_pending = true;
+    return true;
+}
+
+static void DeferEnv(u32 op) {
+    const int i = (int)(op >> 24) - 0xE1;
+    defer_env[i] = op;
+    defer_env_seen |= 1 << i;
+    defer_env_dirty = true;
+    // a replay ends by restoring the drawing area it found
+    if ((op >> 24 == 0xE3 || op >> 24 == 0xE4) && !defer_depth) {
+        UpdateDeferTarget();
+    }
+}
+
+// A textured primitive reads its texture page, within the texture window,
+// and its CLUT
+static void ReplaySampled(const u32* p, int max_len, int code) {
+    u32 tpage = defer_env[0xE1 - 0xE1];
+    if (GP0_IS_POLY(code)) {
+        // the page travels with the second vertex
+        int at = gp0_desc[code].stride * 2 - !!(code & GP0_GOURAUD);
+        if (at >= max_len) {
+            return;
+        }
+        tpage = p[at] >> 16;
+    }
+    // the window forces the masked bits of the coordinates to its offset
+    int u0 = 0, u1 = 0xFF, v0 = 0, v1 = 0xFF;
+    if (defer_env_seen & (1 << (0xE2 - 0xE1))) {
+        const u32 win = defer_env[0xE2 - 0xE1];
+        const int mask_u = (int)(win & 0x1F) << 3;
+        const int mask_v = (int)((win >> 5) & 0x1F) << 3;
+        u0 = ((int)((win >> 10) & 0x1F) << 3) & mask_u;
+        v0 = ((int)((win >> 15) & 0x1F) << 3) & mask_v;
+        u1 = u0 | (~mask_u & 0xFF);
+        v1 = v0 | (~mask_v & 0xFF);
+    }
+    const int bpp = (tpage >> 7) & 3;
+    const int shift = bpp == 0 ? 2 : bpp == 1 ? 1 : 0;
+    RECT tex = {(short)((tpage & 0xF) * 64 + (u0 >> shift)),
+                (short)((tpage & 0x10 ? 256 : 0) + v0),
+                (short)((u1 >> shift) - (u0 >> shift) + 1),
+                (short)(v1 - v0 + 1)};
+    ReplayOverlapping(&tex, -1);
+    if (bpp < 2 && max_len > 2) {
+        const u32 clut = p[2] >> 16;
+        RECT pal = {(short)((clut & 0x3F) * 16), (short)((clut >> 6) & 0x1FF),
+                    (short)(bpp ? 256 : 16), 1};
+        ReplayOverlapping(&pal, -1);
+    }
+}
+
+// drops the recordings the fill covers and replays those it overlaps
+static void DeferFill(const u32* p) {
+    // the fill works in steps of 16 pixels horizontally
+    RECT rect = {(short)(p[1] & 0x3F0), (short)((p[1] >> 16) & 0x1FF),
+                 (short)(((p[2] & 0x3FF) + 0xF) & ~0xF),
+                 (short)((p[2] >> 16) & 0x1FF)};
+    for (int i = 0; i < DEFER_AREAS; i++) {
+        if (RectInside(&rect, &defer_areas[i].area)) {
+            defer_areas[i].len = 0;
+        }
+    }
+    UpdateDeferPending();
+    ReplayOverlapping(&rect, -1);
+}
+
+static void DeferReset(void) {
+    ReplayAll();
+    defer_env_seen = 0;
+    defer_target = -1;
+}
+
+// the defer state belongs to the render thread while it is running, so the
+// game thread waits for it to go idle before touching it
+void Psyz_GpuSetDeferDraw(int enable) {
+    GpuSync();
+    if (defer_draw != (enable != 0)) {
+        defer_draw = enable != 0;
+        UpdateDeferTarget();
+    }
+}
+
+int Psyz_GpuPrepareDisplay(int may_skip) {
+    GpuSync();
+    if (!defer_pending) {
+        return 0;
+    }
+    static const short widths[] = {256, 320, 512, 640};
+    RECT shown = {disp_x, disp_y};
+    shown.w = disp_mode & 0x40 ? 368 : widths[disp_mode & 3];
+    // 480 lines need both the vertical resolution and the interlace bits
+    shown.h = (short)((disp_mode & 0x24) == 0x24 ? disp_lines * 2 : disp_lines);
+    bool missing = false;
+    for (int i = 0; i < DEFER_AREAS; i++) {
+        missing |=
+            defer_areas[i].len && RectsOverlap(&shown, &defer_areas[i].area);
+    }
+    if (!missing) {
+        return 0;
+    }
+    if (may_skip) {
+        return 1;
+    }
+    Psyz_GpuDrawDeferred(shown.x, shown.y, shown.w, shown.h);
+    return 0;
+}
+
+void Psyz_GpuDrawDeferred(int x, int y, int w, int h) {
+    GpuSync();
+    if (!defer_pending) {
+        return;
+    }
+    RECT rect = {(short)x, (short)y, (short)w, (short)h};
+    ReplayOverlapping(&rect, -1);
+    Draw_FlushBuffer();
+}
+
+static void DispatchPackets(u32* buf, int len) {
     RECT rect;
     unsigned int x, y;
     for (int i = 0; i < len; i++) {
         u_long op = buf[i];
         int code = (int)(buf[i] >> 24) & 0xFF;
+        u8 kind = gp0_desc[code].kind;
+        if (kind == GP0_KIND_POLY || kind == GP0_KIND_LINE ||
+            kind == GP0_KIND_RECT) {
+            if (defer_pending && (code & GP0_TEXTURED) && !GP0_IS_LINE(code)) {
+                ReplaySampled(&buf[i], len - i, code);
+            }
+            const int prim_len = gp0_desc[code].len;
+            if (defer_target >= 0 && prim_len && prim_len <= len - i &&
+                RecordDeferred(&defer_areas[defer_target], &buf[i], prim_len)) {
+                i += prim_len - 1;
+                continue;
+            }
+            i += Draw_PushPrim(&buf[i], len - i) - 1;
+            continue;
+        }
+        if (kind == GP0_KIND_ENV) {
+            DeferEnv((u32)op);
+        }
         // https://psx-spx.consoledev.net/graphicsprocessingunitgpu/#gpu-render-polygon-commands
         switch (code) {
         case 0x00:
@@ -93,6 +519,9 @@ static void DispatchPackets(u_long* buf, int len) {
             rect.y = (short)((buf[i + 1] >> 16) & 0xFFFF);
             rect.w = (short)(buf[i + 2] & 0xFFFF);
             rect.h = (short)((buf[i + 2] >> 16) & 0xFFFF);
+            if (defer_pending) {
+                DeferFill(&buf[i]);
+            }
             Draw_ClearImage(
                 &rect, (u_char)(op & 0xFF), (u_char)((op >> 8) & 0xFF),
                 (u_char)((op >> 16) & 0xFF));
@@ -105,17 +534,27 @@ static void DispatchPackets(u_long* buf, int len) {
             rect.h = (short)((buf[i + 3] >> 16) & 0xFFFF);
             x = (short)(buf[i + 2] & 0xFFFF);
             y = (short)((buf[i + 2] >> 16) & 0xFFFF);
+            if (defer_pending) {
+                RECT dst = {(short)x, (short)y, rect.w, rect.h};
+                ReplayOverlapping(&rect, -1);
+                ReplayOverlapping(&dst, -1);
+            }
             Draw_MoveImage(&rect, x, y);
             i += 3;
             break;
         case 0xA0: // write image
-            GPU_write_image();
-            break;
         case 0xC0: // read image
-            GPU_read_image();
+            // the sizes wrap to 1..1024 and 1..512
+            dma_rect.x = (short)(buf[i + 1] & 0x3FF);
+            dma_rect.y = (short)((buf[i + 1] >> 16) & 0x1FF);
+            x = buf[i + 2] & 0xFFFF;
+            y = (buf[i + 2] >> 16) & 0xFFFF;
+            dma_rect.w = (short)(((x - 1) & 0x3FF) + 1);
+            dma_rect.h = (short)(((y - 1) & 0x1FF) + 1);
+            dma_rect_set = true;
+            i += 2;
             break;
         case 0xE1:
-            GPU_STATUS = (GPU_STATUS & ~0x7FF) | (u32)(op & 0x7FF);
             Draw_SetTexpageMode((ParamDrawTexpageMode*)&op);
             break;
         case 0xE2:
@@ -136,13 +575,9 @@ static void DispatchPackets(u_long* buf, int len) {
             Draw_SetMask(!!(op & 1), !!(op & 2));
             break;
         default:
-            if (code >= 0x20 && code < 0x80) {
-                i += Draw_PushPrim(&buf[i], len - i) - 1;
-                break;
-            }
             if (user_gpu_commands[code].handler) {
-                int consumed = user_gpu_commands[code].handler(
-                    &buf[i], len - i, user_gpu_commands[code].userdata);
+                ReplayAll(); // nothing tells what the handler touches
+                int consumed = CallUserCommand(code, &buf[i], len - i);
                 if (consumed > 0 && consumed <= len - i) {
                     i += consumed - 1;
                     break;
@@ -156,13 +591,215 @@ static void DispatchPackets(u_long* buf, int len) {
     }
 }
 
+// Number of words taken by the command starting with `op`, as the backends
+// decode it. Returns 0 when the length is not known.
+static int CommandLength(u32 op) { return gp0_desc[op >> 24].len; }
+
+#ifdef PSYZ_TEST_HOOKS
+TestHookGp0Packet TestHook_Gp0Packet(int code) {
+    const Gp0Desc* desc = &gp0_desc[code & 0xFF];
+    TestHookGp0Packet packet = {
+        .len = desc->len,
+        .size = desc->size,
+        .fast = desc->shape != GP0_SHAPE_GENERIC,
+    };
+    return packet;
+}
+#endif
+
+// Applies to GPU_STATUS what the packets are going to change once decoded
+static void ShadowPackets(const u32* buf, int len) {
+    for (int i = 0; i < len;) {
+        u32 op = buf[i];
+        int code = (int)(op >> 24);
+        int n = CommandLength(op);
+        if (code == 0xE1) {
+            GPU_STATUS = (GPU_STATUS & ~STATUS_TEXPAGE) | (op & STATUS_TEXPAGE);
+        } else if (code == 0xE6) {
+            GPU_STATUS = (GPU_STATUS & ~STATUS_MASK_BITS) | ((op & 3) << 11);
+        } else if ((code & 0xE4) == 0x24 && i + n <= len) {
+            // textured polygons also switch the texture page
+            u32 tpage = buf[i + (code & 0x10 ? 5 : 4)] >> 16;
+            GPU_STATUS = (GPU_STATUS & ~STATUS_POLY_TEXPAGE) |
+                         (tpage & STATUS_POLY_TEXPAGE);
+        }
+        if (n <= 0) {
+            break; // custom or unknown command, nothing else to track
+        }
+        i += n;
+    }
+}
+
+// Hands complete packets to the backend, either right away or through the
+// render thread
+static void SubmitPackets(u32* buf, int len) {
+    if (capture_file) {
+        CaptureRecord(TRACE_GP0, buf, len, NULL, 0);
+    }
+    ShadowPackets(buf, len);
+    if (gpu_threaded) {
+        Draw_ThreadSubmit(buf, len);
+        gpu_unflushed = true;
+    } else {
+        DispatchPackets(buf, len);
+    }
+}
+
+// submits the Psyz_GpuWriteGP0 words and recycles their segments
+static void SubmitQueue(void) {
+    while (queue_head) {
+        QueueSegment* seg = queue_head;
+        if (seg->len) {
+            SubmitPackets(seg->words, seg->len);
+        }
+        queue_head = seg->next;
+        seg->next = queue_pool;
+        queue_pool = seg;
+    }
+    queue_tail = NULL;
+    queue_len = 0;
+    queue_pkt_start = 0;
+    queue_pkt_left = 0;
+}
+
 int Psyz_GpuExeque() {
-    Draw_ResetBuffer();
-    DispatchPackets(queue_buf, queue_len);
+    SubmitQueue();
+    if (capture_file && capture_unflushed) {
+        CaptureRecord(TRACE_FLUSH, NULL, 0, NULL, 0);
+        capture_unflushed = false;
+    }
+    if (gpu_threaded) {
+        if (gpu_unflushed) {
+            Draw_ThreadFlush();
+            gpu_unflushed = false;
+        }
+        return Draw_ThreadPending();
+    }
     Draw_FlushBuffer();
     Draw_ExequeSync();
-    queue_len = 0;
-    return queue_len;
+    return 0;
+}
+
+int Psyz_GpuSetThreaded(int enable) {
+    if (!enable == !gpu_threaded) {
+        return 0;
+    }
+    Psyz_GpuExeque();
+    if (enable) {
+        if (Draw_ThreadStart(DispatchPackets) < 0) {
+            WARNF("the rendering backend does not support a GPU thread");
+            return -1;
+        }
+        gpu_threaded = true;
+    } else {
+        Draw_ThreadStop();
+        gpu_threaded = false;
+        gpu_unflushed = false;
+    }
+    return 0;
+}
+
+// Submits the packet words of a single ordering table node in place
+static void DispatchNode(DR_ENV* env) {
+    int len = (int)env->len;
+    if (sizeof(u_long) == 4) {
+        SubmitPackets((u32*)env->code, len);
+        return;
+    }
+    // Primitives are mapped from structs, so their words are already packed
+    // as 32-bit. Other GPU commands are written to a u_long array instead, so
+    // on 64-bit hosts they need narrowing. A node may merge both, like a
+    // DR_MODE followed by a primitive in the same struct, so it is walked a
+    // packet at a time. The low half of a u_long sits where a packed word
+    // would, which is enough to read the opcode either way.
+    u32 words[0x100];
+    int n_words = 0;
+    u8* p = (u8*)env->code;
+    while (len > 0) {
+        u32 op = *(u32*)p;
+        int code = (int)(op >> 24);
+        int n = CommandLength(op);
+        if (code >= 0x20 && code < 0x80) {
+            if (n_words) {
+                SubmitPackets(words, n_words);
+                n_words = 0;
+            }
+            n = n < len ? n : len;
+            SubmitPackets((u32*)p, n);
+            p += n * sizeof(u32);
+            len -= n;
+            continue;
+        }
+        // image data and custom commands take the rest of the node
+        if (!n || gp0_desc[code].kind == GP0_KIND_WRITE_IMAGE || n > len) {
+            n = len;
+        }
+        if (n_words + n > LEN(words)) {
+            ERRORF("packet 0x%X long, likely corrupted", n_words + n);
+            return;
+        }
+        for (int i = 0; i < n; i++) {
+            words[n_words++] = (u32)((u_long*)p)[i];
+        }
+        p += n * sizeof(u_long);
+        len -= n;
+    }
+    if (n_words) {
+        SubmitPackets(words, n_words);
+    }
+}
+
+// Ordering table profiler. A node without packets is an OT slot, the nodes
+// carrying packets that follow it until the next empty one are its chain.
+static bool ot_profile = false;
+static PsyzGpuOtStats ot_frame;
+static PsyzGpuOtStats ot_last_frame;
+
+static void ProfileNode(PsyzGpuOtWalk* walk, unsigned* chain, int len) {
+    walk->links++;
+    if (len == 0) {
+        walk->empty_links++;
+        *chain = 0;
+        return;
+    }
+    if ((*chain)++ == 0) {
+        walk->occupied_slots++;
+    }
+    if (*chain > walk->longest_chain) {
+        walk->longest_chain = *chain;
+    }
+    walk->prims++;
+    walk->packet_bytes += (unsigned)len * sizeof(u32);
+}
+
+static void ProfileWalk(const PsyzGpuOtWalk* walk) {
+    PsyzGpuOtWalk* total = &ot_frame.total;
+    ot_frame.walks++;
+    total->links += walk->links;
+    total->empty_links += walk->empty_links;
+    total->occupied_slots += walk->occupied_slots;
+    total->prims += walk->prims;
+    if (walk->longest_chain > total->longest_chain) {
+        total->longest_chain = walk->longest_chain;
+    }
+    total->packet_bytes += walk->packet_bytes;
+    if (walk->links > ot_frame.largest.links) {
+        ot_frame.largest = *walk;
+    }
+}
+
+void Psyz_GpuOtProfile(int enable) {
+    ot_profile = enable != 0;
+    memset(&ot_frame, 0, sizeof(ot_frame));
+    memset(&ot_last_frame, 0, sizeof(ot_last_frame));
+}
+
+int Psyz_GpuOtStats(PsyzGpuOtStats* stats) {
+    if (!stats || !ot_profile) {
+        return -1;
+    }
+    *stats = ot_last_frame;
+    return 0;
 }
 
 static int GPU_Enqueue(u_long p1, u_long p2) {
@@ -170,62 +807,65 @@ static int GPU_Enqueue(u_long p1, u_long p2) {
     if (mask) {
         WARNF("mask not supported (mask:%08X)", mask);
     }
+    // raw GP0 writes issued before this ordering table come first
+    SubmitQueue();
     DR_ENV* env = (DR_ENV*)(uintptr_t)p1;
-    if (sizeof(u_long) == 4) {
-        // fast path for 32-bit systems
-        while (1) {
-            if (env->len > 0) {
-                DispatchPackets((u_long*)env->code, (int)env->len);
-            }
-            if (isendprim(env)) {
-                break;
-            }
-            env = (DR_ENV*)nextPrim(env);
-        }
-        return 0;
-    }
+    PsyzGpuOtWalk walk = {0};
+    unsigned chain = 0;
     while (1) {
-        if (queue_len + env->len > LEN(queue_buf)) {
-            if (env->len > 0x100) {
-                ERRORF("packet 0x%X long, likely corrupted", env->len);
-            }
-            INFOF("GPU queue full, calling exeque");
-            Psyz_GpuExeque();
-        } else if (sizeof(u_long) == 8) {
-            // Wow okay, this part is uuuugly...
-            // Gpu code is usually written to a u_long array, which will work
-            // fine on both 32-bit and 64-bit compiled code.
-            // But primitives are mapped from structs, we need to align the data
-            int code = getcode(env) & ~3;
-            if (code >= 0x20 && code < 0x80) {
-                // it is a prim, we need to split
-                u32* prim_data = (u32*)env->code;
-                for (u_long i = 0; i < env->len; i++) {
-                    queue_buf[queue_len + i] = prim_data[i];
-                }
-            } else if (env->len > 0) {
-                // TODO this is a temporary solution:
-                // if gpu commands get merged with primitives, this will not
-                // work
-                memcpy(queue_buf + queue_len, env->code,
-                       env->len * sizeof(u_long));
-            }
+        if (env->len > 0) {
+            DispatchNode(env);
+        }
+        if (ot_profile) {
+            ProfileNode(&walk, &chain, (int)env->len);
         }
-        queue_len += (int)env->len;
         if (isendprim(env)) {
             break;
         }
         env = (DR_ENV*)nextPrim(env);
     }
+    if (ot_profile) {
+        ProfileWalk(&walk);
+    }
     return 0;
 }
-static int GPU_DataWrite(u_long p1, u_long p2) {
+// drains the pending primitives ahead of a VRAM transfer, the flush is then
+// accounted to the transfer in the pipeline stats rather than to Exeque
+static void SyncForTransfer(PsyzFlushReason reason) {
+    Draw_SetFlushReason(reason);
     Psyz_GpuExeque();
+    GpuSync();
+    Draw_SetFlushReason(PSYZ_FLUSH_EXEQUE);
+}
+// uploads are ordered against the pending primitives by the backend, which
+// may record them in the same batch, so the queue is handed over unflushed
+static void SyncForLoad(void) {
+    if (gpu_threaded) {
+        SyncForTransfer(PSYZ_FLUSH_LOAD_IMAGE);
+        return;
+    }
+    SubmitQueue();
+}
+static int GPU_DataWrite(u_long p1, u_long p2) {
+    SyncForLoad();
+    if (capture_file) {
+        CaptureImage(TRACE_LOAD_IMAGE, (RECT*)(uintptr_t)p1,
+                     (const void*)(uintptr_t)p2);
+    }
+    if (defer_pending) {
+        ReplayOverlapping((RECT*)(uintptr_t)p1, -1);
+    }
     Draw_LoadImage((RECT*)(uintptr_t)p1, (u_long*)(uintptr_t)p2);
     return 0;
 }
 static int GPU_DataRead(u_long p1, u_long p2) {
-    Psyz_GpuExeque();
+    SyncForTransfer(PSYZ_FLUSH_STORE_IMAGE);
+    if (capture_file) {
+        CaptureImage(TRACE_STORE_IMAGE, (RECT*)(uintptr_t)p1, NULL);
+    }
+    if (defer_pending) {
+        ReplayOverlapping((RECT*)(uintptr_t)p1, -1);
+    }
     Draw_StoreImage((RECT*)(uintptr_t)p1, (u_long*)(uintptr_t)p2);
     return 0;
 }
@@ -273,8 +913,15 @@ static int psyz_clr(RECT* rect, u32 color) {
 
 void Psyz_GpuDisplayCommand(unsigned int cmd) {
     unsigned char op = (cmd >> 24) & 0x3F;
+    GpuSync();
+    if (capture_file) {
+        u32 word = cmd;
+        CaptureRecord(TRACE_GP1, &word, 1, NULL, 0);
+    }
     switch (op) {
     case 0:
+        GPU_STATUS = STATUS_DISPLAY_OFF;
+        DeferReset();
         Draw_Reset();
         break;
     case 1:
@@ -284,22 +931,32 @@ void Psyz_GpuDisplayCommand(unsigned int cmd) {
         LOG_ONCE("Ack IRQ not implemented");
         break;
     case 3:
+        GPU_STATUS = (GPU_STATUS & ~STATUS_DISPLAY_OFF) | ((cmd & 1) << 23);
         Draw_DisplayEnable(!(cmd & 1));
         break;
     case 4:
         LOG_ONCE("DMA direction not implemented");
         break;
     case 5:
+        disp_x = (short)(cmd & 0x3FF);
+        disp_y = (short)((cmd >> 10) & 0x3FF);
         Draw_DisplayArea(cmd & 0x3FF, (cmd >> 10) & 0x3FF);
         break;
     case 6:
         Draw_DisplayHorizontalRange(cmd & 0xFFF, (cmd >> 12) & 0xFFF);
         break;
     case 7:
+        if (((cmd >> 10) & 0x3FF) > (cmd & 0x3FF)) {
+            disp_lines = (int)((cmd >> 10) & 0x3FF) - (int)(cmd & 0x3FF);
+        }
         Draw_DisplayVerticalRange(cmd & 0x3FF, (cmd >> 10) & 0x3FF);
         break;
     case 8:
         cmd &= 0xFFFFFF;
+        GPU_STATUS &= ~(STATUS_DISPLAY_MODE | STATUS_REVERSE);
+        GPU_STATUS |= ((cmd & 0x3F) << 17) | ((cmd & 0x40) << 10) |
+                      ((cmd & 0x80) << 7);
+        disp_mode = cmd & 0x67;
         Draw_SetDisplayMode((DisplayMode*)&cmd);
         break;
     default:
@@ -316,13 +973,27 @@ static int psyz_getctl(int _) {
     return 0;
 }
 
+// Every entry links to the previous one, filled forward so the stores stream
 static void psyz_otc(OT_TYPE* ot, s32 n) {
-    s32 i;
+    s32 i = 1;
 
     if (n <= 0) {
         return;
     }
-    for (i = n - 1; i > 0; i--) {
+#if defined(__SSE2__)
+    if (sizeof(OT_TYPE) == 16 && sizeof(u_long) == 8) {
+        // one entry per store, {tag, len} = {&ot[i - 1], 0}
+        __m128i tag = _mm_set_epi64x(0, (long long)(uintptr_t)ot);
+        const __m128i step = _mm_set_epi64x(0, (long long)sizeof(OT_TYPE));
+        for (; i + 1 < n; i += 2) {
+            __m128i next = _mm_add_epi64(tag, step);
+            _mm_storeu_si128((__m128i*)&ot[i], tag);
+            _mm_storeu_si128((__m128i*)&ot[i + 1], next);
+            tag = _mm_add_epi64(next, step);
+        }
+    }
+#endif
+    for (; i < n; i++) {
         setaddr(&ot[i], &ot[i - 1]);
         setlen(&ot[i], 0);
     }
@@ -330,34 +1001,327 @@ static void psyz_otc(OT_TYPE* ot, s32 n) {
     setlen(&ot[0], 0);
 }
 
+void Psyz_GpuDmaBlock(void* addr, int from_ram) {
+    // the GP0 A0/C0 preceding the transfer may still be queued
+    if (from_ram) {
+        SyncForLoad();
+    } else {
+        SyncForTransfer(PSYZ_FLUSH_STORE_IMAGE);
+    }
+    if (!dma_rect_set) {
+        WARNF("GPU DMA block transfer without a GP0 A0/C0 command");
+        return;
+    }
+    dma_rect_set = false;
+    if (defer_pending) {
+        ReplayOverlapping(&dma_rect, -1);
+    }
+    if (from_ram) {
+        if (capture_file) {
+            CaptureImage(TRACE_LOAD_IMAGE, &dma_rect, addr);
+        }
+        Draw_LoadImage(&dma_rect, (u_long*)addr);
+    } else {
+        if (capture_file) {
+            CaptureImage(TRACE_STORE_IMAGE, &dma_rect, NULL);
+        }
+        Draw_StoreImage(&dma_rect, (u_long*)addr);
+    }
+}
+
+void Psyz_GpuDmaLinkedList(void* ot) {
+    GPU_Enqueue((u_long)(uintptr_t)ot, 0);
+    Psyz_GpuExeque();
+}
+
+void Psyz_GpuDmaClearOTag(void* ot_last, int n) {
+    if (n <= 0) {
+        return;
+    }
+    psyz_otc((OT_TYPE*)ot_last - (n - 1), n);
+}
+
 static int psyz_param(int _) {
     NOT_IMPLEMENTED;
     return 0;
 }
 static int psyz_reset(int _) { return GPU_V0; }
 static u_long psyz_status(void) {
-    NOT_IMPLEMENTED;
-    return 0;
+    u32 status = GPU_STATUS | STATUS_READY_VRAM | STATUS_READY_DMA;
+    if (!Draw_ThreadPending()) {
+        status |= STATUS_READY_CMD;
+    }
+    return status;
 }
 static int psyz_sync(int mode) {
     // see decomp/src/libgpu/sys.c
     // mode 0 waits until all the queue is drawn on screen
     // mode 1 process the queue and return how many elements have been queued
     // return -1 if GPU has timed out
-    // but on PC the implementation is much simpler as it's always synced
-    Psyz_GpuExeque();
-    return 0;
+    // on PC only the GPU thread, when enabled, can leave work behind
+    int pending = Psyz_GpuExeque();
+    if (mode == 0 && pending) {
+        GpuSync();
+        pending = 0;
+    }
+    return pending;
 }
 
 int psyz_gpu_version(int mode) { return GPU_V0; }
 
+static QueueSegment* AllocQueueSegment(void) {
+    QueueSegment* seg = queue_pool;
+    if (seg) {
+        queue_pool = seg->next;
+    } else {
+        seg = malloc(sizeof(*seg));
+        if (!seg) {
+            ERRORF("failed to allocate %d bytes", (int)sizeof(*seg));
+            return NULL;
+        }
+    }
+    seg->next = NULL;
+    seg->len = 0;
+    return seg;
+}
+
 // forwards raw GP0 words into the internal queue, then trigger execution.
 void Psyz_GpuWriteGP0(unsigned int word) {
-    if (queue_len >= (int)LEN(queue_buf)) {
-        WARNF("GPU queue full");
+    QueueSegment* seg = queue_tail;
+    if (!seg || seg->len == QUEUE_SEGMENT_LEN) {
+        QueueSegment* next = AllocQueueSegment();
+        if (!next) {
+            WARNF("GPU queue full");
+            return;
+        }
+        if (!seg) {
+            queue_head = next;
+        } else {
+            seg->next = next;
+            if (queue_pkt_left) {
+                // move the incomplete packet, it is only a few words long
+                int moved = seg->len - queue_pkt_start;
+                memcpy(next->words, &seg->words[queue_pkt_start],
+                       sizeof(*next->words) * moved);
+                next->len = moved;
+                seg->len = queue_pkt_start;
+                queue_pkt_start = 0;
+            }
+        }
+        queue_tail = seg = next;
+    }
+    if (!queue_pkt_left) {
+        // commands with an unknown length, such as the application-defined
+        // ones, are treated as single words
+        int n = CommandLength(word);
+        queue_pkt_start = seg->len;
+        queue_pkt_left = n > 0 ? n : 1;
+    }
+    queue_pkt_left--;
+    seg->words[seg->len++] = (u32)word;
+    if (++queue_len > queue_high_water) {
+        queue_high_water = queue_len;
+    }
+}
+
+// Submits whole packets straight from the caller memory, in chunks the render
+// thread ring can take. Returns the words consumed, a trailing incomplete
+// packet is left to the caller.
+static size_t SubmitBlock(const u32* words, size_t n) {
+    size_t done = 0;
+    while (done < n) {
+        size_t end = done;
+        while (end < n) {
+            int len = CommandLength(words[end]);
+            if (len <= 0) {
+                len = 1; // same as the queue, see Psyz_GpuWriteGP0
+            }
+            if ((size_t)len > n - end ||
+                end + len - done > QUEUE_SEGMENT_LEN) {
+                break;
+            }
+            end += len;
+        }
+        if (end == done) {
+            break;
+        }
+        // packets are only read by the backends
+        SubmitPackets((u32*)&words[done], (int)(end - done));
+        done = end;
+    }
+    return done;
+}
+
+void Psyz_GpuWriteGP0Block(const uint32_t* words, size_t n) {
+    size_t i = 0;
+    // complete the packet the queue already started first
+    while (i < n && queue_pkt_left) {
+        Psyz_GpuWriteGP0(words[i++]);
+    }
+    if (i == n) {
         return;
     }
-    queue_buf[queue_len++] = (u_long)word;
+    // the block is decoded from the caller memory, which is not kept until
+    // the next Exeque, so whatever was queued before it has to go first
+    SubmitQueue();
+    i += SubmitBlock(&words[i], n - i);
+    while (i < n) {
+        Psyz_GpuWriteGP0(words[i++]);
+    }
+}
+
+// a 2MB RAM can not hold more nodes than this without looping
+#define LINKED_LIST_MAX_NODES 0x80000
+
+int Psyz_GpuWriteGP0LinkedList(const void* base, uint32_t address,
+                               PsyzGpuTranslateAddress translate,
+                               void* userdata) {
+    for (int nodes = 0; nodes < LINKED_LIST_MAX_NODES; nodes++) {
+        const uint32_t* node;
+        if (translate) {
+            node = translate(address & 0xFFFFFC, userdata);
+        } else {
+            node = (const uint32_t*)((const u8*)base + (address & 0xFFFFFC));
+        }
+        if (!node) {
+            ERRORF("linked list address %06X can not be translated", address);
+            return -1;
+        }
+        u32 header = node[0];
+        if (header >> 24) {
+            Psyz_GpuWriteGP0Block(node + 1, header >> 24);
+        }
+        address = header & 0xFFFFFF;
+        if (address & 0x800000) {
+            return nodes + 1;
+        }
+    }
+    ERRORF("linked list longer than %d nodes, likely looping",
+           LINKED_LIST_MAX_NODES);
+    return -1;
+}
+
+int Psyz_GpuCaptureStart(const char* path) {
+    Psyz_GpuCaptureStop();
+    // pending words belong to the frame before the capture
+    Psyz_GpuExeque();
+    capture_file = fopen(path, "wb");
+    if (!capture_file) {
+        ERRORF("failed to open '%s' for writing", path);
+        return -1;
+    }
+    setvbuf(capture_file, NULL, _IOFBF, 1 << 20);
+    const u32 header[] = {TRACE_MAGIC, TRACE_VERSION, 0, 0};
+    if (fwrite(header, sizeof(header), 1, capture_file) != 1) {
+        ERRORF("failed to write '%s'", path);
+        Psyz_GpuCaptureStop();
+        return -1;
+    }
+    capture_unflushed = false;
+    return 0;
+}
+
+void Psyz_GpuCaptureStop(void) {
+    if (capture_file) {
+        fclose(capture_file);
+        capture_file = NULL;
+    }
+}
+
+void Psyz_GpuVSync(void) {
+    if (capture_file) {
+        CaptureRecord(TRACE_VSYNC, NULL, 0, NULL, 0);
+    }
+    if (ot_profile) {
+        ot_last_frame = ot_frame;
+        memset(&ot_frame, 0, sizeof(ot_frame));
+    }
+}
+
+int Psyz_GpuReplayOpen(PsyzGpuTrace* trace, const void* data, size_t size) {
+    const u32* words = (const u32*)data;
+    if (size < 16 || ((uintptr_t)data & 3) || words[0] != TRACE_MAGIC) {
+        ERRORF("not a GPU trace");
+        return -1;
+    }
+    if (words[1] != TRACE_VERSION) {
+        ERRORF("GPU trace version %u not supported", words[1]);
+        return -1;
+    }
+    trace->data = data;
+    trace->size = size / 4;
+    trace->offset = 4;
+    return 0;
+}
+
+int Psyz_GpuReplayFrame(PsyzGpuTrace* trace, PsyzGpuReplayStats* stats) {
+    const u32* words = (const u32*)trace->data;
+    RECT rect;
+    memset(stats, 0, sizeof(*stats));
+    while (trace->offset < trace->size) {
+        u32 header = words[trace->offset];
+        int type = (int)(header >> 24);
+        size_t len = header & 0xFFFFFF;
+        const u32* payload = &words[trace->offset + 1];
+        if (len > trace->size - trace->offset - 1) {
+            ERRORF("GPU trace truncated at word 0x%X", (int)trace->offset);
+            return -1;
+        }
+        trace->offset += 1 + len;
+        switch (type) {
+        case TRACE_GP0:
+            // packets are only read, so they can come from read-only memory
+            SubmitPackets((u32*)payload, (int)len);
+            stats->gp0_words += (unsigned int)len;
+            break;
+        case TRACE_GP1:
+            Psyz_GpuDisplayCommand(payload[0]);
+            break;
+        case TRACE_LOAD_IMAGE:
+        case TRACE_STORE_IMAGE:
+            rect.x = (short)(payload[0] & 0xFFFF);
+            rect.y = (short)(payload[0] >> 16);
+            rect.w = (short)(payload[1] & 0xFFFF);
+            rect.h = (short)(payload[1] >> 16);
+            if (type == TRACE_LOAD_IMAGE) {
+                GPU_DataWrite((u_long)(uintptr_t)&rect,
+                              (u_long)(uintptr_t)&payload[2]);
+            } else {
+                // nothing looks at the pixels, but the download has to land
+                // before its buffer is released
+                const int w = rect.w > 0 ? rect.w : 1;
+                const int h = rect.h > 0 ? rect.h : 1;
+                u16* pixels = malloc((size_t)w * h * sizeof(u16));
+                if (!pixels) {
+                    ERRORF("failed to allocate the readback buffer");
+                    return -1;
+                }
+                GPU_DataRead(
+                    (u_long)(uintptr_t)&rect, (u_long)(uintptr_t)pixels);
+                psyz_sync(0);
+                free(pixels);
+            }
+            stats->transfers++;
+            break;
+        case TRACE_FLUSH:
+            Psyz_GpuExeque();
+            stats->flushes++;
+            break;
+        case TRACE_VSYNC:
+            return 1;
+        case TRACE_GRID:
+            Psyz_GpuSetHorizontalGrid(payload[0], payload[1]);
+            break;
+        default:
+            WARNF("unknown GPU trace record %d", type);
+            break;
+        }
+    }
+    return 0;
+}
+
+unsigned int Psyz_GpuGetQueueHighWater(void) {
+    return (unsigned int)queue_high_water;
 }
 
 void GPU_cw(u_long* param) {
@@ -0,0 +1,38 @@
+// Private header for the hooks the unit tests drive the library with
+// Not part of the public API - do not include from external code
+
+#ifndef PSYZ_TEST_HOOKS_H
+#define PSYZ_TEST_HOOKS_H
+
+// Only built when the tests define PSYZ_TEST_HOOKS for the whole library
+#ifdef PSYZ_TEST_HOOKS
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// What the GP0 descriptor table tells about an opcode
+typedef struct {
+    int len;  // words taken by the packet, 0 when not known
+    int size; // width and height of fixed-size rectangles, 0 otherwise
+    int fast; // 1 when the SDL3 backends have a dedicated unpack routine
+} TestHookGp0Packet;
+TestHookGp0Packet TestHook_Gp0Packet(int code);
+
+#ifndef __PSP__
+// With enable 0, every primitive goes through the generic decoder rather
+// than the fast paths of the SDL3 backends, so both can be compared.
+void TestHook_SetFastPaths(int enable);
+
+// With enable 1, every frame counts as having overrun its budget whatever
+// it took, so that frame skipping is driven deterministically.
+void TestHook_ForceLateFrames(int enable);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+#endif
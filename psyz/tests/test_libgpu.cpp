@@ -1,11 +1,13 @@
 #include <cstdlib>
 #include <cstring>
+#include <vector>
 #include <gtest/gtest.h>
 extern "C" {
 #include <psyz.h>
 #include <kernel.h>
 #include <libetc.h>
 #include <libgpu.h>
+#include "../src/test_hooks.h"
 }
 
 #include "res/4bpp.h"
@@ -22,6 +24,9 @@ extern "C" {
 #define STBI_MAX_DIMENSIONS 1024
 #include "stb_image.h"
 #include "../src/dbgserver/stb_image_write.h"
+#ifndef __PSP__
+#include "../src/platform/sdl3_pixel.h"
+#endif
 
 #ifndef LEN
 #define LEN(x) ((s32)(sizeof(x) / sizeof(*(x))))
@@ -559,6 +564,80 @@ TEST_F(gpu_Test, move_image_internal_res) {
     AssertFrame("move_image");
 }
 
+TEST_F(gpu_Test, auto_internal_res) {
+#ifdef __PSP__
+    GTEST_SKIP() << "no internal resolution scaling supported";
+    return;
+#endif
+    ASSERT_EQ(Psyz_VideoGetAutoInternalResolution(), 0);
+    ASSERT_EQ(Psyz_VideoSetAutoInternalResolution(PSYZ_INTERNAL_RES_MAX + 1),
+              -1);
+    ASSERT_EQ(Psyz_VideoSetAutoInternalResolution(4), 0);
+    ASSERT_EQ(Psyz_VideoGetAutoInternalResolution(), 4);
+    VSync(0);
+
+    // picking a multiplier by hand turns the automatic one off
+    ASSERT_EQ(Psyz_VideoSetInternalResolution(2), 0);
+    ASSERT_EQ(Psyz_VideoGetAutoInternalResolution(), 0);
+    PsyzVideoStats stats;
+    ASSERT_EQ(Psyz_VideoStats(&stats), 0);
+    EXPECT_EQ(stats.internal_res, 2u);
+
+    ASSERT_EQ(Psyz_VideoSetInternalResolution(1), 0);
+    ASSERT_EQ(Psyz_VideoStats(&stats), 0);
+    EXPECT_EQ(stats.internal_res, 1u);
+}
+
+TEST_F(gpu_Test, present_queue) {
+    ASSERT_EQ(Psyz_VideoGetPresentQueue(), 0);
+    ASSERT_EQ(Psyz_VideoSetPresentQueue(PSYZ_PRESENT_QUEUE_MAX + 1), -1);
+    ASSERT_EQ(Psyz_VideoGetPresentQueue(), 0);
+    // only the renderers that can acquire the swapchain without waiting
+    // queue frames, the others keep the depth at 0
+    if (Psyz_VideoSetPresentQueue(2)) {
+        EXPECT_EQ(Psyz_VideoGetPresentQueue(), 0);
+        return;
+    }
+    ASSERT_EQ(Psyz_VideoGetPresentQueue(), 2);
+    for (int i = 0; i < 4; i++) {
+        VSync(0);
+    }
+    ASSERT_EQ(Psyz_VideoSetPresentQueue(1), 0);
+    VSync(0);
+    ASSERT_EQ(Psyz_VideoSetPresentQueue(0), 0);
+    VSync(0);
+}
+
+TEST_F(gpu_Test, store_image_readback_modes) {
+    EXPECT_EQ(Psyz_VideoGetReadbackMode(), PSYZ_READBACK_DRAWSYNC);
+    EXPECT_EQ(Psyz_VideoSetReadbackMode((PsyzReadbackMode)-1), -1);
+
+    u_short pattern[16 * 16];
+    u_short readback[16 * 16];
+    RECT rect = {640, 256, 16, 16};
+    const PsyzReadbackMode modes[] = {
+        PSYZ_READBACK_SYNC, PSYZ_READBACK_DRAWSYNC, PSYZ_READBACK_NEXT_FRAME};
+    for (int m = 0; m < 3; m++) {
+        for (int i = 0; i < 16 * 16; i++) {
+            pattern[i] = (u_short)((i + m) * 0x3579);
+        }
+        ASSERT_EQ(Psyz_VideoSetReadbackMode(modes[m]), 0);
+        EXPECT_EQ(Psyz_VideoGetReadbackMode(), modes[m]);
+        LoadImage(&rect, (u_long*)pattern);
+        DrawSync(0);
+        memset(readback, 0, sizeof(readback));
+        StoreImage(&rect, (u_long*)readback);
+        if (modes[m] == PSYZ_READBACK_DRAWSYNC) {
+            DrawSync(0);
+        } else if (modes[m] == PSYZ_READBACK_NEXT_FRAME) {
+            DrawSync(0);
+            VSync(0);
+        }
+        EXPECT_EQ(memcmp(pattern, readback, sizeof(pattern)), 0) << m;
+    }
+    Psyz_VideoSetReadbackMode(PSYZ_READBACK_DRAWSYNC);
+}
+
 TEST_F(gpu_Test, blit) {
     TIM_IMAGE tim;
     RECT rect = {16, 16, 64, 64};
@@ -921,6 +1000,642 @@ TEST_F(gpu_Test, untextured_transp_poly_take_abr_from_drawenv) {
     AssertFrame("abr_untextured");
 }
 
+static int CountPixels(int x, int y, int w, int h, u_short color) {
+    static u_short pixels[256 * 256];
+    RECT rect = {(short)x, (short)y, (short)w, (short)h};
+    StoreImage(&rect, (u_long*)pixels);
+    DrawSync(0);
+    int n = 0;
+    for (int i = 0; i < w * h; i++) {
+        n += (pixels[i] & 0x7FFF) == color;
+    }
+    return n;
+}
+
+TEST(gp0_Test, desc_lengths) {
+    // words of each packet, as setlen writes them in the primitive tags
+    const struct {
+        int code, len;
+    } packets[] = {
+        {0x00, 1},  {0x01, 1},  {0x02, 3},  {0x20, 4},  {0x24, 7},  {0x28, 5},
+        {0x2C, 9},  {0x30, 6},  {0x34, 9},  {0x38, 8},  {0x3C, 12}, {0x40, 3},
+        {0x48, 5},  {0x4C, 6},  {0x50, 4},  {0x58, 7},  {0x5C, 9},  {0x60, 3},
+        {0x64, 4},  {0x68, 2},  {0x6C, 3},  {0x70, 2},  {0x74, 3},  {0x78, 2},
+        {0x7C, 3},  {0x80, 4},  {0xA0, 3},  {0xC0, 3},  {0xE1, 1},  {0xE6, 1},
+    };
+    for (const auto& p : packets) {
+        // raw texture and semi-transparency do not change the layout
+        const int variants = p.code >= 0x20 && p.code < 0x80 ? 4 : 1;
+        for (int i = 0; i < variants; i++) {
+            EXPECT_EQ(TestHook_Gp0Packet(p.code + i).len, p.len)
+                << "code 0x" << std::hex << p.code + i;
+        }
+    }
+    // POLY_FT4 and the textured rectangles have their own unpack routines
+    for (int code = 0x2C; code < 0x30; code++) {
+        EXPECT_TRUE(TestHook_Gp0Packet(code).fast);
+    }
+    const int sprites[] = {0x64, 0x6C, 0x74, 0x7C};
+    const int sizes[] = {0, 1, 8, 16};
+    for (int i = 0; i < LEN(sprites); i++) {
+        EXPECT_TRUE(TestHook_Gp0Packet(sprites[i]).fast);
+        EXPECT_EQ(TestHook_Gp0Packet(sprites[i]).size, sizes[i]);
+    }
+    EXPECT_FALSE(TestHook_Gp0Packet(0x3C).fast);
+    EXPECT_FALSE(TestHook_Gp0Packet(0x60).fast);
+}
+
+#ifndef __PSP__
+// draws textured quads and sprites through the fast paths or the generic
+// decoder, and reads back where they landed
+static void DrawFastPathPrims(bool fast, u_short* out) {
+    RECT area = {0, 0, 256, 64};
+    ClearImage(&area, 0, 0, 0);
+    DrawSync(0);
+    TestHook_SetFastPaths(fast);
+
+    const u_short tpage = GetTPage(2, 0, 640, 0);
+    static OT_TYPE ot[2];
+    static DR_MODE mode;
+    static POLY_FT4 ft4[3];
+    static SPRT sprt;
+    static SPRT_8 sprt8;
+    static SPRT_16 sprt16;
+    static TILE tile;
+    ClearOTagR(ot, LEN(ot));
+    SetDrawMode(&mode, 0, 0, tpage, NULL);
+    addPrim(&ot[1], &mode);
+    for (int i = 0; i < LEN(ft4); i++) {
+        setPolyFT4(&ft4[i]);
+        setRGB0(&ft4[i], 200, 100, 50);
+        setXYWH(&ft4[i], i * 40, 0, 32, 32);
+        setUVWH(&ft4[i], 0, 0, 32, 32);
+        ft4[i].tpage = tpage;
+        ft4[i].clut = 0;
+        addPrim(&ot[0], &ft4[i]);
+    }
+    // mirrored on both axes
+    setUV4(&ft4[1], 31, 31, 0, 31, 31, 0, 0, 0);
+    // raw texture colors ignore the primitive color
+    setShadeTex(&ft4[2], 1);
+    setSemiTrans(&ft4[2], 1);
+    setSprt(&sprt);
+    setRGB0(&sprt, 64, 128, 255);
+    setXY0(&sprt, 128, 0);
+    setWH(&sprt, 24, 20);
+    setUV0(&sprt, 4, 8);
+    addPrim(&ot[0], &sprt);
+    setSprt8(&sprt8);
+    setRGB0(&sprt8, 10, 20, 30);
+    setShadeTex(&sprt8, 1);
+    setXY0(&sprt8, 160, 0);
+    setUV0(&sprt8, 16, 16);
+    addPrim(&ot[0], &sprt8);
+    setSprt16(&sprt16);
+    setRGB0(&sprt16, 128, 64, 32);
+    setXY0(&sprt16, 176, 0);
+    setUV0(&sprt16, 40, 2);
+    addPrim(&ot[0], &sprt16);
+    // the raw texture bit does not apply to untextured rectangles
+    setTile(&tile);
+    setRGB0(&tile, 40, 200, 80);
+    setShadeTex(&tile, 1);
+    setXY0(&tile, 200, 0);
+    setWH(&tile, 24, 16);
+    addPrim(&ot[0], &tile);
+    DrawOTag(&ot[LEN(ot) - 1]);
+    DrawSync(0);
+
+    StoreImage(&area, (u_long*)out);
+    DrawSync(0);
+    TestHook_SetFastPaths(1);
+}
+
+TEST_F(gpu_Test, fast_paths_match_generic) {
+    // a texture where every texel differs from its neighbours
+    static u_short texture[64 * 64];
+    for (int i = 0; i < LEN(texture); i++) {
+        const int u = i % 64, v = i / 64;
+        texture[i] = (u_short)((u & 31) | (v & 31) << 5 | ((u ^ v) & 31) << 10);
+        texture[i] |= texture[i] ? 0 : 1;
+    }
+    RECT rect = {640, 0, 64, 64};
+    LoadImage(&rect, (u_long*)texture);
+    DrawSync(0);
+
+    static u_short fast[256 * 64], generic[256 * 64];
+    DrawFastPathPrims(true, fast);
+    DrawFastPathPrims(false, generic);
+    int drawn = 0;
+    for (int i = 0; i < LEN(fast); i++) {
+        ASSERT_EQ(fast[i], generic[i]) << "at " << i % 256 << "," << i / 256;
+        drawn += fast[i] != 0;
+    }
+    EXPECT_GT(drawn, 3 * 32 * 32);
+}
+#endif
+
+TEST_F(gpu_Test, gp0_queue_grows) {
+    // one TILE_1 per pixel, far more words than a single queue segment holds
+    const int w = 128, h = 64;
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            Psyz_GpuWriteGP0(0x680000FF);
+            Psyz_GpuWriteGP0((unsigned)(y << 16) | (unsigned)x);
+        }
+    }
+    EXPECT_GE(Psyz_GpuGetQueueHighWater(), (unsigned)(w * h * 2));
+    DrawSync(0);
+    EXPECT_EQ(CountPixels(0, 0, w, h, 0x001F), w * h);
+}
+
+TEST_F(gpu_Test, frame_skip_keeps_vram) {
+    ASSERT_EQ(Psyz_VideoGetFrameSkip(), PSYZ_FRAMESKIP_OFF);
+    ASSERT_EQ(Psyz_VideoSetFrameSkip((PsyzFrameSkipMode)-1), -1);
+#ifdef __PSP__
+    GTEST_SKIP() << "no frame skipping supported";
+#else
+    ASSERT_EQ(Psyz_VideoSetFrameSkip(PSYZ_FRAMESKIP_DRAW), 0);
+    PsyzVideoStats before, after;
+    ASSERT_EQ(Psyz_VideoStats(&before), 0);
+
+    // a late frame defers drawing into the display framebuffer
+    static OT_TYPE ot[4];
+    static TILE tile;
+    ClearOTagR(ot, LEN(ot));
+    setTile(&tile);
+    setRGB0(&tile, 0xFF, 0, 0);
+    setXY0(&tile, 16, 16);
+    setWH(&tile, 16, 16);
+    addPrim(&ot[2], &tile);
+    TestHook_ForceLateFrames(1);
+    VSync(0);
+    DrawOTag(&ot[LEN(ot) - 1]);
+    DrawSync(0);
+    VSync(0);
+    TestHook_ForceLateFrames(0);
+    ASSERT_EQ(Psyz_VideoStats(&after), 0);
+    EXPECT_EQ(after.skipped_frames, before.skipped_frames + 1);
+
+    // reading it back rasterizes what was deferred
+    EXPECT_EQ(CountPixels(16, 16, 16, 16, 0x001F), 16 * 16);
+    ASSERT_EQ(Psyz_VideoSetFrameSkip(PSYZ_FRAMESKIP_OFF), 0);
+#endif
+}
+
+TEST_F(gpu_Test, frame_skip_replays_sampled) {
+#ifdef __PSP__
+    GTEST_SKIP() << "no frame skipping supported";
+#else
+    ASSERT_EQ(Psyz_VideoSetFrameSkip(PSYZ_FRAMESKIP_DRAW), 0);
+    TestHook_ForceLateFrames(1);
+    VSync(0);
+
+    // a late frame records a tile into a drawing area of its own
+    static DR_AREA area[2];
+    static DR_OFFSET offset[2];
+    static DR_MODE mode;
+    static DR_TWIN twin;
+    static TILE tile;
+    static SPRT sprt;
+    RECT tile_area = {32, 64, 16, 16};
+    u_short tile_offset[] = {32, 64};
+    SetDrawArea(&area[0], &tile_area);
+    SetDrawOffset(&offset[0], tile_offset);
+    setTile(&tile);
+    setRGB0(&tile, 0xFF, 0, 0);
+    setXY0(&tile, 0, 0);
+    setWH(&tile, 16, 16);
+    catPrim(&area[0], &offset[0]);
+    catPrim(&offset[0], &tile);
+    catPrim(&tile, &area[1]);
+
+    // then a sprite elsewhere samples it through a texture window only
+    RECT sprt_area = {256, 0, 256, 240};
+    u_short sprt_offset[] = {256, 0};
+    RECT win = {32, 64, 16, 16};
+    SetDrawArea(&area[1], &sprt_area);
+    SetDrawOffset(&offset[1], sprt_offset);
+    SetDrawMode(&mode, 0, 0, GetTPage(2, 0, 0, 0), NULL);
+    SetTexWindow(&twin, &win);
+    setSprt(&sprt);
+    setRGB0(&sprt, 128, 128, 128);
+    setXY0(&sprt, 0, 0);
+    setWH(&sprt, 16, 16);
+    setUV0(&sprt, 0, 0);
+    catPrim(&area[1], &offset[1]);
+    catPrim(&offset[1], &mode);
+    catPrim(&mode, &twin);
+    catPrim(&twin, &sprt);
+    termPrim(&sprt);
+    DrawOTag((OT_TYPE*)&area[0]);
+    DrawSync(0);
+    TestHook_ForceLateFrames(0);
+
+    // reading the sprite back replays the tile first
+    EXPECT_EQ(CountPixels(256, 0, 16, 16, 0x001F), 16 * 16);
+    ASSERT_EQ(Psyz_VideoSetFrameSkip(PSYZ_FRAMESKIP_OFF), 0);
+#endif
+}
+
+struct CaptureLog {
+    int delivered;
+    int width, height;
+    unsigned long long first_frame, last_frame;
+    bool ordered;
+    unsigned char first_pixel[3];
+};
+
+static void OnCapturedFrame(const PsyzCapturedFrame* frame, void* userdata) {
+    CaptureLog* log = static_cast<CaptureLog*>(userdata);
+    if (log->delivered) {
+        log->ordered = log->ordered && frame->frame > log->last_frame;
+    } else {
+        log->first_frame = frame->frame;
+        memcpy(log->first_pixel, frame->pixels, 3);
+    }
+    log->last_frame = frame->frame;
+    log->width = frame->width;
+    log->height = frame->height;
+    log->delivered++;
+}
+
+TEST_F(gpu_Test, capture_frames) {
+    CaptureLog log = {};
+    log.ordered = true;
+    EXPECT_EQ(Psyz_VideoCaptureStart(NULL, &log, PSYZ_CAPTURE_RGB888), -1);
+    EXPECT_EQ(Psyz_VideoCaptureStart(
+                  OnCapturedFrame, &log, (PsyzCaptureFormat)-1),
+              -1);
+#ifdef __PSP__
+    GTEST_SKIP() << "no frame capture supported";
+    return;
+#endif
+    RECT rect = {0, 0, SCREEN_WIDTH, SCREEN_HEIGHT};
+    ClearImage(&rect, 0xFF, 0, 0);
+    DrawSync(0);
+    ASSERT_EQ(
+        Psyz_VideoCaptureStart(OnCapturedFrame, &log, PSYZ_CAPTURE_RGB888), 0);
+    for (int i = 0; i < 8; i++) {
+        VSync(0);
+    }
+    // stopping delivers what was queued before returning
+    Psyz_VideoCaptureStop();
+
+    ASSERT_GT(log.delivered, 0);
+    EXPECT_EQ(log.width, 256);
+    EXPECT_EQ(log.height, 240);
+    EXPECT_TRUE(log.ordered);
+    EXPECT_GE(log.last_frame, log.first_frame);
+    EXPECT_EQ(log.first_pixel[0], 0xFF);
+    EXPECT_EQ(log.first_pixel[1], 0);
+    EXPECT_EQ(log.first_pixel[2], 0);
+}
+
+TEST_F(gpu_Test, record_y4m_wav) {
+    EXPECT_EQ(Psyz_VideoRecordStart(NULL, PSYZ_RECORD_Y4M_WAV), -1);
+#ifdef __PSP__
+    GTEST_SKIP() << "no recording supported";
+    return;
+#endif
+    RECT rect = {0, 0, SCREEN_WIDTH, SCREEN_HEIGHT};
+    ClearImage(&rect, 0xFF, 0, 0);
+    DrawSync(0);
+    ASSERT_EQ(Psyz_VideoRecordStart("record_test", PSYZ_RECORD_Y4M_WAV), 0);
+    EXPECT_EQ(Psyz_VideoRecordStart("record_test", PSYZ_RECORD_Y4M_WAV), -1);
+    for (int i = 0; i < 8; i++) {
+        VSync(0);
+    }
+    Psyz_VideoRecordStop();
+
+    PsyzRecordStats rs;
+    ASSERT_EQ(Psyz_VideoRecordStats(&rs), 0);
+    ASSERT_GT(rs.frames, 0u);
+    EXPECT_EQ(rs.width, 256);
+    EXPECT_EQ(rs.height, 240);
+    // no audio device, but the audio still lasts as long as the frames
+    EXPECT_NEAR((double)rs.audio_frames, rs.frames * 44100.0 * 1001 / 60000,
+                1.0);
+
+    std::vector<unsigned char> y4m(1 << 20);
+    FILE* f = fopen("record_test.y4m", "rb");
+    ASSERT_NE(f, nullptr);
+    y4m.resize(fread(y4m.data(), 1, y4m.size(), f));
+    fclose(f);
+    const char header[] = "YUV4MPEG2 W256 H240 F60000:1001 Ip A1:1 C420jpeg\n";
+    const size_t header_len = sizeof(header) - 1;
+    ASSERT_EQ(memcmp(y4m.data(), header, header_len), 0);
+    const size_t frame_len = 6 + 256 * 240 + 2 * 128 * 120;
+    EXPECT_EQ(y4m.size(), header_len + rs.frames * frame_len);
+    EXPECT_EQ(memcmp(&y4m[header_len], "FRAME\n", 6), 0);
+    EXPECT_EQ(y4m[header_len + 6], 82); // red in BT.601
+
+    f = fopen("record_test.wav", "rb");
+    ASSERT_NE(f, nullptr);
+    fseek(f, 0, SEEK_END);
+    EXPECT_EQ((unsigned long long)ftell(f), 44 + rs.audio_frames * 4);
+    fclose(f);
+    remove("record_test.y4m");
+    remove("record_test.wav");
+}
+
+TEST_F(gpu_Test, gp0_block) {
+    const uint32_t words[] = {
+        0x600000FF, 0x00000000, 0x00100010, // red TILE
+        0x6000FF00, 0x00000010, 0x00100010, // green TILE
+    };
+    // the second call completes the packet left incomplete by the first
+    Psyz_GpuWriteGP0Block(words, 4);
+    Psyz_GpuWriteGP0Block(&words[4], LEN(words) - 4);
+    DrawSync(0);
+    EXPECT_EQ(CountPixels(0, 0, 16, 16, 0x001F), 16 * 16);
+    EXPECT_EQ(CountPixels(16, 0, 16, 16, 0x03E0), 16 * 16);
+}
+
+static std::vector<int> gp0_order;
+static int LogGp0Order(const u_long* words, int available, void*) {
+    (void)available;
+    gp0_order.push_back((int)(words[0] & 0xFFFF));
+    return 1;
+}
+
+TEST_F(gpu_Test, gp0_block_dispatches_queue) {
+    ASSERT_EQ(Psyz_GpuRegisterCommandHandler(0xF1, LogGp0Order, NULL), 0);
+    gp0_order.clear();
+    Psyz_GpuWriteGP0(0xF1000001);
+    EXPECT_TRUE(gp0_order.empty()); // queued until the next Exeque
+    const uint32_t block[] = {0xF1000002, 0xF1000003};
+    Psyz_GpuWriteGP0Block(block, LEN(block));
+    // without the GPU thread, the block and what was queued before it are
+    // dispatched right away and in order
+    EXPECT_EQ(gp0_order, (std::vector<int>{1, 2, 3}));
+    Psyz_GpuWriteGP0(0xF1000004);
+    DrawSync(0);
+    Psyz_GpuRegisterCommandHandler(0xF1, NULL, NULL);
+    EXPECT_EQ(gp0_order, (std::vector<int>{1, 2, 3, 4}));
+}
+
+TEST_F(gpu_Test, ot_merged_node) {
+    // a drawing offset command sharing its node with the primitive it moves
+    static struct {
+        O_TAG;
+        u_long offset;
+        u_char r0, g0, b0, code;
+        short x0, y0;
+        short w, h;
+    } node;
+    static OT_TYPE ot[2];
+    ClearOTagR(ot, LEN(ot));
+    // setcode would write over the offset word, the TILE starts after it
+    setlen(&node, 4);
+    node.offset = 0xE5000000 | (8 << 11) | 16;
+    node.code = 0x60;
+    setRGB0(&node, 0xFF, 0, 0);
+    setXY0(&node, 0, 0);
+    setWH(&node, 16, 16);
+    addPrim(&ot[0], &node);
+    DrawOTag(&ot[LEN(ot) - 1]);
+    DrawSync(0);
+    EXPECT_EQ(CountPixels(16, 8, 16, 16, 0x001F), 16 * 16);
+    EXPECT_EQ(CountPixels(0, 0, 16, 8, 0x001F), 0);
+}
+
+static int long_command_len;
+static u_long long_command_last;
+static int HandleLongCommand(const u_long* words, int available, void*) {
+    long_command_len = available;
+    long_command_last = words[available - 1];
+    return available;
+}
+
+TEST_F(gpu_Test, gp0_long_custom_command) {
+    static uint32_t words[0x180];
+    words[0] = 0xF0000000;
+    for (int i = 1; i < LEN(words); i++) {
+        words[i] = (uint32_t)i; // NOP words the handler takes as its data
+    }
+    ASSERT_EQ(Psyz_GpuRegisterCommandHandler(0xF0, HandleLongCommand, NULL), 0);
+    long_command_len = 0;
+    Psyz_GpuWriteGP0Block(words, LEN(words));
+    DrawSync(0);
+    Psyz_GpuRegisterCommandHandler(0xF0, NULL, NULL);
+    EXPECT_EQ(long_command_len, LEN(words));
+    EXPECT_EQ(long_command_last, (u_long)(LEN(words) - 1));
+}
+
+TEST_F(gpu_Test, gp0_linked_list) {
+    static uint32_t ram[0x40];
+    ram[0x00] = 0x00000010; // empty node, next at 0x10
+    ram[0x04] = 0x03000020; // 3 words, next at 0x20
+    ram[0x05] = 0x60FF0000; // blue TILE
+    ram[0x06] = 0x00100000;
+    ram[0x07] = 0x00100010;
+    ram[0x08] = 0x03FFFFFF; // 3 words, last node
+    ram[0x09] = 0x600000FF; // red TILE
+    ram[0x0A] = 0x00100010;
+    ram[0x0B] = 0x00100010;
+    EXPECT_EQ(Psyz_GpuWriteGP0LinkedList(ram, 0x000000, NULL, NULL), 3);
+    DrawSync(0);
+    EXPECT_EQ(CountPixels(0, 16, 16, 16, 0x7C00), 16 * 16);
+    EXPECT_EQ(CountPixels(16, 16, 16, 16, 0x001F), 16 * 16);
+
+    ram[0x00] = 0x00000000; // points to itself
+    EXPECT_LT(Psyz_GpuWriteGP0LinkedList(ram, 0x000000, NULL, NULL), 0);
+}
+
+TEST_F(gpu_Test, dma_otc) {
+    // odd on purpose, so vectorized fills also have a tail
+    static OT_TYPE expected[63], actual[63];
+    ClearOTagR(expected, LEN(expected));
+    Psyz_DmaWrite(DMA_CHANNEL_OTC, 0, (u_long)&actual[LEN(actual) - 1]);
+    Psyz_DmaWrite(DMA_CHANNEL_OTC, 1, LEN(actual));
+    Psyz_DmaWrite(DMA_CHANNEL_OTC, 2, 0x11000002);
+    // ClearOTagR terminates the table with its own primitive instead
+    EXPECT_TRUE(isendprim(&actual[0]));
+    for (int i = 1; i < LEN(actual); i++) {
+        EXPECT_EQ(getaddr(&actual[i]), (u_long)&actual[i - 1]);
+        EXPECT_EQ(getaddr(&actual[i]) - (u_long)actual,
+                  getaddr(&expected[i]) - (u_long)expected);
+        EXPECT_EQ(actual[i].len, 0);
+    }
+}
+
+TEST_F(gpu_Test, dma_gpu) {
+    // mode 1, 16x16 pixels as 8 blocks of 16 words
+    static u_short pixels[16 * 16], readback[16 * 16];
+    for (int i = 0; i < LEN(pixels); i++) {
+        pixels[i] = 0x7C00;
+    }
+    Psyz_GpuWriteGP0(0xA0000000);
+    Psyz_GpuWriteGP0(0x00200000);
+    Psyz_GpuWriteGP0(0x00100010);
+    Psyz_DmaWrite(DMA_CHANNEL_GPU, 0, (u_long)pixels);
+    Psyz_DmaWrite(DMA_CHANNEL_GPU, 1, 0x00080010);
+    Psyz_DmaWrite(DMA_CHANNEL_GPU, 2, 0x01000201);
+    Psyz_GpuWriteGP0(0xC0000000);
+    Psyz_GpuWriteGP0(0x00200000);
+    Psyz_GpuWriteGP0(0x00100010);
+    Psyz_DmaWrite(DMA_CHANNEL_GPU, 0, (u_long)readback);
+    Psyz_DmaWrite(DMA_CHANNEL_GPU, 1, 0x00080010);
+    Psyz_DmaWrite(DMA_CHANNEL_GPU, 2, 0x01000200);
+    for (int i = 0; i < LEN(readback); i++) {
+        ASSERT_EQ(readback[i] & 0x7FFF, 0x7C00) << "pixel " << i;
+    }
+
+    // mode 0, the same pixels as a single block of 128 words
+    for (int i = 0; i < LEN(pixels); i++) {
+        pixels[i] = 0x03E0;
+    }
+    Psyz_GpuWriteGP0(0xA0000000);
+    Psyz_GpuWriteGP0(0x00200000);
+    Psyz_GpuWriteGP0(0x00100010);
+    Psyz_DmaWrite(DMA_CHANNEL_GPU, 0, (u_long)pixels);
+    Psyz_DmaWrite(DMA_CHANNEL_GPU, 1, 0x00000080);
+    Psyz_DmaWrite(DMA_CHANNEL_GPU, 2, 0x01000001);
+    Psyz_GpuWriteGP0(0xC0000000);
+    Psyz_GpuWriteGP0(0x00200000);
+    Psyz_GpuWriteGP0(0x00100010);
+    Psyz_DmaWrite(DMA_CHANNEL_GPU, 0, (u_long)readback);
+    Psyz_DmaWrite(DMA_CHANNEL_GPU, 1, 0x00000080);
+    Psyz_DmaWrite(DMA_CHANNEL_GPU, 2, 0x01000000);
+    for (int i = 0; i < LEN(readback); i++) {
+        ASSERT_EQ(readback[i] & 0x7FFF, 0x03E0) << "pixel " << i;
+    }
+
+    // mode 2, ordering table
+    static OT_TYPE ot[4];
+    static TILE tile;
+    ClearOTagR(ot, LEN(ot));
+    setTile(&tile);
+    setRGB0(&tile, 0xFF, 0, 0);
+    setXY0(&tile, 48, 0);
+    setWH(&tile, 16, 16);
+    addPrim(&ot[2], &tile);
+    Psyz_DmaWrite(DMA_CHANNEL_GPU, 0, (u_long)&ot[LEN(ot) - 1]);
+    Psyz_DmaWrite(DMA_CHANNEL_GPU, 2, 0x01000401);
+    DrawSync(0);
+    EXPECT_EQ(CountPixels(48, 0, 16, 16, 0x001F), 16 * 16);
+}
+
+TEST_F(gpu_Test, capture_replay) {
+    const char* path = "psyz_gpu_trace.bin";
+    static u_short pixels[16 * 16];
+    for (int i = 0; i < LEN(pixels); i++) {
+        pixels[i] = 0x03E0;
+    }
+    ASSERT_EQ(Psyz_GpuCaptureStart(path), 0);
+    RECT rect = {64, 0, 16, 16};
+    LoadImage(&rect, (u_long*)pixels);
+    const uint32_t tile[] = {0x600000FF, 0x00000050, 0x00100010};
+    Psyz_GpuWriteGP0Block(tile, LEN(tile));
+    DrawSync(0);
+    static u_short readback[32 * 16];
+    RECT both = {64, 0, 32, 16};
+    StoreImage(&both, (u_long*)readback);
+    DrawSync(0);
+    VSync(0);
+    Psyz_GpuCaptureStop();
+
+    FILE* f = fopen(path, "rb");
+    ASSERT_NE(f, nullptr);
+    static uint32_t data[0x1000];
+    size_t size = fread(data, 1, sizeof(data), f);
+    fclose(f);
+    remove(path);
+
+    ClearImage(&both, 0, 0, 0);
+    DrawSync(0);
+    ASSERT_EQ(CountPixels(64, 0, 32, 16, 0), 32 * 16);
+
+    PsyzGpuTrace trace;
+    PsyzGpuReplayStats stats;
+    ASSERT_EQ(Psyz_GpuReplayOpen(&trace, data, size), 0);
+    EXPECT_EQ(Psyz_GpuReplayFrame(&trace, &stats), 1);
+    EXPECT_EQ(stats.gp0_words, (unsigned)LEN(tile));
+    EXPECT_EQ(stats.transfers, 2u); // the LoadImage and the StoreImage
+    EXPECT_EQ(Psyz_GpuReplayFrame(&trace, &stats), 0);
+    DrawSync(0);
+    EXPECT_EQ(CountPixels(64, 0, 16, 16, 0x03E0), 16 * 16);
+    EXPECT_EQ(CountPixels(80, 0, 16, 16, 0x001F), 16 * 16);
+}
+
+TEST_F(gpu_Test, display_off_clears_vram) {
+#ifdef __PSP__
+    GTEST_SKIP() << "The GE keeps VRAM while the display is off";
+#endif
+    static u_short pixels[16 * 16];
+    RECT rect = {32, 16, 16, 16};
+    ClearImage(&rect, 255, 0, 0);
+    DrawSync(0);
+    SetDispMask(0);
+    StoreImage(&rect, (u_long*)pixels);
+    DrawSync(0);
+    SetDispMask(1);
+    for (int i = 0; i < LEN(pixels); i++) {
+        ASSERT_EQ(pixels[i], 0) << "at " << i % 16 << "," << i / 16;
+    }
+}
+
+TEST_F(gpu_Test, pipeline_stats) {
+#ifdef __PSP__
+    GTEST_SKIP() << "The GE draws primitives without batching them";
+#endif
+    static u_short pixels[16 * 16];
+    PsyzVideoPipelineStats stats;
+    VSync(0);
+    const uint32_t prims[] = {
+        0x600000FF, 0x00000000, 0x00100010, // TILE
+        0x7000FF00, 0x00000020,             // TILE_8
+        0x200000FF, 0x00000030, 0x00000040, 0x00100030, // POLY_F3
+    };
+    Psyz_GpuWriteGP0Block(prims, LEN(prims));
+    RECT rect = {64, 0, 16, 16};
+    LoadImage(&rect, (u_long*)pixels);
+    DrawSync(0);
+    VSync(0);
+    ASSERT_EQ(Psyz_VideoPipelineStats(NULL), -1);
+    ASSERT_EQ(Psyz_VideoPipelineStats(&stats), 0);
+    EXPECT_EQ(stats.rects, 2u);
+    EXPECT_EQ(stats.polys, 1u);
+    EXPECT_EQ(stats.lines, 0u);
+    // the upload submits the primitives queued before it, even where it is
+    // recorded in the same batch as them
+    EXPECT_EQ(stats.flushes[PSYZ_FLUSH_LOAD_IMAGE], 1u);
+    EXPECT_EQ(stats.flushes[PSYZ_FLUSH_EXEQUE], 0u);
+    EXPECT_EQ(stats.flushes[PSYZ_FLUSH_BUFFER_FULL], 0u);
+}
+
+TEST_F(gpu_Test, ot_profile) {
+    static OT_TYPE ot[8];
+    static TILE tiles[3];
+    PsyzGpuOtStats stats;
+    ASSERT_EQ(Psyz_GpuOtStats(&stats), -1);
+    Psyz_GpuOtProfile(1);
+    ClearOTagR(ot, LEN(ot));
+    for (int i = 0; i < LEN(tiles); i++) {
+        setTile(&tiles[i]);
+        setXY0(&tiles[i], 16 * i, 0);
+        setWH(&tiles[i], 16, 16);
+    }
+    addPrim(&ot[2], &tiles[0]);
+    addPrim(&ot[2], &tiles[1]);
+    addPrim(&ot[5], &tiles[2]);
+    DrawOTag(&ot[LEN(ot) - 1]);
+    DrawSync(0);
+    VSync(0);
+    ASSERT_EQ(Psyz_GpuOtStats(&stats), 0);
+    Psyz_GpuOtProfile(0);
+    // ClearOTagR links the first slot to a terminator of 4 NOP words
+    EXPECT_EQ(stats.walks, 1u);
+    EXPECT_EQ(stats.total.links, 12u);
+    EXPECT_EQ(stats.total.empty_links, 8u);
+    EXPECT_EQ(stats.total.prims, 4u);
+    EXPECT_EQ(stats.total.occupied_slots, 3u);
+    EXPECT_EQ(stats.total.longest_chain, 2u);
+    EXPECT_EQ(stats.total.packet_bytes, (3 * 3 + 4) * sizeof(u32));
+    EXPECT_EQ(stats.largest.links, stats.total.links);
+}
+
 TEST_F(gpu_Test, uv_minification) {
 #ifdef __PSP__
 #ifdef IS_PPSSPP_EMU
@@ -1115,6 +1830,60 @@ TEST_F(gpu_Test, texture_window_non_square) {
     AssertFrame("texture_window_non_square");
 }
 
+TEST_F(gpu_Test, threaded_draw_ft4) {
+    if (Psyz_GpuSetThreaded(1) < 0) {
+        GTEST_SKIP() << "GPU thread unsupported by the rendering backend";
+    }
+    u_short tpage, clut;
+    if (LoadTim(img_4bpp, &tpage, &clut)) {
+        Psyz_GpuSetThreaded(0);
+        return;
+    }
+    SetPolyFT4(&cdb->ft4[0]);
+    setXYWH(&cdb->ft4[0], 16, 16, 64, 64);
+    setRGB0(&cdb->ft4[0], 128, 128, 128);
+    setUVWH(&cdb->ft4[0], 0, 0, 64, 64);
+    setSemiTrans(&cdb->ft4[0], 0);
+    cdb->ft4[0].tpage = tpage;
+    cdb->ft4[0].clut = clut;
+
+    ClearOTag(cdb->ot, OTSIZE);
+    AddPrim(cdb->ot, &db[0].ft4[0]);
+
+    ClearImage(&cdb->draw.clip, 60, 120, 120);
+    DrawOTag(cdb->ot);
+    DrawSync(0);
+    EXPECT_EQ(DrawSync(1), 0);
+    VSync(0);
+    PutDispEnv(&cdb->disp);
+    AssertFrame("draw_ft4");
+    EXPECT_EQ(Psyz_GpuSetThreaded(0), 0);
+}
+
+TEST_F(gpu_Test, threaded_ring_full) {
+    if (Psyz_GpuSetThreaded(1) < 0) {
+        GTEST_SKIP() << "GPU thread unsupported by the rendering backend";
+    }
+    // more words than the render thread ring holds, so submitting has to
+    // wait for the render thread to make room
+    static std::vector<uint32_t> words;
+    const int tiles = 0x8000;
+    words.resize(tiles * 3);
+    for (int i = 0; i < tiles; i++) {
+        words[i * 3 + 0] = 0x60000000 | (i & 1 ? 0x00FF00 : 0x0000FF);
+        words[i * 3 + 1] = (uint32_t)((i & 15) << 4);
+        words[i * 3 + 2] = 0x00100010;
+    }
+    for (int i = 0; i < 3; i++) {
+        Psyz_GpuWriteGP0Block(words.data(), words.size());
+    }
+    DrawSync(0);
+    EXPECT_EQ(Psyz_GpuSetThreaded(0), 0);
+    // the odd spots are last drawn green, the even ones red
+    EXPECT_EQ(CountPixels(0, 0, 256, 16, 0x03E0), 8 * 16 * 16);
+    EXPECT_EQ(CountPixels(0, 0, 256, 16, 0x001F), 8 * 16 * 16);
+}
+
 class dither_Test : public gpu_Test {
   protected:
     static const int DR = 47;
@@ -1512,3 +2281,74 @@ TEST_F(horizontal_grid_Test, horizontal_grid_invalid_args) {
     EXPECT_EQ(Psyz_GpuSetHorizontalGrid(1, 1), 0);
     EXPECT_EQ(Psyz_GpuRegisterCommandHandler(0x100, HandleGrid, nullptr), -1);
 }
+
+#ifndef __PSP__
+// every SIMD kernel matches the scalar conversions for any length and
+// alignment, so both the vector loops and their scalar tails are covered
+TEST(PixelConvert, kernels_match_reference) {
+    const size_t count = 0x10000 + 37;
+    std::vector<u16> src16(count + 1);
+    std::vector<u8> src32((count + 2) * 4);
+    unsigned int seed = 1;
+    for (size_t i = 0; i < src16.size(); i++) {
+        src16[i] = (u16)i; // every RGB5551 value at least once
+    }
+    for (size_t i = 0; i < src32.size(); i++) {
+        seed = seed * 1103515245 + 12345;
+        src32[i] = (u8)(seed >> 16);
+    }
+
+    std::vector<u8> exp_rgba(count * 4), act_rgba(count * 4 + 16);
+    std::vector<u16> exp_16(count), act_16(count + 8);
+    std::vector<u8> exp_rgb(count * 3), act_rgb(count * 3 + 16);
+    const PixelIsa prev = Pixel_CurrentIsa();
+    int tested = 0;
+    for (int isa = 0; isa < PIXEL_ISA_COUNT; isa++) {
+        if (!Pixel_SelectIsa((PixelIsa)isa)) {
+            continue;
+        }
+        tested++;
+        SCOPED_TRACE(Pixel_IsaName((PixelIsa)isa));
+        for (size_t off = 0; off < 2; off++) {
+            const u16* in16 = src16.data() + off;
+            const u8* in32 = src32.data() + off * 4 + off;
+            for (size_t i = 0; i < count; i++) {
+                u16 v = in16[i];
+                exp_rgba[i * 4 + 0] = (u8)(((v & 0x1F) * 255 + 15) / 31);
+                exp_rgba[i * 4 + 1] = (u8)((((v >> 5) & 0x1F) * 255 + 15) / 31);
+                exp_rgba[i * 4 + 2] =
+                    (u8)((((v >> 10) & 0x1F) * 255 + 15) / 31);
+                exp_rgba[i * 4 + 3] = (v & 0x8000) ? 0xFF : 0x00;
+                const u8* c = in32 + i * 4;
+                exp_16[i] = (u16)((c[0] * 31 + 127) / 255 |
+                                  ((c[1] * 31 + 127) / 255) << 5 |
+                                  ((c[2] * 31 + 127) / 255) << 10 |
+                                  (c[3] >= 0x80 ? 0x8000 : 0));
+                memcpy(&exp_rgb[i * 3], c, 3);
+            }
+            const size_t lens[] = {0, 1, 3, 7, 8, 15, 16, 17, 31, 33, count};
+            for (size_t len : lens) {
+                SCOPED_TRACE(len);
+                memset(act_rgba.data(), 0xCC, act_rgba.size());
+                memset(act_16.data(), 0xCC, act_16.size() * sizeof(u16));
+                memset(act_rgb.data(), 0xCC, act_rgb.size());
+                Pixel_Rgb5551ToRgba8888(in16, act_rgba.data() + off, len);
+                Pixel_Rgba8888ToRgb5551(in32, act_16.data() + off, len);
+                Pixel_Rgba8888ToRgb888(in32, act_rgb.data() + off, len);
+                EXPECT_EQ(memcmp(act_rgba.data() + off, exp_rgba.data(),
+                                 len * 4), 0);
+                EXPECT_EQ(memcmp(act_16.data() + off, exp_16.data(),
+                                 len * sizeof(u16)), 0);
+                EXPECT_EQ(
+                    memcmp(act_rgb.data() + off, exp_rgb.data(), len * 3), 0);
+                // nothing is written past the last pixel
+                EXPECT_EQ(act_rgba[off + len * 4], 0xCC);
+                EXPECT_EQ(act_16[off + len], 0xCCCC);
+                EXPECT_EQ(act_rgb[off + len * 3], 0xCC);
+            }
+        }
+    }
+    EXPECT_TRUE(Pixel_SelectIsa(prev));
+    EXPECT_GE(tested, 1);
+}
+#endif
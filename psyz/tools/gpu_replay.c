@@ -0,0 +1,135 @@
+// Replays a trace recorded with Psyz_GpuCaptureStart as fast as the
+// rendering backend allows, to benchmark it without any game logic.
+// Build the psyz_gpu_replay target once per PSYZ_RENDERER to compare them.
+//
+// usage: psyz_gpu_replay <trace> [loops] [-v]
+
+#include <psyz.h>
+#include <libetc.h>
+#include <libgpu.h>
+#include <SDL3/SDL.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static void* MapTrace(const char* path, size_t* size) {
+#ifndef _WIN32
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+    void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+    *size = (size_t)st.st_size;
+    return data;
+#else
+    return SDL_LoadFile(path, size);
+#endif
+}
+
+static void UnmapTrace(void* data, size_t size) {
+#ifndef _WIN32
+    munmap(data, size);
+#else
+    SDL_free(data);
+#endif
+}
+
+static double ElapsedUs(Uint64 start, Uint64 end) {
+    return (double)(end - start) * 1000000.0 /
+           (double)SDL_GetPerformanceFrequency();
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <trace> [loops] [-v]\n", argv[0]);
+        return 1;
+    }
+    int loops = argc > 2 && argv[2][0] != '-' ? atoi(argv[2]) : 1;
+    bool verbose = !strcmp(argv[argc - 1], "-v");
+    size_t size;
+    void* data = MapTrace(argv[1], &size);
+    if (!data) {
+        fprintf(stderr, "failed to open '%s'\n", argv[1]);
+        return 1;
+    }
+
+    Psyz_VideoSetVsyncMode(PSYZ_VSYNC_LIMITLESS);
+    ResetGraph(0);
+    SetDispMask(1);
+
+    unsigned long long frames = 0, words = 0, flushes = 0;
+    double decode_us = 0.0, present_us = 0.0;
+    double min_us = 1e9, max_us = 0.0;
+    Uint64 begin = SDL_GetPerformanceCounter();
+    for (int loop = 0; loop < loops && !Psyz_QuitRequested(); loop++) {
+        PsyzGpuTrace trace;
+        if (Psyz_GpuReplayOpen(&trace, data, size) < 0) {
+            UnmapTrace(data, size);
+            return 1;
+        }
+        while (!Psyz_QuitRequested()) {
+            PsyzGpuReplayStats stats;
+            Uint64 t0 = SDL_GetPerformanceCounter();
+            int ret = Psyz_GpuReplayFrame(&trace, &stats);
+            DrawSync(0);
+            Uint64 t1 = SDL_GetPerformanceCounter();
+            if (ret <= 0) {
+                if (ret < 0) {
+                    UnmapTrace(data, size);
+                    return 1;
+                }
+                break;
+            }
+            Psyz_VideoVSync(0);
+            Uint64 t2 = SDL_GetPerformanceCounter();
+
+            double frame_us = ElapsedUs(t0, t1);
+            decode_us += frame_us;
+            present_us += ElapsedUs(t1, t2);
+            min_us = SDL_min(min_us, frame_us);
+            max_us = SDL_max(max_us, frame_us);
+            words += stats.gp0_words;
+            flushes += stats.flushes;
+            if (verbose) {
+                printf("frame %llu: %.1f us, %u words, %u flushes, "
+                       "%u transfers\n",
+                       frames, frame_us, stats.gp0_words, stats.flushes,
+                       stats.transfers);
+            }
+            frames++;
+        }
+    }
+    double total_us = ElapsedUs(begin, SDL_GetPerformanceCounter());
+    UnmapTrace(data, size);
+    if (!frames) {
+        fprintf(stderr, "no frames in the trace\n");
+        return 1;
+    }
+
+    printf("frames:   %llu\n", frames);
+    printf("decode:   %.1f us/frame (min %.1f, max %.1f)\n",
+           decode_us / (double)frames, min_us, max_us);
+    printf("present:  %.1f us/frame\n", present_us / (double)frames);
+    printf("flushes:  %.2f/frame\n", (double)flushes / (double)frames);
+    printf("gp0:      %.2f MB/s\n",
+           (double)words * 4.0 / (decode_us > 0.0 ? decode_us : 1.0));
+    printf("total:    %.1f fps\n", (double)frames * 1000000.0 / total_us);
+    return 0;
+}
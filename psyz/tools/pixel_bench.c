@@ -0,0 +1,77 @@
+// Times the pixel format conversions of the SDL3 backends with every set of
+// kernels the CPU runs, over a full VRAM worth of pixels.
+//
+// usage: psyz_pixel_bench [loops]
+
+#include <psyz.h>
+#include <SDL3/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../src/platform/sdl3_pixel.h"
+
+#define BENCH_PIXELS (1024 * 512)
+
+static double ElapsedUs(Uint64 start, Uint64 end) {
+    return (double)(end - start) * 1000000.0 /
+           (double)SDL_GetPerformanceFrequency();
+}
+
+static void Report(const char* name, double us, int loops) {
+    double per_loop = us / (double)loops;
+    printf("  %-12s %8.1f us  %7.1f Mpixel/s\n", name, per_loop,
+           (double)BENCH_PIXELS / (per_loop > 0.0 ? per_loop : 1.0));
+}
+
+int main(int argc, char* argv[]) {
+    int loops = argc > 1 ? atoi(argv[1]) : 100;
+    if (loops <= 0) {
+        fprintf(stderr, "usage: %s [loops]\n", argv[0]);
+        return 1;
+    }
+    u16* vram = malloc(BENCH_PIXELS * sizeof(u16));
+    u8* rgba = malloc(BENCH_PIXELS * 4);
+    u8* rgb = malloc(BENCH_PIXELS * 3);
+    if (!vram || !rgba || !rgb) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    for (int i = 0; i < BENCH_PIXELS; i++) {
+        vram[i] = (u16)(i * 0x9E37);
+    }
+
+    const PixelIsa best = Pixel_CurrentIsa();
+    for (int isa = 0; isa < PIXEL_ISA_COUNT; isa++) {
+        if (!Pixel_SelectIsa((PixelIsa)isa)) {
+            continue;
+        }
+        printf("%s%s\n", Pixel_IsaName((PixelIsa)isa),
+               (PixelIsa)isa == best ? " (default)" : "");
+
+        Uint64 t0 = SDL_GetPerformanceCounter();
+        for (int i = 0; i < loops; i++) {
+            Pixel_Rgb5551ToRgba8888(vram, rgba, BENCH_PIXELS);
+        }
+        Uint64 t1 = SDL_GetPerformanceCounter();
+        Report("to rgba8888", ElapsedUs(t0, t1), loops);
+
+        t0 = SDL_GetPerformanceCounter();
+        for (int i = 0; i < loops; i++) {
+            Pixel_Rgba8888ToRgb5551(rgba, vram, BENCH_PIXELS);
+        }
+        t1 = SDL_GetPerformanceCounter();
+        Report("to rgb5551", ElapsedUs(t0, t1), loops);
+
+        t0 = SDL_GetPerformanceCounter();
+        for (int i = 0; i < loops; i++) {
+            Pixel_Rgba8888ToRgb888(rgba, rgb, BENCH_PIXELS);
+        }
+        t1 = SDL_GetPerformanceCounter();
+        Report("to rgb888", ElapsedUs(t0, t1), loops);
+    }
+    Pixel_SelectIsa(best);
+
+    free(vram);
+    free(rgba);
+    free(rgb);
+    return 0;
+}